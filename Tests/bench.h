@@ -0,0 +1,100 @@
+/**
+ * @brief Clock, latency histograms and percentiles shared by the benchmark
+ *        and latency probe tools.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Latency histograms: exact up to 63 ns, then 32 sub-buckets for each power
+ * of two, i.e. within about 3% of the real value. */
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_LINEAR (2 * HIST_SUB)
+#define HIST_BUCKETS (HIST_LINEAR + (63 - HIST_SUB_BITS) * HIST_SUB)
+
+#define MAX_SWEEP 16  // Max values in a sweep list.
+
+/* A list of values to sweep. */
+typedef struct {
+    int vals[MAX_SWEEP];
+    int nr;
+} sweep_t;
+
+/**
+ * @brief Returns the current monotonic time, in nanoseconds.
+ *
+ * @return Current time.
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Records a latency in a histogram.
+ *
+ * @param hist Histogram to update.
+ * @param ns Latency, in nanoseconds.
+ */
+static inline void hist_add(unsigned long long *hist, unsigned long long ns) {
+    int msb, shift;
+    if (ns < HIST_LINEAR) {
+        hist[ns]++;
+        return;
+    }
+    msb = 63 - __builtin_clzll(ns);
+    shift = msb - HIST_SUB_BITS;
+    hist[HIST_LINEAR + (msb - HIST_SUB_BITS - 1) * HIST_SUB +
+         (int)((ns >> shift) - HIST_SUB)]++;
+}
+
+/**
+ * @brief Returns the middle value of a histogram bucket.
+ *
+ * @param idx Bucket index.
+ * @return Value, in nanoseconds.
+ */
+static inline unsigned long long hist_value(int idx) {
+    unsigned long long base;
+    int shift;
+    if (idx < HIST_LINEAR) return (unsigned long long)idx;
+    shift = ((idx - HIST_LINEAR) / HIST_SUB) + 1;
+    base = (unsigned long long)(((idx - HIST_LINEAR) % HIST_SUB) + HIST_SUB);
+    return (base << shift) + ((1ULL << shift) / 2);
+}
+
+/**
+ * @brief Computes nearest-rank percentiles of a histogram.
+ *
+ * @param hist Histogram.
+ * @param fracs Percentiles to compute, as increasing fractions.
+ * @param nr Number of percentiles.
+ * @param res Array to fill with percentiles, in nanoseconds, all 0 if the
+ *            histogram is empty.
+ */
+static inline void hist_pcts(const unsigned long long *hist,
+                             const double *fracs, int nr,
+                             unsigned long long *res) {
+    unsigned long long total = 0, seen = 0;
+    int i, p = 0;
+    memset(res, 0, nr * sizeof(unsigned long long));
+    for (i = 0; i < HIST_BUCKETS; i++) total += hist[i];
+    if (total == 0) return;
+    for (i = 0; (i < HIST_BUCKETS) && (p < nr); i++) {
+        seen += hist[i];
+        while ((p < nr) && ((double)seen >= fracs[p] * (double)total))
+            res[p++] = hist_value(i);
+    }
+}
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @brief Tester for the tag_call request/reply system call.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define REQ_LEVEL 3
+#define RPL_LEVEL 4
+#define NR_CALLS 10
+#define BUFSIZE 64
+
+int tag;
+
+/**
+ * @brief Server routine: answers each request echoing it, prefixed.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *server(void *arg) {
+    UNUSED(arg);
+    char req_buf[BUFSIZE], rpl_buf[BUFSIZE];
+    for (int i = 0; i < NR_CALLS; i++) {
+        memset(req_buf, 0, BUFSIZE);
+        if (tag_receive(tag, REQ_LEVEL, req_buf, BUFSIZE) == -1) {
+            fprintf(stderr, "ERROR: Failed to receive request no. %d.\n", i);
+            perror("tag_receive");
+            exit(EXIT_FAILURE);
+        }
+        memset(rpl_buf, 0, BUFSIZE);
+        snprintf(rpl_buf, BUFSIZE, "ACK %.*s", BUFSIZE - 5, req_buf);
+        // Reply immediately: the caller is already waiting for it.
+        if (tag_send(tag, RPL_LEVEL, rpl_buf, strlen(rpl_buf) + 1) != 0) {
+            fprintf(stderr, "ERROR: Reply no. %d not delivered.\n", i);
+            perror("tag_send");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    pthread_t server_tid;
+    char buf[BUFSIZE], expected[BUFSIZE];
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_USR);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&server_tid, NULL, server, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn server.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < NR_CALLS; i++) {
+        int ret;
+        memset(buf, 0, BUFSIZE);
+        snprintf(buf, BUFSIZE, "Request no. %d", i);
+        snprintf(expected, BUFSIZE, "ACK %.*s", BUFSIZE - 5, buf);
+        // The server might not be waiting yet: retry until it gets it.
+        while (((ret = tag_call(tag, REQ_LEVEL, RPL_LEVEL, buf,
+                                strlen(buf) + 1, BUFSIZE)) == -1) &&
+               (errno == ENOMSG))
+            usleep(1000);
+        if (ret == -1) {
+            fprintf(stderr, "ERROR: Call no. %d failed.\n", i);
+            perror("tag_call");
+            exit(EXIT_FAILURE);
+        }
+        if (strcmp(buf, expected)) {
+            fprintf(stderr, "ERROR: Wrong reply to call no. %d: %s.\n", i, buf);
+            exit(EXIT_FAILURE);
+        }
+        printf("Call no. %d: %s [%d]\n", i, buf, ret);
+    }
+    pthread_join(server_tid, NULL);
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("Call tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,97 @@
+/**
+ * @brief Scalability benchmark for concurrent creations of shared instances.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+
+#define KEY_BASE 0x7A6000
+#define THREADS_DFL 8
+#define ITERATIONS 20000UL
+
+pthread_barrier_t start_barrier;
+
+/**
+ * @brief Returns the current monotonic time, in nanoseconds.
+ *
+ * @return Current time.
+ */
+unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Worker routine: creates and removes an instance with its own key.
+ *
+ * @param arg Key to use.
+ * @return Thread exit status.
+ */
+void *worker(void *arg) {
+    int key = (int)(long)arg, tag;
+    unsigned long i;
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < ITERATIONS; i++) {
+        tag = tag_get(key, TAG_CREATE, TAG_ALL);
+        if (tag == -1) {
+            fprintf(stderr, "ERROR: Failed to create instance with key %d.\n",
+                    key);
+            perror("tag_get");
+            exit(EXIT_FAILURE);
+        }
+        if (tag_ctl(tag, REMOVE)) {
+            fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+            perror("tag_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    pthread_t tids[64];
+    unsigned long long start, end;
+    int max_threads = THREADS_DFL, nr_threads, i;
+    if (argc > 2) {
+        fprintf(stderr, "Usage:\n\tcreate_bench [THREADS]\n");
+        exit(EXIT_FAILURE);
+    }
+    if (argc == 2) max_threads = atoi(argv[1]);
+    if ((max_threads <= 0) || (max_threads > 64)) max_threads = THREADS_DFL;
+    for (nr_threads = 1; nr_threads <= max_threads; nr_threads *= 2) {
+        pthread_barrier_init(&start_barrier, NULL, nr_threads + 1);
+        for (i = 0; i < nr_threads; i++) {
+            if (pthread_create(&tids[i], NULL, worker,
+                               (void *)(long)(KEY_BASE + i))) {
+                fprintf(stderr, "ERROR: Failed to spawn worker.\n");
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pthread_barrier_wait(&start_barrier);
+        start = now_ns();
+        for (i = 0; i < nr_threads; i++) pthread_join(tids[i], NULL);
+        end = now_ns();
+        pthread_barrier_destroy(&start_barrier);
+        printf("%2d thread(s): %12.1f creations/s\n", nr_threads,
+               (double)(ITERATIONS * nr_threads) * 1e9 /
+               (double)(end - start));
+    }
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,135 @@
+/**
+ * @brief Entry latency benchmark: system calls vs. data plane ioctls.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+
+#define LEVEL 0
+#define ITERATIONS_DFL 1000000UL
+
+int tag;
+
+/**
+ * @brief Returns the current monotonic time, in nanoseconds.
+ *
+ * @return Current time.
+ */
+unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Rejected tag_send through the system call: measures entry and exit.
+ *
+ * @return Operation result.
+ */
+int null_syscall(void) {
+    return syscall(__NR_tag_send, -1, LEVEL, NULL, 0);
+}
+
+/**
+ * @brief Rejected tag_send through the device file: measures entry and exit.
+ *
+ * @return Operation result.
+ */
+int null_ioctl(void) {
+    struct tag_ioctl_args args = {{(unsigned long)-1, LEVEL, 0, 0}};
+    return tag_ioctl(TAG_IOC_SEND, &args);
+}
+
+/**
+ * @brief Discarded empty tag_send through the system call.
+ *
+ * @return Operation result.
+ */
+int send_syscall(void) {
+    return syscall(__NR_tag_send, tag, LEVEL, NULL, 0);
+}
+
+/**
+ * @brief Discarded empty tag_send through the device file.
+ *
+ * @return Operation result.
+ */
+int send_ioctl(void) {
+    struct tag_ioctl_args args = {{(unsigned long)tag, LEVEL, 0, 0}};
+    return tag_ioctl(TAG_IOC_SEND, &args);
+}
+
+/**
+ * @brief Runs an operation many times, and prints its mean latency.
+ *
+ * @param name Name of the operation.
+ * @param op Operation to run.
+ * @param expected Value that the operation must return (-1 means EINVAL).
+ * @param iterations Number of runs.
+ */
+void bench(const char *name, int (*op)(void), int expected,
+           unsigned long iterations) {
+    unsigned long long start, end;
+    unsigned long i;
+    int ret;
+    // Check that the path is available before timing it.
+    ret = op();
+    if ((ret != expected) || ((expected == -1) && (errno != EINVAL))) {
+        printf("%-14s unavailable (%s)\n", name, strerror(errno));
+        return;
+    }
+    start = now_ns();
+    for (i = 0; i < iterations; i++) op();
+    end = now_ns();
+    printf("%-14s %10.1f ns/op\n", name,
+           (double)(end - start) / (double)iterations);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    unsigned long iterations = ITERATIONS_DFL;
+    if (argc > 2) {
+        fprintf(stderr, "Usage:\n\tentry_bench [ITERATIONS]\n");
+        exit(EXIT_FAILURE);
+    }
+    if (argc == 2) iterations = strtoul(argv[1], NULL, 10);
+    if (iterations == 0) iterations = ITERATIONS_DFL;
+    // Create the instance through whichever path is available.
+    tag = syscall(__NR_tag_get, IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        struct tag_ioctl_args args = {{IPC_PRIVATE, TAG_CREATE, TAG_ALL}};
+        tag = tag_ioctl(TAG_IOC_GET, &args);
+    }
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    printf("Iterations: %lu\n", iterations);
+    bench("null syscall", null_syscall, -1, iterations);
+    bench("null ioctl", null_ioctl, -1, iterations);
+    bench("send syscall", send_syscall, 1, iterations);
+    bench("send ioctl", send_ioctl, 1, iterations);
+    if (syscall(__NR_tag_ctl, tag, REMOVE, 0, 0UL) == -1) {
+        struct tag_ioctl_args args = {{(unsigned long)tag, REMOVE, 0, 0}};
+        if (tag_ioctl(TAG_IOC_CTL, &args) == -1) {
+            fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+            perror("tag_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,90 @@
+/**
+ * @brief Tester for level notification hooks.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/ipc.h>
+#include <sys/eventfd.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_LEVEL 7
+#define BUFSIZE 64
+#define MSG "Hello, reactor!"
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    char buf[BUFSIZE];
+    uint64_t events;
+    int tag, evfd;
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evfd == -1) {
+        fprintf(stderr, "ERROR: Failed to create eventfd.\n");
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_level_ctl(tag, TAG_LVL_SET, TEST_LEVEL, TAG_LVL_STICKY) ||
+        tag_level_ctl(tag, TAG_LVL_NOTIFY, TEST_LEVEL, (unsigned long)evfd)) {
+        fprintf(stderr, "ERROR: Failed to set up level.\n");
+        perror("tag_level_ctl");
+        exit(EXIT_FAILURE);
+    }
+    // No one is there, but the eventfd must be signaled anyway.
+    if (tag_send(tag, TEST_LEVEL, MSG, strlen(MSG) + 1) != 1) {
+        fprintf(stderr, "ERROR: Send was not discarded.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((read(evfd, &events, sizeof(events)) != sizeof(events)) ||
+        (events != 1)) {
+        fprintf(stderr, "ERROR: eventfd was not signaled.\n");
+        exit(EXIT_FAILURE);
+    }
+    // The message is then fetched without waiting.
+    memset(buf, 0, BUFSIZE);
+    if ((tag_receive_flags(tag, TEST_LEVEL, buf, BUFSIZE, TAG_RCV_LAST) !=
+         (int)(strlen(MSG) + 1)) || strcmp(buf, MSG)) {
+        fprintf(stderr, "ERROR: Failed to get last message.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Notified of: %s\n", buf);
+    // Once the hook is removed, nothing must come anymore.
+    if (tag_level_ctl(tag, TAG_LVL_NOTIFY, TEST_LEVEL, (unsigned long)-1)) {
+        fprintf(stderr, "ERROR: Failed to remove hook.\n");
+        perror("tag_level_ctl");
+        exit(EXIT_FAILURE);
+    }
+    tag_send(tag, TEST_LEVEL, MSG, strlen(MSG) + 1);
+    if ((read(evfd, &events, sizeof(events)) != -1) || (errno != EAGAIN)) {
+        fprintf(stderr, "ERROR: eventfd was signaled after removal.\n");
+        exit(EXIT_FAILURE);
+    }
+    close(evfd);
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("eventfd tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,110 @@
+/**
+ * @brief Tester for the tag_send_multi fan-out system call.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define NR_INSTANCES 2
+#define NR_LEVELS 4
+#define BUFSIZE 64
+
+#define MESSAGE "Fan-out message"
+
+int tags[NR_INSTANCES];
+
+/**
+ * @brief Reader routine: receives a message on a given target.
+ *
+ * @param arg Pointer to the target to receive from.
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    struct tag_target *tgt = (struct tag_target *)arg;
+    char buf[BUFSIZE];
+    memset(buf, 0, BUFSIZE);
+    if (tag_receive(tgt->tag, tgt->level, buf, BUFSIZE) == -1) {
+        fprintf(stderr, "ERROR: Failed to receive on (%d, %d).\n",
+                tgt->tag, tgt->level);
+        perror("tag_receive");
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(buf, MESSAGE)) {
+        fprintf(stderr, "ERROR: Got wrong message on (%d, %d): %s.\n",
+                tgt->tag, tgt->level, buf);
+        exit(EXIT_FAILURE);
+    }
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    struct tag_target targets[NR_INSTANCES * NR_LEVELS];
+    pthread_t readers[NR_INSTANCES * NR_LEVELS];
+    int nr_targets = NR_INSTANCES * NR_LEVELS, ret;
+    // Create the instances.
+    for (int i = 0; i < NR_INSTANCES; i++) {
+        tags[i] = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_USR);
+        if (tags[i] == -1) {
+            fprintf(stderr, "ERROR: Failed to create instance no. %d.\n", i);
+            perror("tag_get");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Spawn a reader on every target but the last one, that should get a
+    // discarded message.
+    for (int i = 0; i < nr_targets; i++) {
+        targets[i].tag = tags[i / NR_LEVELS];
+        targets[i].level = i % NR_LEVELS;
+        targets[i].result = -1;
+        if (i == (nr_targets - 1)) continue;
+        if (pthread_create(readers + i, NULL, reader, targets + i)) {
+            fprintf(stderr, "ERROR: Failed to spawn reader no. %d.\n", i);
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    sleep(1);  // Give readers some time to start waiting...
+    ret = tag_send_multi(targets, nr_targets, MESSAGE, strlen(MESSAGE) + 1);
+    if (ret == -1) {
+        fprintf(stderr, "ERROR: Failed to send fan-out message.\n");
+        perror("tag_send_multi");
+        exit(EXIT_FAILURE);
+    }
+    printf("Message delivered on %d target(s) out of %d.\n", ret, nr_targets);
+    for (int i = 0; i < nr_targets; i++)
+        printf("Target (%d, %d): %d.\n",
+               targets[i].tag, targets[i].level, targets[i].result);
+    for (int i = 0; i < (nr_targets - 1); i++) pthread_join(readers[i], NULL);
+    if ((ret != (nr_targets - 1)) || (targets[nr_targets - 1].result != 1)) {
+        fprintf(stderr, "ERROR: Unexpected fan-out results.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Remove the instances.
+    for (int i = 0; i < NR_INSTANCES; i++) {
+        if (tag_ctl(tags[i], REMOVE)) {
+            fprintf(stderr, "ERROR: Failed to remove instance no. %d.\n", i);
+            perror("tag_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Fan-out tester done!\n");
+    exit(EXIT_SUCCESS);
+}
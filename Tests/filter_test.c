@@ -0,0 +1,98 @@
+/**
+ * @brief Tester for kernel-side receive filters.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_LEVEL 2
+#define BUFSIZE 64
+#define WANTED_TYPE 0x01
+#define OTHER_TYPE 0x02
+
+int tag;
+
+/**
+ * @brief Reader routine: waits for a message of the wanted type only.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    UNUSED(arg);
+    struct tag_filter filter;
+    char buf[BUFSIZE];
+    memset(&filter, 0, sizeof(filter));
+    filter.mask[0] = 0xFF;
+    filter.value[0] = WANTED_TYPE;
+    memset(buf, 0, BUFSIZE);
+    if (tag_receive_filter(tag, TEST_LEVEL, buf, BUFSIZE, 0, &filter) == -1) {
+        fprintf(stderr, "ERROR: Failed to receive message.\n");
+        perror("tag_receive_filter");
+        exit(EXIT_FAILURE);
+    }
+    if (buf[0] != WANTED_TYPE) {
+        fprintf(stderr, "ERROR: Got message of type 0x%02x.\n", buf[0]);
+        exit(EXIT_FAILURE);
+    }
+    printf("Reader got: %s\n", buf + 1);
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    pthread_t reader_tid;
+    char msg[BUFSIZE];
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&reader_tid, NULL, reader, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn reader.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    sleep(1);
+    // The reader doesn't want this one, so no one is there to get it.
+    memset(msg, 0, BUFSIZE);
+    msg[0] = OTHER_TYPE;
+    strcpy(msg + 1, "Unwanted message");
+    if (tag_send(tag, TEST_LEVEL, msg, strlen(msg + 1) + 2) != 1) {
+        fprintf(stderr, "ERROR: Unwanted message was not discarded.\n");
+        exit(EXIT_FAILURE);
+    }
+    // This one instead must be delivered.
+    msg[0] = WANTED_TYPE;
+    strcpy(msg + 1, "Wanted message");
+    if (tag_send(tag, TEST_LEVEL, msg, strlen(msg + 1) + 2) != 0) {
+        fprintf(stderr, "ERROR: Wanted message was not delivered.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(reader_tid, NULL);
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("Filter tester done!\n");
+    exit(EXIT_SUCCESS);
+}
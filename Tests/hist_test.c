@@ -0,0 +1,147 @@
+/**
+ * @brief Tester for latency histograms mapped from the status device.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define MAX_TAGS_PARAM "/sys/module/aos_tag/parameters/max_tags"
+#define TEST_LEVEL 7
+#define BUFSIZE 64
+
+int tag;
+
+/**
+ * @brief Reader routine: waits for a message on the test level.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    UNUSED(arg);
+    char buf[BUFSIZE];
+    if (tag_receive(tag, TEST_LEVEL, buf, BUFSIZE) == -1) {
+        fprintf(stderr, "ERROR: Failed to receive message.\n");
+        perror("tag_receive");
+        exit(EXIT_FAILURE);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Prints a histogram, and returns the number of samples in it.
+ *
+ * @param name Name of the histogram.
+ * @param hist Histogram buckets.
+ * @return Number of samples.
+ */
+unsigned int print_hist(const char *name, const unsigned int *hist) {
+    unsigned int i, samples = 0;
+    printf("  %s:", name);
+    for (i = 0; i < TAG_HIST_BUCKETS; i++) {
+        if (hist[i] == 0) continue;
+        printf(" [< 2^%u ns: %u]", i, hist[i]);
+        samples += hist[i];
+    }
+    printf("\n");
+    return samples;
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    const struct tag_stats *stats;
+    const struct tag_lvl_hists *hists;
+    pthread_t reader_tid;
+    unsigned int max_tags;
+    int fd;
+    char msg[] = "Timed message";
+    FILE *param;
+    // Get the size of the counters area.
+    param = fopen(MAX_TAGS_PARAM, "r");
+    if ((param == NULL) || (fscanf(param, "%u", &max_tags) != 1)) {
+        fprintf(stderr, "ERROR: Failed to read max_tags.\n");
+        exit(EXIT_FAILURE);
+    }
+    fclose(param);
+    fd = open(TAG_STATUS_DEVFILE, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "ERROR: Failed to open status device file.\n");
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    stats = tag_stats_map(fd, max_tags);
+    if (stats == NULL) {
+        fprintf(stderr, "ERROR: Failed to map traffic counters.\n");
+        perror("tag_stats_map");
+        exit(EXIT_FAILURE);
+    }
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&reader_tid, NULL, reader, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn reader.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    sleep(1);
+    if (tag_send(tag, TEST_LEVEL, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "ERROR: Message was not delivered.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(reader_tid, NULL);
+    // One delivery to one receiver: one sample in each histogram.
+    hists = &(stats[tag].hists[TEST_LEVEL]);
+    printf("Histograms of tag %d, level %d:\n", tag, TEST_LEVEL);
+    if ((print_hist("wakeup", hists->wakeup) != 1) ||
+        (print_hist("copy", hists->copy) != 1) ||
+        (print_hist("drain", hists->drain) != 1)) {
+        fprintf(stderr, "ERROR: Bad latency histograms.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_hist_reset(fd, tag)) {
+        fprintf(stderr, "ERROR: Failed to reset histograms.\n");
+        perror("tag_hist_reset");
+        exit(EXIT_FAILURE);
+    }
+    if (print_hist("wakeup", hists->wakeup) ||
+        print_hist("copy", hists->copy) ||
+        print_hist("drain", hists->drain)) {
+        fprintf(stderr, "ERROR: Histograms were not reset.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    // The instance is gone, so there's nothing to reset.
+    if ((tag_hist_reset(fd, tag) != -1) || (errno != EIDRM)) {
+        fprintf(stderr, "ERROR: Reset of removed instance did not fail.\n");
+        exit(EXIT_FAILURE);
+    }
+    tag_stats_unmap(stats, max_tags);
+    close(fd);
+    printf("Histograms tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,734 @@
+/**
+ * @brief Comparative IPC benchmark: runs the same publish-subscribe patterns
+ *        over AOS-TAG, pipes, POSIX message queues, futexes with shared
+ *        memory and eventfds, and reports throughput and latency side by side.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+#include "bench.h"
+
+#define MAX_FAN 64        // Max publishers or subscribers.
+#define MIN_SIZE 8        // Room for the timestamp.
+#define MAX_SIZE 4096     // What all backends take by default.
+#define RING_SLOTS 64     // Slots of each shared memory ring.
+#define MQ_DEPTH 10       // Default fs.mqueue.msg_max.
+#define STAMP_SIZE sizeof(unsigned long long)
+
+#define NR_PCTS 3
+
+const double pcts[NR_PCTS] = {0.5, 0.99, 0.999};
+
+/* Publish-subscribe patterns. */
+#define PAT_1TO1 0  // One publisher, one subscriber.
+#define PAT_1TON 1  // One publisher, many subscribers, each gets everything.
+#define PAT_NTO1 2  // Many publishers, one subscriber.
+#define PATTERNS 3
+
+const char *pat_names[PATTERNS] = {"1:1", "1:N", "N:1"};
+
+/* Output formats. */
+#define OUT_CSV 0
+#define OUT_JSON 1
+
+/* Parameters of a single run. */
+typedef struct {
+    int backend;
+    int pattern;
+    int pubs;
+    int subs;
+    int size;
+} run_cfg_t;
+
+/* Data of a publisher or subscriber: counters and latency histogram. */
+typedef struct {
+    pthread_t tid;
+    int id;
+    unsigned long ops;  // Messages sent, or received.
+    unsigned long long hist[HIST_BUCKETS];
+} worker_t;
+
+/* Results of a single run. */
+typedef struct {
+    double secs;
+    unsigned long sent;      // Messages sent by all publishers.
+    unsigned long expected;  // Messages subscribers should have got.
+    unsigned long received;  // Messages subscribers got.
+    unsigned long long send_p[NR_PCTS];
+    unsigned long long dlv_p[NR_PCTS];
+} run_res_t;
+
+/**
+ * Each backend moves messages from any publisher to the channel of a
+ * subscriber, or to all of them at once if it can. Receives return the size
+ * of the message, or -1 once the subscriber has been kicked out.
+ */
+typedef struct {
+    const char *name;
+    int fan_out;  // Whether a single send reaches all subscribers.
+    void (*setup)(const run_cfg_t *cfg);
+    void (*send)(int sub, const char *msg, int size);
+    int (*receive)(int sub, char *msg, int size);
+    void (*kick)(void);
+    void (*teardown)(void);
+} backend_t;
+
+pthread_barrier_t start_barrier;
+volatile int stop;
+
+int subs_done;
+pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+
+run_cfg_t cur_cfg;
+long period_ns;
+
+/**
+ * @brief Terminates the benchmark after a failure.
+ *
+ * @param what Name of the failed operation.
+ */
+void fail(const char *what) {
+    fprintf(stderr, "ERROR: %s failed.\n", what);
+    perror(what);
+    exit(EXIT_FAILURE);
+}
+
+/* ### AOS-TAG: a level of a private instance, a send reaches everyone. ### */
+
+int tag_desc;
+
+void tag_setup(const run_cfg_t *cfg) {
+    (void)cfg;
+    tag_desc = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_USR);
+    if (tag_desc == -1) fail("tag_get");
+}
+
+void tag_bench_send(int sub, const char *msg, int size) {
+    (void)sub;
+    if (tag_send(tag_desc, 0, (char *)msg, size) == -1) fail("tag_send");
+}
+
+int tag_bench_receive(int sub, char *msg, int size) {
+    int ret;
+    (void)sub;
+    ret = tag_receive(tag_desc, 0, msg, size);
+    if ((ret == -1) && (errno != ECANCELED)) fail("tag_receive");
+    return ret;
+}
+
+void tag_kick(void) {
+    if (tag_ctl(tag_desc, AWAKE_ALL)) fail("tag_ctl");
+}
+
+void tag_teardown(void) {
+    if (tag_ctl(tag_desc, REMOVE)) fail("tag_ctl");
+}
+
+/* ### Pipes: one for each subscriber, shared by publishers. ### */
+
+int pipes[MAX_FAN][2];
+
+void pipe_setup(const run_cfg_t *cfg) {
+    int i;
+    for (i = 0; i < cfg->subs; i++)
+        if (pipe(pipes[i])) fail("pipe");
+}
+
+void pipe_send(int sub, const char *msg, int size) {
+    // Writes up to PIPE_BUF bytes are atomic, even with many writers.
+    if (write(pipes[sub][1], msg, size) != size) fail("write");
+}
+
+int pipe_receive(int sub, char *msg, int size) {
+    int got = 0, ret;
+    while (got < size) {
+        ret = read(pipes[sub][0], msg + got, size - got);
+        if (ret == 0) return -1;
+        if (ret == -1) fail("read");
+        got += ret;
+    }
+    return got;
+}
+
+void pipe_kick(void) {
+    int i;
+    // Readers get EOF once the pipe is empty.
+    for (i = 0; i < cur_cfg.subs; i++) {
+        if (pipes[i][1] != -1) close(pipes[i][1]);
+        pipes[i][1] = -1;
+    }
+}
+
+void pipe_teardown(void) {
+    int i;
+    for (i = 0; i < cur_cfg.subs; i++) close(pipes[i][0]);
+}
+
+/* ### POSIX message queues: one for each subscriber. ### */
+
+mqd_t mqs[MAX_FAN];
+char mq_names[MAX_FAN][32];
+int mq_kicked;
+
+void mq_setup(const run_cfg_t *cfg) {
+    struct mq_attr attr;
+    int i;
+    memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = MQ_DEPTH;
+    attr.mq_msgsize = cfg->size;
+    mq_kicked = 0;
+    for (i = 0; i < cfg->subs; i++) {
+        snprintf(mq_names[i], sizeof(mq_names[i]), "/ipc_bench_%d_%d",
+                 (int)getpid(), i);
+        mqs[i] = mq_open(mq_names[i], O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+        if (mqs[i] == (mqd_t)-1) fail("mq_open");
+    }
+}
+
+void mq_bench_send(int sub, const char *msg, int size) {
+    if (mq_send(mqs[sub], msg, size, 0)) fail("mq_send");
+}
+
+int mq_bench_receive(int sub, char *msg, int size) {
+    ssize_t ret = mq_receive(mqs[sub], msg, size, NULL);
+    if (ret == -1) fail("mq_receive");
+    // Empty messages are only sent to kick subscribers out.
+    return ret ? (int)ret : -1;
+}
+
+void mq_kick(void) {
+    struct timespec timeout;
+    int i;
+    // A single empty message is enough, since it's queued after the others.
+    if (mq_kicked) return;
+    mq_kicked = 1;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec++;
+    for (i = 0; i < cur_cfg.subs; i++)
+        if (mq_timedsend(mqs[i], "", 0, 0, &timeout) && (errno != ETIMEDOUT))
+            fail("mq_timedsend");
+}
+
+void mq_teardown(void) {
+    int i;
+    for (i = 0; i < cur_cfg.subs; i++) {
+        mq_close(mqs[i]);
+        mq_unlink(mq_names[i]);
+    }
+}
+
+/* ### Shared memory rings: one for each subscriber, with futex or eventfd
+ * semaphores counting full and free slots. ### */
+
+/* Counting semaphore on a futex word. */
+typedef struct {
+    int count;
+    int waiters;
+} fsem_t;
+
+/* Single-consumer, multi-producer ring in shared memory. */
+typedef struct {
+    fsem_t items;            // Futex semaphores: full slots...
+    fsem_t slots;            // ...and free ones.
+    int items_fd;            // Eventfd semaphores: full slots...
+    int slots_fd;            // ...and free ones.
+    unsigned long head;      // Next slot to read, consumer only.
+    unsigned long tail;      // Next slot to write, shared by producers.
+    int kicked;              // Subscriber must leave once empty.
+    int ready[RING_SLOTS];   // Whether a slot holds a message.
+    char data[];             // Slots.
+} ring_t;
+
+ring_t *rings[MAX_FAN];
+size_t ring_size;
+int ring_efd;  // Whether rings use eventfds or futexes.
+
+/**
+ * @brief Waits on a futex semaphore.
+ *
+ * @param sem Semaphore to wait on.
+ */
+void fsem_down(fsem_t *sem) {
+    int val;
+    for (;;) {
+        val = __atomic_load_n(&sem->count, __ATOMIC_SEQ_CST);
+        while (val > 0)
+            if (__atomic_compare_exchange_n(&sem->count, &val, val - 1, 0,
+                                            __ATOMIC_SEQ_CST,
+                                            __ATOMIC_SEQ_CST))
+                return;
+        __atomic_add_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, &sem->count, FUTEX_WAIT, 0, NULL, NULL, 0);
+        __atomic_sub_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * @brief Posts a futex semaphore, waking a waiter if there's one.
+ *
+ * @param sem Semaphore to post.
+ */
+void fsem_up(fsem_t *sem) {
+    __atomic_add_fetch(&sem->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &sem->count, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/**
+ * @brief Waits on an eventfd semaphore.
+ *
+ * @param fd Eventfd to read.
+ */
+void efd_down(int fd) {
+    uint64_t val;
+    if (read(fd, &val, sizeof(val)) != sizeof(val)) fail("read");
+}
+
+/**
+ * @brief Posts an eventfd semaphore.
+ *
+ * @param fd Eventfd to write.
+ */
+void efd_up(int fd) {
+    uint64_t val = 1;
+    if (write(fd, &val, sizeof(val)) != sizeof(val)) fail("write");
+}
+
+void ring_setup(const run_cfg_t *cfg) {
+    int i;
+    ring_size = sizeof(ring_t) + (size_t)RING_SLOTS * cfg->size;
+    for (i = 0; i < cfg->subs; i++) {
+        // Shared mappings, as two processes would use.
+        rings[i] = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (rings[i] == MAP_FAILED) fail("mmap");
+        rings[i]->slots.count = RING_SLOTS;
+        rings[i]->items_fd = -1;
+        rings[i]->slots_fd = -1;
+        if (!ring_efd) continue;
+        rings[i]->items_fd = eventfd(0, EFD_SEMAPHORE);
+        rings[i]->slots_fd = eventfd(RING_SLOTS, EFD_SEMAPHORE);
+        if ((rings[i]->items_fd == -1) || (rings[i]->slots_fd == -1))
+            fail("eventfd");
+    }
+}
+
+void futex_setup(const run_cfg_t *cfg) {
+    ring_efd = 0;
+    ring_setup(cfg);
+}
+
+void eventfd_setup(const run_cfg_t *cfg) {
+    ring_efd = 1;
+    ring_setup(cfg);
+}
+
+void ring_send(int sub, const char *msg, int size) {
+    ring_t *ring = rings[sub];
+    unsigned long slot;
+    if (ring_efd) efd_down(ring->slots_fd);
+    else fsem_down(&ring->slots);
+    slot = __atomic_fetch_add(&ring->tail, 1, __ATOMIC_RELAXED) % RING_SLOTS;
+    memcpy(ring->data + slot * size, msg, size);
+    __atomic_store_n(&ring->ready[slot], 1, __ATOMIC_RELEASE);
+    if (ring_efd) efd_up(ring->items_fd);
+    else fsem_up(&ring->items);
+}
+
+int ring_receive(int sub, char *msg, int size) {
+    ring_t *ring = rings[sub];
+    unsigned long slot = ring->head % RING_SLOTS;
+    if (ring_efd) efd_down(ring->items_fd);
+    else fsem_down(&ring->items);
+    // Producers of earlier slots may still be copying.
+    while (!__atomic_load_n(&ring->ready[slot], __ATOMIC_ACQUIRE))
+        if (__atomic_load_n(&ring->kicked, __ATOMIC_ACQUIRE)) return -1;
+    memcpy(msg, ring->data + slot * size, size);
+    __atomic_store_n(&ring->ready[slot], 0, __ATOMIC_RELAXED);
+    ring->head++;
+    if (ring_efd) efd_up(ring->slots_fd);
+    else fsem_up(&ring->slots);
+    return size;
+}
+
+void ring_kick(void) {
+    int i;
+    // Publishers are gone, so an empty slot means there's nothing left.
+    if (__atomic_load_n(&rings[0]->kicked, __ATOMIC_ACQUIRE)) return;
+    for (i = 0; i < cur_cfg.subs; i++) {
+        __atomic_store_n(&rings[i]->kicked, 1, __ATOMIC_RELEASE);
+        if (ring_efd) efd_up(rings[i]->items_fd);
+        else fsem_up(&rings[i]->items);
+    }
+}
+
+void ring_teardown(void) {
+    int i;
+    for (i = 0; i < cur_cfg.subs; i++) {
+        if (ring_efd) {
+            close(rings[i]->items_fd);
+            close(rings[i]->slots_fd);
+        }
+        munmap(rings[i], ring_size);
+    }
+}
+
+#define BACKENDS 5
+
+const backend_t backends[BACKENDS] = {
+    {"tag", 1, tag_setup, tag_bench_send, tag_bench_receive, tag_kick,
+     tag_teardown},
+    {"pipe", 0, pipe_setup, pipe_send, pipe_receive, pipe_kick,
+     pipe_teardown},
+    {"mqueue", 0, mq_setup, mq_bench_send, mq_bench_receive, mq_kick,
+     mq_teardown},
+    {"futex", 0, futex_setup, ring_send, ring_receive, ring_kick,
+     ring_teardown},
+    {"eventfd", 0, eventfd_setup, ring_send, ring_receive, ring_kick,
+     ring_teardown}};
+
+const backend_t *be;
+
+/**
+ * @brief Computes latency percentiles merging the histograms of some threads.
+ *
+ * @param data Threads data.
+ * @param nr Number of threads.
+ * @param res Array to fill with percentiles, in nanoseconds.
+ */
+void workers_pcts(worker_t *data, int nr, unsigned long long *res) {
+    static unsigned long long merged[HIST_BUCKETS];
+    int i, j;
+    memset(merged, 0, sizeof(merged));
+    for (i = 0; i < nr; i++)
+        for (j = 0; j < HIST_BUCKETS; j++) merged[j] += data[i].hist[j];
+    hist_pcts(merged, pcts, NR_PCTS, res);
+}
+
+/**
+ * @brief Publisher routine: stamps and publishes messages to all subscribers
+ * until told to stop, timing each publication.
+ *
+ * @param arg Thread data.
+ * @return Thread exit status.
+ */
+void *publisher(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    unsigned long long stamp;
+    struct timespec next;
+    char msg[MAX_SIZE];
+    int i;
+    memset(msg, 0, sizeof(msg));
+    pthread_barrier_wait(&start_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop) {
+        stamp = now_ns();
+        memcpy(msg, &stamp, STAMP_SIZE);
+        if (be->fan_out) be->send(0, msg, cur_cfg.size);
+        else for (i = 0; i < cur_cfg.subs; i++)
+            be->send(i, msg, cur_cfg.size);
+        hist_add(me->hist, now_ns() - stamp);
+        me->ops++;
+        if (period_ns == 0) continue;
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Subscriber routine: receives messages until kicked out, timing
+ * their delivery from the stamp the publisher put in them.
+ *
+ * @param arg Thread data.
+ * @return Thread exit status.
+ */
+void *subscriber(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    unsigned long long stamp;
+    char msg[MAX_SIZE];
+    pthread_barrier_wait(&start_barrier);
+    while (be->receive(me->id, msg, cur_cfg.size) != -1) {
+        memcpy(&stamp, msg, STAMP_SIZE);
+        hist_add(me->hist, now_ns() - stamp);
+        me->ops++;
+    }
+    pthread_mutex_lock(&done_lock);
+    subs_done++;
+    pthread_mutex_unlock(&done_lock);
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Performs a single run.
+ *
+ * @param cfg Run parameters.
+ * @param duration Duration of the run, in seconds.
+ * @param res Results to fill.
+ */
+void run(const run_cfg_t *cfg, int duration, run_res_t *res) {
+    worker_t *pubs_data, *subs_data;
+    unsigned long long start, end;
+    int i, done;
+    pubs_data = calloc(cfg->pubs, sizeof(worker_t));
+    subs_data = calloc(cfg->subs, sizeof(worker_t));
+    if ((pubs_data == NULL) || (subs_data == NULL)) fail("calloc");
+    cur_cfg = *cfg;
+    be = &backends[cfg->backend];
+    be->setup(cfg);
+    stop = 0;
+    subs_done = 0;
+    pthread_barrier_init(&start_barrier, NULL, cfg->pubs + cfg->subs + 1);
+    for (i = 0; i < cfg->subs; i++) {
+        subs_data[i].id = i;
+        if (pthread_create(&subs_data[i].tid, NULL, subscriber,
+                           &subs_data[i]))
+            fail("pthread_create");
+    }
+    for (i = 0; i < cfg->pubs; i++) {
+        pubs_data[i].id = i;
+        if (pthread_create(&pubs_data[i].tid, NULL, publisher, &pubs_data[i]))
+            fail("pthread_create");
+    }
+    pthread_barrier_wait(&start_barrier);
+    start = now_ns();
+    sleep(duration);
+    stop = 1;
+    for (i = 0; i < cfg->pubs; i++) pthread_join(pubs_data[i].tid, NULL);
+    // Subscribers drain what's left, then leave when kicked.
+    do {
+        be->kick();
+        usleep(1000);
+        pthread_mutex_lock(&done_lock);
+        done = subs_done;
+        pthread_mutex_unlock(&done_lock);
+    } while (done < cfg->subs);
+    end = now_ns();
+    for (i = 0; i < cfg->subs; i++) pthread_join(subs_data[i].tid, NULL);
+    pthread_barrier_destroy(&start_barrier);
+    be->teardown();
+    // Collect results.
+    memset(res, 0, sizeof(run_res_t));
+    res->secs = (double)(end - start) / 1e9;
+    for (i = 0; i < cfg->pubs; i++) res->sent += pubs_data[i].ops;
+    for (i = 0; i < cfg->subs; i++) res->received += subs_data[i].ops;
+    res->expected = res->sent * cfg->subs;
+    workers_pcts(pubs_data, cfg->pubs, res->send_p);
+    workers_pcts(subs_data, cfg->subs, res->dlv_p);
+    free(pubs_data);
+    free(subs_data);
+}
+
+/**
+ * @brief Prints the results of a run.
+ *
+ * @param out Output stream.
+ * @param fmt Output format.
+ * @param first Whether this is the first run.
+ * @param label Label of the runs, e.g. the module build.
+ * @param cfg Run parameters.
+ * @param res Run results.
+ */
+void print_run(FILE *out, int fmt, int first, const char *label,
+               const run_cfg_t *cfg, const run_res_t *res) {
+    double tput = (double)res->received / res->secs;
+    unsigned long lost = res->expected - res->received;
+    if (fmt == OUT_CSV) {
+        if (first)
+            fprintf(out, "label,backend,pattern,publishers,subscribers,size,"
+                         "secs,sent,expected,received,lost,rcv_tput,"
+                         "send_p50_ns,send_p99_ns,send_p999_ns,dlv_p50_ns,"
+                         "dlv_p99_ns,dlv_p999_ns\n");
+        fprintf(out, "%s,%s,%s,%d,%d,%d,%.3f,%lu,%lu,%lu,%lu,%.1f,"
+                     "%llu,%llu,%llu,%llu,%llu,%llu\n",
+                label, backends[cfg->backend].name, pat_names[cfg->pattern],
+                cfg->pubs, cfg->subs, cfg->size, res->secs, res->sent,
+                res->expected, res->received, lost, tput, res->send_p[0],
+                res->send_p[1], res->send_p[2], res->dlv_p[0], res->dlv_p[1],
+                res->dlv_p[2]);
+    } else {
+        fprintf(out, "%s  {\"label\": \"%s\", \"backend\": \"%s\", "
+                     "\"pattern\": \"%s\", \"publishers\": %d, "
+                     "\"subscribers\": %d, \"size\": %d, \"secs\": %.3f, "
+                     "\"sent\": %lu, \"expected\": %lu, \"received\": %lu, "
+                     "\"lost\": %lu, \"rcv_tput\": %.1f, "
+                     "\"send_p50_ns\": %llu, \"send_p99_ns\": %llu, "
+                     "\"send_p999_ns\": %llu, \"dlv_p50_ns\": %llu, "
+                     "\"dlv_p99_ns\": %llu, \"dlv_p999_ns\": %llu}",
+                first ? "[\n" : ",\n", label, backends[cfg->backend].name,
+                pat_names[cfg->pattern], cfg->pubs, cfg->subs, cfg->size,
+                res->secs, res->sent, res->expected, res->received, lost,
+                tput, res->send_p[0], res->send_p[1], res->send_p[2],
+                res->dlv_p[0], res->dlv_p[1], res->dlv_p[2]);
+    }
+    fflush(out);
+}
+
+/**
+ * @brief Parses a comma-separated list of names to sweep.
+ *
+ * @param str String to parse.
+ * @param sweep List to fill with indexes of the names.
+ * @param names Valid names.
+ * @param nr_names Number of valid names.
+ * @return 0 if the list is valid, -1 otherwise.
+ */
+int parse_names(char *str, sweep_t *sweep, const char **names,
+                int nr_names) {
+    char *tok;
+    int i;
+    sweep->nr = 0;
+    for (tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        for (i = 0; i < nr_names; i++)
+            if (!strcmp(tok, names[i])) break;
+        if ((i == nr_names) || (sweep->nr == MAX_SWEEP)) return -1;
+        sweep->vals[sweep->nr++] = i;
+    }
+    return sweep->nr ? 0 : -1;
+}
+
+/**
+ * @brief Parses a comma-separated list of sizes to sweep.
+ *
+ * @param str String to parse.
+ * @param sweep List to fill.
+ * @return 0 if the list is valid, -1 otherwise.
+ */
+int parse_sizes(char *str, sweep_t *sweep) {
+    char *tok, *end;
+    long val;
+    sweep->nr = 0;
+    for (tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        val = strtol(tok, &end, 10);
+        if ((*end != '\0') || (val < MIN_SIZE) || (val > MAX_SIZE) ||
+            (sweep->nr == MAX_SWEEP))
+            return -1;
+        sweep->vals[sweep->nr++] = (int)val;
+    }
+    return sweep->nr ? 0 : -1;
+}
+
+/**
+ * @brief Prints usage information and exits.
+ */
+void usage(void) {
+    fprintf(stderr, "Usage:\n\tipc_bench [-b BACKENDS] [-p PATTERNS] "
+                    "[-n FAN] [-s SIZES] [-r RATE]\n"
+                    "\t          [-d SECONDS] [-f csv|json] [-o FILE] "
+                    "[-t LABEL]\n"
+                    "\tBACKENDS: Comma-separated list among tag, pipe, "
+                    "mqueue, futex, eventfd.\n"
+                    "\tPATTERNS: Comma-separated list among 1:1, 1:N, N:1.\n"
+                    "\tFAN: Value of N (default: 4).\n"
+                    "\tSIZES: Comma-separated list, from %d to %d bytes "
+                    "(default: 64).\n"
+                    "\tRATE: Messages per second of each publisher, 0 means "
+                    "as fast as possible\n\t      (default: 0).\n",
+            MIN_SIZE, MAX_SIZE);
+    exit(EXIT_FAILURE);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    char bes_dfl[] = "tag,pipe,mqueue,futex,eventfd";
+    char pats_dfl[] = "1:1,1:N,N:1", szs_dfl[] = "64";
+    const char *be_names[BACKENDS];
+    sweep_t bes, pats, szs;
+    int fmt = OUT_CSV, duration = 2, fan = 4, rate = 0, first = 1, opt;
+    int b, p, s;
+    const char *label = "default";
+    FILE *out = stdout;
+    run_cfg_t cfg;
+    run_res_t res;
+    for (b = 0; b < BACKENDS; b++) be_names[b] = backends[b].name;
+    parse_names(bes_dfl, &bes, be_names, BACKENDS);
+    parse_names(pats_dfl, &pats, pat_names, PATTERNS);
+    parse_sizes(szs_dfl, &szs);
+    while ((opt = getopt(argc, argv, "b:p:n:s:r:d:f:o:t:")) != -1) {
+        switch (opt) {
+        case 'b':
+            if (parse_names(optarg, &bes, be_names, BACKENDS)) usage();
+            break;
+        case 'p':
+            if (parse_names(optarg, &pats, pat_names, PATTERNS)) usage();
+            break;
+        case 'n':
+            fan = atoi(optarg);
+            if ((fan <= 0) || (fan > MAX_FAN)) usage();
+            break;
+        case 's':
+            if (parse_sizes(optarg, &szs)) usage();
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            if (rate < 0) usage();
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            if (duration <= 0) usage();
+            break;
+        case 'f':
+            if (!strcmp(optarg, "csv")) fmt = OUT_CSV;
+            else if (!strcmp(optarg, "json")) fmt = OUT_JSON;
+            else usage();
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (out == NULL) fail("fopen");
+            break;
+        case 't':
+            label = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc) usage();
+    period_ns = rate ? 1000000000L / rate : 0;
+    // One run for each combination, progress goes to stderr.
+    for (p = 0; p < pats.nr; p++)
+    for (s = 0; s < szs.nr; s++)
+    for (b = 0; b < bes.nr; b++) {
+        cfg.backend = bes.vals[b];
+        cfg.pattern = pats.vals[p];
+        cfg.pubs = (cfg.pattern == PAT_NTO1) ? fan : 1;
+        cfg.subs = (cfg.pattern == PAT_1TON) ? fan : 1;
+        cfg.size = szs.vals[s];
+        fprintf(stderr, "Running %s, %s, %d publisher(s), %d subscriber(s), "
+                        "%d byte(s)...\n", backends[cfg.backend].name,
+                pat_names[cfg.pattern], cfg.pubs, cfg.subs, cfg.size);
+        run(&cfg, duration, &res);
+        print_run(out, fmt, first, label, &cfg, &res);
+        first = 0;
+    }
+    if (fmt == OUT_JSON) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "IPC benchmark done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,512 @@
+/**
+ * @brief Load benchmark for AOS-TAG.
+ *        Sweeps readers, writers, levels, instances, message sizes and CPU
+ *        pinning layouts, and reports wall-clock throughput and latency
+ *        percentiles of each run as CSV or JSON.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <sys/sysinfo.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+#include "bench.h"
+
+#define MAX_THREADS 1024   // Max readers, and max writers, in a run.
+#define MAX_INSTANCES 256  // Max instances in a run.
+#define MAX_SIZE 65536     // Max message size, the module may allow less.
+#define STAMP_SIZE sizeof(unsigned long long)
+
+/* CPU pinning layouts. */
+#define PIN_NONE 0    // No affinity.
+#define PIN_SPLIT 1   // Writers on CPU 0, readers on all others.
+#define PIN_SPREAD 2  // Each thread on a CPU, round-robin.
+#define PIN_SAME 3    // Everyone on CPU 0.
+#define PIN_LAYOUTS 4
+
+const char *pin_names[PIN_LAYOUTS] = {"none", "split", "spread", "same"};
+
+/* Output formats. */
+#define OUT_CSV 0
+#define OUT_JSON 1
+
+#define NR_PCTS 3
+
+const double pcts[NR_PCTS] = {0.5, 0.99, 0.999};
+
+/* Parameters of a single run. */
+typedef struct {
+    int readers;
+    int writers;
+    int levels;
+    int instances;
+    int size;
+    int pin;
+} run_cfg_t;
+
+/* Data of a reader or writer: target, counters and latency histogram. */
+typedef struct {
+    pthread_t tid;
+    int tag;
+    int level;
+    int size;
+    unsigned long ops;        // Messages sent, or received.
+    unsigned long delivered;  // Messages sent that someone got.
+    unsigned long long hist[HIST_BUCKETS];
+} worker_t;
+
+/* Results of a single run. */
+typedef struct {
+    double secs;
+    unsigned long sends;
+    unsigned long delivered;
+    unsigned long receives;
+    unsigned long long send_p[NR_PCTS];
+    unsigned long long dlv_p[NR_PCTS];
+} run_res_t;
+
+int tags[MAX_INSTANCES];
+
+pthread_barrier_t start_barrier;
+volatile int stop;
+
+int readers_done;
+pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int cpus;
+
+/**
+ * @brief Computes latency percentiles merging the histograms of some threads.
+ *
+ * @param data Threads data.
+ * @param nr Number of threads.
+ * @param res Array to fill with percentiles, in nanoseconds.
+ */
+void workers_pcts(worker_t *data, int nr, unsigned long long *res) {
+    static unsigned long long merged[HIST_BUCKETS];
+    int i, j;
+    memset(merged, 0, sizeof(merged));
+    for (i = 0; i < nr; i++)
+        for (j = 0; j < HIST_BUCKETS; j++) merged[j] += data[i].hist[j];
+    hist_pcts(merged, pcts, NR_PCTS, res);
+}
+
+/**
+ * @brief Sets the CPU affinity of a thread to be created, given a layout.
+ *
+ * @param attr Attributes of the thread.
+ * @param pin Pinning layout.
+ * @param is_writer Whether the thread is a writer.
+ * @param idx Index of the thread among all those of the run.
+ */
+void pin_thread(pthread_attr_t *attr, int pin, int is_writer, int idx) {
+    cpu_set_t mask;
+    int i;
+    CPU_ZERO(&mask);
+    switch (pin) {
+    case PIN_SPLIT:
+        // Readers can't have CPU 0 only if it's the one we've got.
+        if (is_writer || (cpus == 1)) CPU_SET(0, &mask);
+        else for (i = 1; i < cpus; i++) CPU_SET(i, &mask);
+        break;
+    case PIN_SPREAD:
+        CPU_SET(idx % cpus, &mask);
+        break;
+    case PIN_SAME:
+        CPU_SET(0, &mask);
+        break;
+    default:
+        return;
+    }
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &mask);
+}
+
+/**
+ * @brief Allocates a message buffer for a thread.
+ *
+ * @param size Size of the buffer.
+ * @return Pointer to the buffer, NULL if size is zero.
+ */
+char *alloc_msg(int size) {
+    char *msg;
+    if (size == 0) return NULL;
+    msg = calloc(size, 1);
+    if (msg == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate message buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    return msg;
+}
+
+/**
+ * @brief Writer routine: sends timestamped messages until told to stop,
+ * timing each send.
+ *
+ * @param arg Thread data.
+ * @return Thread exit status.
+ */
+void *writer(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    char *msg = alloc_msg(me->size);
+    unsigned long long stamp;
+    int ret;
+    pthread_barrier_wait(&start_barrier);
+    while (!stop) {
+        stamp = now_ns();
+        if (me->size >= (int)STAMP_SIZE) memcpy(msg, &stamp, STAMP_SIZE);
+        ret = tag_send(me->tag, me->level, msg, me->size);
+        if (ret == -1) {
+            fprintf(stderr, "ERROR: Failed to send message.\n");
+            perror("tag_send");
+            exit(EXIT_FAILURE);
+        }
+        hist_add(me->hist, now_ns() - stamp);
+        me->ops++;
+        if (ret != 1) me->delivered++;
+    }
+    free(msg);
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Reader routine: receives messages until told to stop, timing their
+ * delivery from the stamp the writer put in them.
+ *
+ * @param arg Thread data.
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    char *msg = alloc_msg(me->size);
+    unsigned long long stamp;
+    int ret;
+    pthread_barrier_wait(&start_barrier);
+    while (!stop) {
+        ret = tag_receive(me->tag, me->level, msg, me->size);
+        if (ret == -1) {
+            // AWAKE_ALL is how the main thread makes readers check the flag.
+            if ((errno == ECANCELED) || (errno == EINTR)) continue;
+            fprintf(stderr, "ERROR: Failed to receive message.\n");
+            perror("tag_receive");
+            exit(EXIT_FAILURE);
+        }
+        if (ret >= (int)STAMP_SIZE) {
+            memcpy(&stamp, msg, STAMP_SIZE);
+            hist_add(me->hist, now_ns() - stamp);
+        }
+        me->ops++;
+    }
+    free(msg);
+    pthread_mutex_lock(&done_lock);
+    readers_done++;
+    pthread_mutex_unlock(&done_lock);
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Spawns a reader or writer, bound to an instance and a level.
+ *
+ * @param data Thread data.
+ * @param cfg Run parameters.
+ * @param is_writer Whether the thread is a writer.
+ * @param i Index of the thread among those of its kind.
+ */
+void spawn(worker_t *data, const run_cfg_t *cfg, int is_writer, int i) {
+    pthread_attr_t attr;
+    // Threads are laid out on instances first, then on levels.
+    data->tag = tags[i % cfg->instances];
+    data->level = (i / cfg->instances) % cfg->levels;
+    data->size = cfg->size;
+    pthread_attr_init(&attr);
+    pin_thread(&attr, cfg->pin, is_writer, is_writer ? i : cfg->writers + i);
+    if (pthread_create(&data->tid, &attr, is_writer ? writer : reader,
+                       data)) {
+        fprintf(stderr, "ERROR: Failed to spawn %s no. %d.\n",
+                is_writer ? "writer" : "reader", i);
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Performs a single run on new private instances.
+ *
+ * @param cfg Run parameters.
+ * @param duration Duration of the run, in seconds.
+ * @param res Results to fill.
+ */
+void run(const run_cfg_t *cfg, int duration, run_res_t *res) {
+    worker_t *readers_data, *writers_data;
+    unsigned long long start, end;
+    int i, done;
+    readers_data = calloc(cfg->readers + 1, sizeof(worker_t));
+    writers_data = calloc(cfg->writers, sizeof(worker_t));
+    if ((readers_data == NULL) || (writers_data == NULL)) {
+        fprintf(stderr, "ERROR: Failed to allocate threads data.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < cfg->instances; i++) {
+        tags[i] = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_USR);
+        if (tags[i] == -1) {
+            fprintf(stderr, "ERROR: Failed to create instance no. %d.\n", i);
+            perror("tag_get");
+            exit(EXIT_FAILURE);
+        }
+    }
+    stop = 0;
+    readers_done = 0;
+    pthread_barrier_init(&start_barrier, NULL,
+                         cfg->readers + cfg->writers + 1);
+    for (i = 0; i < cfg->readers; i++) spawn(&readers_data[i], cfg, 0, i);
+    for (i = 0; i < cfg->writers; i++) spawn(&writers_data[i], cfg, 1, i);
+    pthread_barrier_wait(&start_barrier);
+    start = now_ns();
+    sleep(duration);
+    stop = 1;
+    for (i = 0; i < cfg->writers; i++) pthread_join(writers_data[i].tid, NULL);
+    end = now_ns();
+    // Readers might be waiting, or about to: kick them until they're all out.
+    do {
+        for (i = 0; i < cfg->instances; i++) {
+            if (tag_ctl(tags[i], AWAKE_ALL)) {
+                fprintf(stderr, "ERROR: Failed to awake readers.\n");
+                perror("tag_ctl");
+                exit(EXIT_FAILURE);
+            }
+        }
+        usleep(1000);
+        pthread_mutex_lock(&done_lock);
+        done = readers_done;
+        pthread_mutex_unlock(&done_lock);
+    } while (done < cfg->readers);
+    for (i = 0; i < cfg->readers; i++) pthread_join(readers_data[i].tid, NULL);
+    pthread_barrier_destroy(&start_barrier);
+    for (i = 0; i < cfg->instances; i++) {
+        if (tag_ctl(tags[i], REMOVE)) {
+            fprintf(stderr, "ERROR: Failed to remove instance no. %d.\n", i);
+            perror("tag_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Collect results.
+    memset(res, 0, sizeof(run_res_t));
+    res->secs = (double)(end - start) / 1e9;
+    for (i = 0; i < cfg->writers; i++) {
+        res->sends += writers_data[i].ops;
+        res->delivered += writers_data[i].delivered;
+    }
+    for (i = 0; i < cfg->readers; i++) res->receives += readers_data[i].ops;
+    workers_pcts(writers_data, cfg->writers, res->send_p);
+    workers_pcts(readers_data, cfg->readers, res->dlv_p);
+    free(readers_data);
+    free(writers_data);
+}
+
+/**
+ * @brief Prints the results of a run.
+ *
+ * @param out Output stream.
+ * @param fmt Output format.
+ * @param first Whether this is the first run.
+ * @param label Label of the runs, e.g. the module build.
+ * @param cfg Run parameters.
+ * @param res Run results.
+ */
+void print_run(FILE *out, int fmt, int first, const char *label,
+               const run_cfg_t *cfg, const run_res_t *res) {
+    double send_tput = (double)res->sends / res->secs;
+    double rcv_tput = (double)res->receives / res->secs;
+    if (fmt == OUT_CSV) {
+        if (first)
+            fprintf(out, "label,readers,writers,levels,instances,size,pinning,"
+                         "secs,sends,delivered,discarded,receives,send_tput,"
+                         "rcv_tput,send_p50_ns,send_p99_ns,send_p999_ns,"
+                         "dlv_p50_ns,dlv_p99_ns,dlv_p999_ns\n");
+        fprintf(out, "%s,%d,%d,%d,%d,%d,%s,%.3f,%lu,%lu,%lu,%lu,%.1f,%.1f,"
+                     "%llu,%llu,%llu,%llu,%llu,%llu\n",
+                label, cfg->readers, cfg->writers, cfg->levels,
+                cfg->instances, cfg->size, pin_names[cfg->pin], res->secs,
+                res->sends, res->delivered, res->sends - res->delivered,
+                res->receives, send_tput, rcv_tput, res->send_p[0],
+                res->send_p[1], res->send_p[2], res->dlv_p[0], res->dlv_p[1],
+                res->dlv_p[2]);
+    } else {
+        fprintf(out, "%s  {\"label\": \"%s\", \"readers\": %d, "
+                     "\"writers\": %d, \"levels\": %d, \"instances\": %d, "
+                     "\"size\": %d, \"pinning\": \"%s\", \"secs\": %.3f, "
+                     "\"sends\": %lu, \"delivered\": %lu, "
+                     "\"discarded\": %lu, \"receives\": %lu, "
+                     "\"send_tput\": %.1f, \"rcv_tput\": %.1f, "
+                     "\"send_p50_ns\": %llu, \"send_p99_ns\": %llu, "
+                     "\"send_p999_ns\": %llu, \"dlv_p50_ns\": %llu, "
+                     "\"dlv_p99_ns\": %llu, \"dlv_p999_ns\": %llu}",
+                first ? "[\n" : ",\n", label, cfg->readers, cfg->writers,
+                cfg->levels, cfg->instances, cfg->size, pin_names[cfg->pin],
+                res->secs, res->sends, res->delivered,
+                res->sends - res->delivered, res->receives, send_tput,
+                rcv_tput, res->send_p[0], res->send_p[1], res->send_p[2],
+                res->dlv_p[0], res->dlv_p[1], res->dlv_p[2]);
+    }
+    fflush(out);
+}
+
+/**
+ * @brief Parses a comma-separated list of values to sweep.
+ *
+ * @param str String to parse.
+ * @param sweep List to fill.
+ * @param min Minimum value allowed.
+ * @param max Maximum value allowed.
+ * @return 0 if the list is valid, -1 otherwise.
+ */
+int parse_sweep(char *str, sweep_t *sweep, int min, int max) {
+    char *tok, *end;
+    long val;
+    sweep->nr = 0;
+    for (tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        val = strtol(tok, &end, 10);
+        if ((*end != '\0') || (val < min) || (val > max) ||
+            (sweep->nr == MAX_SWEEP))
+            return -1;
+        sweep->vals[sweep->nr++] = (int)val;
+    }
+    return sweep->nr ? 0 : -1;
+}
+
+/**
+ * @brief Parses a comma-separated list of pinning layouts to sweep.
+ *
+ * @param str String to parse.
+ * @param sweep List to fill.
+ * @return 0 if the list is valid, -1 otherwise.
+ */
+int parse_pins(char *str, sweep_t *sweep) {
+    char *tok;
+    int i;
+    sweep->nr = 0;
+    for (tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        for (i = 0; i < PIN_LAYOUTS; i++)
+            if (!strcmp(tok, pin_names[i])) break;
+        if ((i == PIN_LAYOUTS) || (sweep->nr == MAX_SWEEP)) return -1;
+        sweep->vals[sweep->nr++] = i;
+    }
+    return sweep->nr ? 0 : -1;
+}
+
+/**
+ * @brief Prints usage information and exits.
+ */
+void usage(void) {
+    fprintf(stderr, "Usage:\n\tload_bench [-r READERS] [-w WRITERS] "
+                    "[-l LEVELS] [-i INSTANCES] [-s SIZES]\n"
+                    "\t           [-p none|split|spread|same] [-d SECONDS] "
+                    "[-f csv|json]\n"
+                    "\t           [-o FILE] [-t LABEL]\n"
+                    "Options -r, -w, -l, -i, -s and -p take comma-separated "
+                    "lists, and a run is\ndone for each combination.\n");
+    exit(EXIT_FAILURE);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    char rdrs_dfl[] = "1,8", wrts_dfl[] = "1,8", lvls_dfl[] = "1";
+    char inss_dfl[] = "1", szs_dfl[] = "0,64,1024", pins_dfl[] = "none";
+    sweep_t rdrs, wrts, lvls, inss, szs, pins;
+    int fmt = OUT_CSV, duration = 2, first = 1, opt;
+    int r, w, l, i, s, p;
+    const char *label = "default";
+    FILE *out = stdout;
+    run_cfg_t cfg;
+    run_res_t res;
+    parse_sweep(rdrs_dfl, &rdrs, 0, MAX_THREADS);
+    parse_sweep(wrts_dfl, &wrts, 1, MAX_THREADS);
+    parse_sweep(lvls_dfl, &lvls, 1, TAG_LEVELS);
+    parse_sweep(inss_dfl, &inss, 1, MAX_INSTANCES);
+    parse_sweep(szs_dfl, &szs, 0, MAX_SIZE);
+    parse_pins(pins_dfl, &pins);
+    while ((opt = getopt(argc, argv, "r:w:l:i:s:p:d:f:o:t:")) != -1) {
+        switch (opt) {
+        case 'r':
+            if (parse_sweep(optarg, &rdrs, 0, MAX_THREADS)) usage();
+            break;
+        case 'w':
+            if (parse_sweep(optarg, &wrts, 1, MAX_THREADS)) usage();
+            break;
+        case 'l':
+            if (parse_sweep(optarg, &lvls, 1, TAG_LEVELS)) usage();
+            break;
+        case 'i':
+            if (parse_sweep(optarg, &inss, 1, MAX_INSTANCES)) usage();
+            break;
+        case 's':
+            if (parse_sweep(optarg, &szs, 0, MAX_SIZE)) usage();
+            break;
+        case 'p':
+            if (parse_pins(optarg, &pins)) usage();
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            if (duration <= 0) usage();
+            break;
+        case 'f':
+            if (!strcmp(optarg, "csv")) fmt = OUT_CSV;
+            else if (!strcmp(optarg, "json")) fmt = OUT_JSON;
+            else usage();
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (out == NULL) {
+                fprintf(stderr, "ERROR: Failed to open output file.\n");
+                perror("fopen");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 't':
+            label = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc) usage();
+    cpus = get_nprocs();
+    // One run for each combination, progress goes to stderr.
+    for (r = 0; r < rdrs.nr; r++)
+    for (w = 0; w < wrts.nr; w++)
+    for (l = 0; l < lvls.nr; l++)
+    for (i = 0; i < inss.nr; i++)
+    for (s = 0; s < szs.nr; s++)
+    for (p = 0; p < pins.nr; p++) {
+        cfg.readers = rdrs.vals[r];
+        cfg.writers = wrts.vals[w];
+        cfg.levels = lvls.vals[l];
+        cfg.instances = inss.vals[i];
+        cfg.size = szs.vals[s];
+        cfg.pin = pins.vals[p];
+        fprintf(stderr, "Running %d reader(s), %d writer(s), %d level(s), "
+                        "%d instance(s), %d byte(s), %s pinning...\n",
+                cfg.readers, cfg.writers, cfg.levels, cfg.instances,
+                cfg.size, pin_names[cfg.pin]);
+        run(&cfg, duration, &res);
+        print_run(out, fmt, first, label, &cfg, &res);
+        first = 0;
+    }
+    if (fmt == OUT_JSON) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "Load benchmark done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,175 @@
+/**
+ * @brief Tester for lock contention accounting.
+ *        Must be run as root, since it switches accounting on and off.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define MAX_TAGS_PARAM "/sys/module/aos_tag/parameters/max_tags"
+#define LOCK_STATS_PARAM "/sys/module/aos_tag/parameters/lock_stats"
+#define TEST_KEY 4242
+#define TEST_LEVEL 9
+#define NR_SENDERS 8
+#define NR_SENDS 10000
+
+const char *class_names[TAG_LOCK_CLASSES] = {"receivers rwsem",
+                                             "senders rwsem",
+                                             "senders mutexes",
+                                             "AWAKE_ALL mutex",
+                                             "BST shards",
+                                             "instances mask"};
+
+int tag;
+
+/**
+ * @brief Sets the lock_stats module parameter.
+ *
+ * @param val New value.
+ */
+void set_lock_stats(const char *val) {
+    int param = open(LOCK_STATS_PARAM, O_WRONLY);
+    if ((param == -1) || (write(param, val, strlen(val)) == -1)) {
+        fprintf(stderr, "ERROR: Failed to set lock_stats.\n");
+        perror("lock_stats");
+        exit(EXIT_FAILURE);
+    }
+    close(param);
+}
+
+/**
+ * @brief Sender routine: hammers the test level, where no one is waiting.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *sender(void *arg) {
+    UNUSED(arg);
+    char msg[] = "Contended message";
+    int i;
+    for (i = 0; i < NR_SENDS; i++) {
+        if (tag_send(tag, TEST_LEVEL, msg, sizeof(msg)) == -1) {
+            fprintf(stderr, "ERROR: Failed to send message.\n");
+            perror("tag_send");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Prints the contention counters of a lock class.
+ *
+ * @param name Name of the class.
+ * @param st Counters to print.
+ */
+void print_lock_stats(const char *name, const struct tag_lock_stats *st) {
+    printf("  %-16s acquired: %lu, contended: %lu, wait: %lu ns, "
+           "hold: %lu ns\n", name, st->acquired, st->contended, st->wait_ns,
+           st->hold_ns);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    struct tag_lock_stats classes[TAG_LOCK_CLASSES];
+    const struct tag_stats *stats;
+    const struct tag_lock_stats *locks;
+    pthread_t senders[NR_SENDERS];
+    unsigned int max_tags;
+    int fd, i;
+    FILE *param;
+    // Get the size of the counters area.
+    param = fopen(MAX_TAGS_PARAM, "r");
+    if ((param == NULL) || (fscanf(param, "%u", &max_tags) != 1)) {
+        fprintf(stderr, "ERROR: Failed to read max_tags.\n");
+        exit(EXIT_FAILURE);
+    }
+    fclose(param);
+    fd = open(TAG_STATUS_DEVFILE, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "ERROR: Failed to open status device file.\n");
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    stats = tag_stats_map(fd, max_tags);
+    if (stats == NULL) {
+        fprintf(stderr, "ERROR: Failed to map traffic counters.\n");
+        perror("tag_stats_map");
+        exit(EXIT_FAILURE);
+    }
+    set_lock_stats("1");
+    tag = tag_get(TEST_KEY, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < NR_SENDERS; i++) {
+        if (pthread_create(&senders[i], NULL, sender, NULL)) {
+            fprintf(stderr, "ERROR: Failed to spawn sender.\n");
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < NR_SENDERS; i++) pthread_join(senders[i], NULL);
+    if (tag_ctl(tag, AWAKE_ALL)) {
+        fprintf(stderr, "ERROR: Failed to awake receivers.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    // Every send takes the senders rw_semaphore and the level mutex once.
+    locks = stats[tag].locks;
+    printf("Lock counters of tag %d:\n", tag);
+    for (i = 0; i < TAG_INST_LOCKS; i++)
+        print_lock_stats(class_names[i], &locks[i]);
+    if ((locks[TAG_LOCK_SNDL].acquired != NR_SENDERS * NR_SENDS) ||
+        (locks[TAG_LOCK_SND].acquired < NR_SENDERS * NR_SENDS) ||
+        (locks[TAG_LOCK_AWAKE].acquired != 1) ||
+        (locks[TAG_LOCK_SNDL].contended > locks[TAG_LOCK_SNDL].acquired)) {
+        fprintf(stderr, "ERROR: Bad instance lock counters.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_lock_stats(fd, classes) != TAG_LOCK_CLASSES) {
+        fprintf(stderr, "ERROR: Failed to read lock classes.\n");
+        perror("tag_lock_stats");
+        exit(EXIT_FAILURE);
+    }
+    printf("Lock classes:\n");
+    for (i = 0; i < TAG_LOCK_CLASSES; i++)
+        print_lock_stats(class_names[i], &classes[i]);
+    // Creation took a BST shard and the mask, for writing.
+    if ((classes[TAG_LOCK_SNDL].acquired < locks[TAG_LOCK_SNDL].acquired) ||
+        (classes[TAG_LOCK_BST].acquired == 0) ||
+        (classes[TAG_LOCK_MASK].acquired == 0)) {
+        fprintf(stderr, "ERROR: Bad lock class counters.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    set_lock_stats("0");
+    tag_stats_unmap(stats, max_tags);
+    close(fd);
+    printf("Lock stats tester done!\n");
+    exit(EXIT_SUCCESS);
+}
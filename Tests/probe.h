@@ -0,0 +1,51 @@
+/**
+ * @brief Message header and TSC clock shared by the latency probe talker and
+ *        listener.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+#include "bench.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROBE_HAS_TSC 1
+#else
+#define PROBE_HAS_TSC 0
+#endif
+
+/* Header at the start of each probe message. */
+struct probe_hdr {
+    uint64_t seq;      // Sequence number, from 0.
+    uint64_t mono_ns;  // CLOCK_MONOTONIC time of the send.
+    uint64_t tsc;      // TSC at the send, 0 if not available.
+    uint32_t flags;    // PROBE_* flags.
+    uint32_t size;     // Size of the whole message.
+};
+
+/* Header flags. */
+#define PROBE_END 0x1  // Last message, seq holds the number of messages sent.
+
+#define PROBE_HDR_SIZE sizeof(struct probe_hdr)
+
+/**
+ * @brief Reads the Time Stamp Counter, if there's one.
+ *
+ * @return Current TSC value, or 0.
+ */
+static inline uint64_t now_tsc(void) {
+#if PROBE_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+#endif
@@ -0,0 +1,342 @@
+/**
+ * @brief Latency probe listener: receives messages from a probe talker with
+ *        one or more receivers, and reports one-way latency distributions
+ *        and missed sequence numbers for each of them.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+#include "probe.h"
+
+#define MAX_RECEIVERS 256
+#define BUFSIZE_DFL 4096
+
+#define NR_PCTS 5
+
+const double pcts[NR_PCTS] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+const char *pct_names[NR_PCTS] = {"p50", "p90", "p99", "p999", "p9999"};
+
+/* A latency distribution. */
+typedef struct {
+    unsigned long long hist[HIST_BUCKETS];
+    uint64_t samples;
+    uint64_t min;
+    uint64_t max;
+} lat_dist_t;
+
+/* Data of a receiver. */
+typedef struct {
+    pthread_t tid;
+    int id;
+    uint64_t received;    // Probe messages received.
+    uint64_t bytes;       // Bytes received.
+    uint64_t first_seq;   // First sequence number seen.
+    uint64_t next_seq;    // Next expected sequence number.
+    uint64_t missed;      // Sequence numbers never seen.
+    uint64_t reordered;   // Messages older than the last one.
+    int started;          // Got at least a message.
+    int ended;            // Got the end message.
+    lat_dist_t mono;      // Latencies from CLOCK_MONOTONIC.
+    lat_dist_t tsc;       // Latencies from the TSC.
+} receiver_t;
+
+int tag, lvl;
+size_t bufsize = BUFSIZE_DFL;
+double tsc_per_ns;
+
+volatile int stop;
+
+int receivers_done;
+pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signal handler: only there to interrupt receivers. */
+void kick_handler(int sig) {
+    (void)sig;
+}
+
+/**
+ * @brief Records a latency in a distribution.
+ *
+ * @param dist Distribution to update.
+ * @param ns Latency, in nanoseconds.
+ */
+void dist_add(lat_dist_t *dist, uint64_t ns) {
+    if ((dist->samples == 0) || (ns < dist->min)) dist->min = ns;
+    if (ns > dist->max) dist->max = ns;
+    dist->samples++;
+    hist_add(dist->hist, ns);
+}
+
+/**
+ * @brief Prints the number of samples in a latency range, if any.
+ *
+ * @param lo Start of the range, in nanoseconds.
+ * @param hi End of the range, in nanoseconds.
+ * @param count Samples in the range.
+ * @param total Samples in the whole distribution.
+ */
+void dist_range(uint64_t lo, uint64_t hi, uint64_t count, uint64_t total) {
+    if (count == 0) return;
+    printf("    [%lu, %lu) ns: %lu (%.3f%%)\n", (unsigned long)lo,
+           (unsigned long)hi, (unsigned long)count,
+           100.0 * (double)count / (double)total);
+}
+
+/**
+ * @brief Prints percentiles of a distribution, and the number of samples in
+ * each power of two range.
+ *
+ * @param name Name of the distribution.
+ * @param dist Distribution to print.
+ */
+void dist_print(const char *name, const lat_dist_t *dist) {
+    unsigned long long res[NR_PCTS];
+    uint64_t range = 0, lo;
+    int i, g, p;
+    if (dist->samples == 0) {
+        printf("  %s latency: no samples.\n", name);
+        return;
+    }
+    hist_pcts(dist->hist, pcts, NR_PCTS, res);
+    printf("  %s latency (ns): min %lu", name, (unsigned long)dist->min);
+    for (p = 0; p < NR_PCTS; p++) printf(", %s %llu", pct_names[p], res[p]);
+    printf(", max %lu\n", (unsigned long)dist->max);
+    // Coarse distribution, one range for each power of two.
+    for (i = 0; i < HIST_LINEAR; i++) range += dist->hist[i];
+    dist_range(0, HIST_LINEAR, range, dist->samples);
+    for (g = 0; g < 63 - HIST_SUB_BITS; g++) {
+        range = 0;
+        for (i = 0; i < HIST_SUB; i++)
+            range += dist->hist[HIST_LINEAR + g * HIST_SUB + i];
+        lo = 1ULL << (g + HIST_SUB_BITS + 1);
+        dist_range(lo, lo << 1, range, dist->samples);
+    }
+}
+
+/**
+ * @brief Accounts for a probe message.
+ *
+ * @param me Receiver data.
+ * @param hdr Header of the message.
+ * @param size Size of the message.
+ * @param mono_now CLOCK_MONOTONIC time of the receive.
+ * @param tsc_now TSC at the receive.
+ */
+void account(receiver_t *me, const struct probe_hdr *hdr, int size,
+             uint64_t mono_now, uint64_t tsc_now) {
+    if (hdr->flags & PROBE_END) {
+        // Whatever we didn't get before the end is lost.
+        if (me->started && (hdr->seq > me->next_seq)) {
+            me->missed += hdr->seq - me->next_seq;
+            me->next_seq = hdr->seq;
+        }
+        me->ended = 1;
+        return;
+    }
+    if (!me->started) {
+        me->first_seq = hdr->seq;
+        me->next_seq = hdr->seq;
+        me->started = 1;
+    }
+    if (hdr->seq >= me->next_seq) {
+        me->missed += hdr->seq - me->next_seq;
+        me->next_seq = hdr->seq + 1;
+    } else {
+        // Counted as missed when we skipped it.
+        me->reordered++;
+        if (me->missed) me->missed--;
+    }
+    me->received++;
+    me->bytes += size;
+    if (mono_now >= hdr->mono_ns)
+        dist_add(&me->mono, mono_now - hdr->mono_ns);
+    if (hdr->tsc && tsc_now && (tsc_now >= hdr->tsc))
+        dist_add(&me->tsc, (uint64_t)((double)(tsc_now - hdr->tsc) /
+                                      tsc_per_ns));
+}
+
+/**
+ * @brief Receiver routine: receives and accounts for messages until the end
+ * message, an AWAKE_ALL, or the main thread says so.
+ *
+ * @param arg Receiver data.
+ * @return Thread exit status.
+ */
+void *receiver(void *arg) {
+    receiver_t *me = (receiver_t *)arg;
+    uint64_t mono_now, tsc_now;
+    struct probe_hdr hdr;
+    char *msg;
+    int ret;
+    msg = calloc(bufsize, 1);
+    if (msg == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate message buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    while (!stop && !me->ended) {
+        ret = tag_receive(tag, lvl, msg, bufsize);
+        tsc_now = now_tsc();
+        mono_now = now_ns();
+        if (ret == -1) {
+            if (errno == EINTR) continue;
+            if ((errno == ECANCELED) || (errno == EIDRM)) break;
+            fprintf(stderr, "ERROR: Receiver %d failed to receive message.\n",
+                    me->id);
+            perror("tag_receive");
+            exit(EXIT_FAILURE);
+        }
+        if (ret < (int)PROBE_HDR_SIZE) continue;  // Not from a probe.
+        memcpy(&hdr, msg, PROBE_HDR_SIZE);
+        account(me, &hdr, ret, mono_now, tsc_now);
+    }
+    free(msg);
+    pthread_mutex_lock(&done_lock);
+    receivers_done++;
+    pthread_mutex_unlock(&done_lock);
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Measures TSC ticks per nanosecond against CLOCK_MONOTONIC.
+ *
+ * @return Ticks per nanosecond, 0 if there's no TSC.
+ */
+double calibrate_tsc(void) {
+    uint64_t mono_start, tsc_start;
+    if (!PROBE_HAS_TSC) return 0.0;
+    mono_start = now_ns();
+    tsc_start = now_tsc();
+    usleep(100 * 1000);
+    return (double)(now_tsc() - tsc_start) / (double)(now_ns() - mono_start);
+}
+
+/**
+ * @brief Prints usage information and exits.
+ */
+void usage(void) {
+    fprintf(stderr, "Usage:\n\tprobe_listener.out -k KEY -l LEVEL "
+                    "[-t RECEIVERS] [-b BUFSIZE]\n"
+                    "\tRECEIVERS: Receiving threads (default: 1).\n"
+                    "\tBUFSIZE: Receive buffer size, at least the largest "
+                    "message (default: %d).\n", BUFSIZE_DFL);
+    exit(EXIT_FAILURE);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    int key = -1, nr_receivers = 1, opt, done, i;
+    struct timespec timeout = {0, 100 * 1000 * 1000};
+    receiver_t *receivers;
+    struct sigaction act;
+    sigset_t term_set;
+    uint64_t expected;
+    while ((opt = getopt(argc, argv, "k:l:t:b:")) != -1) {
+        switch (opt) {
+        case 'k':
+            key = atoi(optarg);
+            break;
+        case 'l':
+            lvl = atoi(optarg);
+            break;
+        case 't':
+            nr_receivers = atoi(optarg);
+            break;
+        case 'b':
+            bufsize = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind != argc) || (key < 0) || (lvl < 0) || (lvl >= TAG_LEVELS) ||
+        (nr_receivers <= 0) || (nr_receivers > MAX_RECEIVERS) ||
+        (bufsize < PROBE_HDR_SIZE))
+        usage();
+    if (key == IPC_PRIVATE)
+        fprintf(stderr, "ERROR: We're about to reopen a private instance...\n");
+    tsc_per_ns = calibrate_tsc();
+    tag = tag_get(key, TAG_OPEN, TAG_USR);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to open tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    printf("Opened instance with tag: %d.\n", tag);
+    // Only the main thread takes termination signals, while receivers get
+    // SIGUSR1 to stop waiting; no SA_RESTART, so that receives are cut short.
+    sigemptyset(&term_set);
+    sigaddset(&term_set, SIGINT);
+    sigaddset(&term_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &term_set, NULL);
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = kick_handler;
+    sigaction(SIGUSR1, &act, NULL);
+    receivers = calloc(nr_receivers, sizeof(receiver_t));
+    if (receivers == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate receivers data.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nr_receivers; i++) {
+        receivers[i].id = i;
+        if (pthread_create(&receivers[i].tid, NULL, receiver, &receivers[i])) {
+            fprintf(stderr, "ERROR: Failed to spawn receiver no. %d.\n", i);
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Wait for the receivers to finish, or for a signal.
+    do {
+        if (sigtimedwait(&term_set, NULL, &timeout) > 0) {
+            printf("\b\bGot signal, stopping receivers...\n");
+            stop = 1;
+        }
+        pthread_mutex_lock(&done_lock);
+        done = receivers_done;
+        pthread_mutex_unlock(&done_lock);
+    } while (!stop && (done < nr_receivers));
+    while (done < nr_receivers) {
+        for (i = 0; i < nr_receivers; i++)
+            pthread_kill(receivers[i].tid, SIGUSR1);
+        usleep(10 * 1000);
+        pthread_mutex_lock(&done_lock);
+        done = receivers_done;
+        pthread_mutex_unlock(&done_lock);
+    }
+    for (i = 0; i < nr_receivers; i++) pthread_join(receivers[i].tid, NULL);
+    // Report for each receiver.
+    for (i = 0; i < nr_receivers; i++) {
+        receiver_t *rcv = &receivers[i];
+        expected = rcv->next_seq - rcv->first_seq;
+        printf("Receiver %d: %lu message(s), %lu byte(s), ", i,
+               (unsigned long)rcv->received, (unsigned long)rcv->bytes);
+        if (!rcv->started) {
+            printf("no probe messages.\n");
+            continue;
+        }
+        printf("joined at seq %lu, missed %lu (%.3f%%), out of order %lu%s.\n",
+               (unsigned long)rcv->first_seq, (unsigned long)rcv->missed,
+               expected ? 100.0 * (double)rcv->missed / (double)expected : 0.0,
+               (unsigned long)rcv->reordered,
+               rcv->ended ? "" : ", no end message");
+        dist_print("Monotonic", &rcv->mono);
+        if (tsc_per_ns > 0.0) dist_print("TSC", &rcv->tsc);
+    }
+    free(receivers);
+    printf("Probe listener done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,225 @@
+/**
+ * @brief Latency probe talker: sends sequenced, timestamped messages at a
+ *        given rate, with sizes drawn from a given distribution.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../aos-tag.h"
+#include "probe.h"
+
+#define MAX_SIZES 16
+#define MAX_SIZE 65536
+
+/* Size distribution: sizes with their weights. */
+int sizes[MAX_SIZES], weights[MAX_SIZES], nr_sizes, total_weight;
+
+volatile sig_atomic_t stop;
+
+/* Signal handler: allows to gracefully terminate the process. */
+void term_handler(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * @brief Parses a size distribution, e.g. "64x9,1024x1" sends 64 bytes nine
+ * times out of ten. Sizes below the header size are raised to it.
+ *
+ * @param str String to parse.
+ * @return 0 if the distribution is valid, -1 otherwise.
+ */
+int parse_sizes(char *str) {
+    char *tok, *end;
+    long size, weight;
+    nr_sizes = 0;
+    total_weight = 0;
+    for (tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        size = strtol(tok, &end, 10);
+        weight = 1;
+        if (*end == 'x') weight = strtol(end + 1, &end, 10);
+        if ((*end != '\0') || (size < 0) || (size > MAX_SIZE) ||
+            (weight <= 0) || (weight > 1000) || (nr_sizes == MAX_SIZES))
+            return -1;
+        if (size < (long)PROBE_HDR_SIZE) size = PROBE_HDR_SIZE;
+        sizes[nr_sizes] = (int)size;
+        weights[nr_sizes++] = (int)weight;
+        total_weight += (int)weight;
+    }
+    return nr_sizes ? 0 : -1;
+}
+
+/**
+ * @brief Draws a message size from the distribution.
+ *
+ * @param seed Random generator state.
+ * @return Message size.
+ */
+int draw_size(unsigned int *seed) {
+    int pick = rand_r(seed) % total_weight, i;
+    for (i = 0; pick >= weights[i]; i++) pick -= weights[i];
+    return sizes[i];
+}
+
+/**
+ * @brief Adds nanoseconds to a timespec.
+ *
+ * @param ts Timespec to update.
+ * @param ns Nanoseconds to add.
+ */
+void ts_add(struct timespec *ts, uint64_t ns) {
+    ns += ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+/**
+ * @brief Prints usage information and exits.
+ */
+void usage(void) {
+    fprintf(stderr, "Usage:\n\tprobe_talker.out -k KEY -l LEVEL [-r RATE] "
+                    "[-s SIZES] [-n COUNT] [-w DELAY]\n"
+                    "\tRATE: Messages per second, 0 means as fast as possible"
+                    " (default: 1000).\n"
+                    "\tSIZES: Comma-separated SIZE[xWEIGHT] list "
+                    "(default: 64).\n"
+                    "\tCOUNT: Messages to send, 0 means until interrupted "
+                    "(default: 0).\n"
+                    "\tDELAY: Seconds to wait for listeners (default: 1).\n");
+    exit(EXIT_FAILURE);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    unsigned long delivered = 0, discarded = 0, late = 0;
+    uint64_t seq = 0, count = 0, period = 0, start, now;
+    int key = -1, lvl = -1, rate = 1000, delay = 1, tag, opt, ret;
+    unsigned int seed = 42;
+    char sizes_dfl[] = "64";
+    struct probe_hdr hdr;
+    struct sigaction act;
+    struct timespec next;
+    char *msg;
+    parse_sizes(sizes_dfl);
+    while ((opt = getopt(argc, argv, "k:l:r:s:n:w:")) != -1) {
+        switch (opt) {
+        case 'k':
+            key = atoi(optarg);
+            break;
+        case 'l':
+            lvl = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 's':
+            if (parse_sizes(optarg)) usage();
+            break;
+        case 'n':
+            count = strtoull(optarg, NULL, 10);
+            break;
+        case 'w':
+            delay = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind != argc) || (key < 0) || (lvl < 0) || (lvl >= TAG_LEVELS) ||
+        (rate < 0) || (delay < 0))
+        usage();
+    if (rate) period = 1000000000ULL / rate;
+    msg = calloc(MAX_SIZE, 1);
+    if (msg == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate message buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    // No SA_RESTART, so that sleeps are cut short.
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = term_handler;
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    // Open a new instance of the service.
+    tag = tag_get(key, TAG_CREATE, TAG_USR);
+    if (tag == -1) {
+        tag = tag_get(key, TAG_OPEN, TAG_USR);
+        if (tag == -1) {
+            fprintf(stderr, "ERROR: Failed to open tag service instance.\n");
+            perror("tag_get");
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Opened instance with tag: %d.\n", tag);
+    sleep(delay);  // Give listeners some time to start waiting...
+    // Send on an absolute schedule, so that delays don't add up.
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    start = now_ns();
+    while (!stop && ((count == 0) || (seq < count))) {
+        hdr.size = draw_size(&seed);
+        hdr.seq = seq;
+        hdr.flags = 0;
+        hdr.tsc = now_tsc();
+        hdr.mono_ns = now_ns();
+        memcpy(msg, &hdr, PROBE_HDR_SIZE);
+        ret = tag_send(tag, lvl, msg, hdr.size);
+        if (ret == -1) {
+            if (errno == EINTR) break;
+            fprintf(stderr, "ERROR: Failed to send message no. %lu.\n",
+                    (unsigned long)seq);
+            perror("tag_send");
+            exit(EXIT_FAILURE);
+        }
+        if (ret == 1) discarded++;
+        else delivered++;
+        seq++;
+        if (period == 0) continue;
+        ts_add(&next, period);
+        now = now_ns();
+        if (now > (uint64_t)next.tv_sec * 1000000000ULL + next.tv_nsec +
+                  period)
+            late++;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    now = now_ns();
+    // Tell listeners how many messages there were, then let them go.
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.seq = seq;
+    hdr.flags = PROBE_END;
+    hdr.size = PROBE_HDR_SIZE;
+    hdr.mono_ns = now_ns();
+    memcpy(msg, &hdr, PROBE_HDR_SIZE);
+    if (tag_send(tag, lvl, msg, PROBE_HDR_SIZE) == -1) {
+        fprintf(stderr, "ERROR: Failed to send end message.\n");
+        perror("tag_send");
+    }
+    usleep(100 * 1000);
+    if (tag_ctl(tag, AWAKE_ALL)) {
+        fprintf(stderr, "ERROR: AWAKE_ALL failed.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+    }
+    printf("Sent %lu message(s) in %.3f second(s) (%.1f msg/s): "
+           "%lu delivered, %lu discarded, %lu late.\n", (unsigned long)seq,
+           (double)(now - start) / 1e9,
+           (double)seq * 1e9 / (double)(now - start + 1), delivered,
+           discarded, late);
+    free(msg);
+    printf("Probe talker done!\n");
+    exit(EXIT_SUCCESS);
+}
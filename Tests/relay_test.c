@@ -0,0 +1,117 @@
+/**
+ * @brief Tester for in-kernel relays between levels of different instances.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define SRC_LEVEL 0
+#define DST_LEVEL 1
+#define BUFSIZE 64
+
+int src_tag, dst_tag;
+
+/**
+ * @brief Reader routine: waits for a message on the destination level.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    UNUSED(arg);
+    char buf[BUFSIZE];
+    memset(buf, 0, BUFSIZE);
+    if (tag_receive(dst_tag, DST_LEVEL, buf, BUFSIZE) == -1) {
+        fprintf(stderr, "ERROR: Failed to receive message.\n");
+        perror("tag_receive");
+        exit(EXIT_FAILURE);
+    }
+    printf("Reader got: %s\n", buf);
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    pthread_t reader_tid;
+    char msg[BUFSIZE];
+    src_tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    dst_tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if ((src_tag == -1) || (dst_tag == -1)) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instances.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_level_ctl(src_tag, TAG_LVL_RELAY, SRC_LEVEL,
+                      TAG_RELAY_TO(dst_tag, DST_LEVEL))) {
+        fprintf(stderr, "ERROR: Failed to set relay rule.\n");
+        perror("tag_level_ctl");
+        exit(EXIT_FAILURE);
+    }
+    // The way back would close a loop.
+    if ((tag_level_ctl(dst_tag, TAG_LVL_RELAY, DST_LEVEL,
+                       TAG_RELAY_TO(src_tag, SRC_LEVEL)) != -1) ||
+        (errno != ELOOP)) {
+        fprintf(stderr, "ERROR: Relay loop was not refused.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Sparse levels can't be relayed to.
+    if ((tag_level_ctl(dst_tag, TAG_LVL_RELAY, DST_LEVEL,
+                       TAG_RELAY_TO(src_tag, 0x5EED)) != -1) ||
+        (errno != EINVAL)) {
+        fprintf(stderr, "ERROR: Sparse relay destination was not refused.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&reader_tid, NULL, reader, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn reader.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    sleep(1);
+    // No one waits on the source level, but the message must get through.
+    strcpy(msg, "Relayed message");
+    if (tag_send(src_tag, SRC_LEVEL, msg, strlen(msg) + 1) != 0) {
+        fprintf(stderr, "ERROR: Message was not relayed.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(reader_tid, NULL);
+    // Removing the destination must drop the rule.
+    if (tag_ctl(dst_tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    dst_tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (dst_tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_send(src_tag, SRC_LEVEL, msg, strlen(msg) + 1) != 1) {
+        fprintf(stderr, "ERROR: Relay rule outlived its destination.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(src_tag, REMOVE) || tag_ctl(dst_tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instances.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("Relay tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,134 @@
+/**
+ * @brief Tester for submission/completion rings.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_LEVEL 3
+#define NR_RCVS 4
+#define ENTRIES 8
+#define BUFSIZE 64
+#define MSG "Hello, rings!"
+
+/* Marks the send in the completion queue. */
+#define SEND_DATA 0xFFUL
+
+struct tag_ring ring;
+int tag;
+
+/**
+ * @brief Queues a new entry, exiting on failure.
+ *
+ * @param op Operation to queue.
+ * @param flags Flags or command for the operation.
+ * @param addr Buffer or argument for the operation.
+ * @param size Size of the aforementioned buffer.
+ * @param user_data Marker for the completion.
+ */
+void queue(int op, int flags, unsigned long addr, unsigned long size,
+           unsigned long user_data) {
+    struct tag_sqe *sqe = tag_ring_get_sqe(&ring);
+    if (sqe == NULL) {
+        fprintf(stderr, "ERROR: Submission queue is full.\n");
+        exit(EXIT_FAILURE);
+    }
+    sqe->user_data = user_data;
+    sqe->op = op;
+    sqe->tag = tag;
+    sqe->level = TEST_LEVEL;
+    sqe->flags = flags;
+    sqe->addr = addr;
+    sqe->size = size;
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    struct tag_cqe *cqe;
+    int i, reaped = 0;
+    if (tag_ring_setup(&ring, ENTRIES, NR_RCVS * BUFSIZE)) {
+        fprintf(stderr, "ERROR: Failed to set up rings.\n");
+        perror("tag_ring_setup");
+        exit(EXIT_FAILURE);
+    }
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    // Some receives stay pending, then a send completes all of them.
+    for (i = 0; i < NR_RCVS; i++)
+        queue(TAG_OP_RECEIVE, 0, (unsigned long)(ring.bufs + (i * BUFSIZE)),
+              BUFSIZE, (unsigned long)i);
+    queue(TAG_OP_SEND, 0, (unsigned long)MSG, strlen(MSG) + 1, SEND_DATA);
+    if (tag_ring_submit(&ring, NR_RCVS + 1) != (NR_RCVS + 1)) {
+        fprintf(stderr, "ERROR: Failed to submit entries.\n");
+        perror("tag_ring_submit");
+        exit(EXIT_FAILURE);
+    }
+    while ((cqe = tag_ring_peek_cqe(&ring)) != NULL) {
+        if (cqe->user_data == SEND_DATA) {
+            if (cqe->result != 0) {
+                fprintf(stderr, "ERROR: Send result: %ld.\n", cqe->result);
+                exit(EXIT_FAILURE);
+            }
+        } else if ((cqe->result != (long)(strlen(MSG) + 1)) ||
+                   strcmp(ring.bufs + (cqe->user_data * BUFSIZE), MSG)) {
+            fprintf(stderr, "ERROR: Receive %lu result: %ld.\n",
+                    cqe->user_data, cqe->result);
+            exit(EXIT_FAILURE);
+        } else printf("Receive %lu got: %s\n", cqe->user_data,
+                      ring.bufs + (cqe->user_data * BUFSIZE));
+        tag_ring_cqe_seen(&ring);
+        reaped++;
+    }
+    if (reaped != (NR_RCVS + 1)) {
+        fprintf(stderr, "ERROR: Got %d completions.\n", reaped);
+        exit(EXIT_FAILURE);
+    }
+    // A pending receive must be canceled by an AWAKE_ALL, and must keep the
+    // instance from being removed until then.
+    queue(TAG_OP_RECEIVE, 0, (unsigned long)ring.bufs, BUFSIZE, 0);
+    queue(TAG_OP_CTL, REMOVE, 0, 0, 1);
+    queue(TAG_OP_CTL, AWAKE_ALL, 0, 0, 2);
+    if (tag_ring_submit(&ring, 3) != 3) {
+        fprintf(stderr, "ERROR: Failed to submit entries.\n");
+        perror("tag_ring_submit");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < 3; i++) {
+        long expected[3] = {-ECANCELED, -EBUSY, 0};
+        cqe = tag_ring_peek_cqe(&ring);
+        if ((cqe == NULL) || (cqe->user_data > 2) ||
+            (cqe->result != expected[cqe->user_data])) {
+            fprintf(stderr, "ERROR: Unexpected completion no. %d.\n", i);
+            exit(EXIT_FAILURE);
+        }
+        tag_ring_cqe_seen(&ring);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    tag_ring_exit(&ring);
+    printf("Rings tester done!\n");
+    exit(EXIT_SUCCESS);
+}
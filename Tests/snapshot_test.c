@@ -0,0 +1,101 @@
+/**
+ * @brief Tester for binary snapshots of the status device.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ipc.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_LEVEL 3
+#define NR_RECS 10
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    struct tag_snap_rec recs[NR_RECS];
+    unsigned long cursor = 0;
+    int tag, fd, ret, found = 0, seen = 0;
+    char msg[] = "Cached message";
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_level_ctl(tag, TAG_LVL_SET, TEST_LEVEL, TAG_LVL_STICKY)) {
+        fprintf(stderr, "ERROR: Failed to set level mode.\n");
+        perror("tag_level_ctl");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_send(tag, TEST_LEVEL, msg, sizeof(msg)) == -1) {
+        fprintf(stderr, "ERROR: Failed to send message.\n");
+        perror("tag_send");
+        exit(EXIT_FAILURE);
+    }
+    fd = open(TAG_STATUS_DEVFILE, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "ERROR: Failed to open status device file.\n");
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    // The buffer is smaller than an instance, so records come in pages.
+    while ((ret = tag_snapshot(fd, recs, NR_RECS, &cursor)) > 0) {
+        int i;
+        for (i = 0; i < ret; i++) {
+            if (recs[i].tag != tag) continue;
+            seen++;
+            if (recs[i].level != TEST_LEVEL) continue;
+            if (!(recs[i].flags & TAG_LVL_STICKY) ||
+                (recs[i].last_size != sizeof(msg)) ||
+                (recs[i].relay != TAG_RELAY_NONE)) {
+                fprintf(stderr, "ERROR: Bad record for test level.\n");
+                exit(EXIT_FAILURE);
+            }
+            found = 1;
+        }
+    }
+    if (ret == -1) {
+        fprintf(stderr, "ERROR: Failed to take snapshot.\n");
+        perror("tag_snapshot");
+        exit(EXIT_FAILURE);
+    }
+    if (!found || (seen != TAG_LEVELS)) {
+        fprintf(stderr, "ERROR: Instance missing from snapshot.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Unknown layouts must be refused.
+    {
+        struct tag_ioctl_args args = {{(unsigned long)(TAG_SNAP_VERSION + 1),
+                                       (unsigned long)recs, NR_RECS,
+                                       (unsigned long)&cursor}};
+        cursor = 0;
+        if ((ioctl(fd, TAG_IOC_SNAPSHOT, &args) != -1) ||
+            (errno != EPROTONOSUPPORT)) {
+            fprintf(stderr, "ERROR: Unknown layout version was accepted.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(fd);
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("Snapshot tester done!\n");
+    exit(EXIT_SUCCESS);
+}
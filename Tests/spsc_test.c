@@ -0,0 +1,96 @@
+/**
+ * @brief Tester for single-producer, single-consumer instances.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_LEVEL 5
+#define NR_MSGS 10
+#define BUFSIZE 64
+
+int tag;
+
+/**
+ * @brief Consumer routine: gets all messages on the test level.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *consumer(void *arg) {
+    UNUSED(arg);
+    char buf[BUFSIZE];
+    for (int i = 0; i < NR_MSGS; i++) {
+        memset(buf, 0, BUFSIZE);
+        if (tag_receive(tag, TEST_LEVEL, buf, BUFSIZE) == -1) {
+            fprintf(stderr, "ERROR: Failed to receive message no. %d.\n", i);
+            perror("tag_receive");
+            exit(EXIT_FAILURE);
+        }
+        printf("Consumer got: %s\n", buf);
+    }
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    pthread_t consumer_tid;
+    char buf[BUFSIZE];
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_USR | TAG_SP | TAG_SC);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&consumer_tid, NULL, consumer, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn consumer.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < NR_MSGS; i++) {
+        int ret;
+        memset(buf, 0, BUFSIZE);
+        snprintf(buf, BUFSIZE, "Message no. %d", i);
+        // The consumer might not be waiting yet: retry until it gets it.
+        while ((ret = tag_send(tag, TEST_LEVEL, buf, strlen(buf) + 1)) == 1)
+            usleep(1000);
+        if (ret == -1) {
+            fprintf(stderr, "ERROR: Failed to send message no. %d.\n", i);
+            perror("tag_send");
+            exit(EXIT_FAILURE);
+        }
+        if (i == (NR_MSGS - 1)) break;
+        // Wait for the consumer to come back, then try to be a second one.
+        usleep(10000);
+        if ((tag_receive(tag, TEST_LEVEL, buf, BUFSIZE) != -1) ||
+            (errno != EBUSY)) {
+            fprintf(stderr, "ERROR: Second consumer not detected.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_join(consumer_tid, NULL);
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("SPSC tester done!\n");
+    exit(EXIT_SUCCESS);
+}
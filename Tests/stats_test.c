@@ -0,0 +1,103 @@
+/**
+ * @brief Tester for traffic counters mapped from the status device.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ipc.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define MAX_TAGS_PARAM "/sys/module/aos_tag/parameters/max_tags"
+#define TEST_LEVEL 5
+#define NR_SENDS 10
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    const struct tag_stats *stats;
+    const struct tag_lvl_stats *lvl_stats;
+    unsigned int max_tags;
+    int tag, fd, i;
+    char msg[] = "Counted message";
+    FILE *param;
+    // Get the size of the counters area.
+    param = fopen(MAX_TAGS_PARAM, "r");
+    if ((param == NULL) || (fscanf(param, "%u", &max_tags) != 1)) {
+        fprintf(stderr, "ERROR: Failed to read max_tags.\n");
+        exit(EXIT_FAILURE);
+    }
+    fclose(param);
+    fd = open(TAG_STATUS_DEVFILE, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "ERROR: Failed to open status device file.\n");
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    stats = tag_stats_map(fd, max_tags);
+    if (stats == NULL) {
+        fprintf(stderr, "ERROR: Failed to map traffic counters.\n");
+        perror("tag_stats_map");
+        exit(EXIT_FAILURE);
+    }
+    // Counters must not be writable.
+    if ((mmap(NULL, TAG_STATS_SIZE(max_tags), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0) != MAP_FAILED) || (errno != EPERM)) {
+        fprintf(stderr, "ERROR: Writable mapping was allowed.\n");
+        exit(EXIT_FAILURE);
+    }
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    // No one is waiting, so all of these must be discarded.
+    for (i = 0; i < NR_SENDS; i++) {
+        if (tag_send(tag, TEST_LEVEL, msg, sizeof(msg)) != 1) {
+            fprintf(stderr, "ERROR: Message was not discarded.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // There is no cached message, so this must fail.
+    if (tag_receive_flags(tag, TEST_LEVEL, msg, 1, TAG_RCV_LAST) != -1) {
+        fprintf(stderr, "ERROR: Receive did not fail.\n");
+        exit(EXIT_FAILURE);
+    }
+    lvl_stats = &(stats[tag].levels[TEST_LEVEL]);
+    printf("Counters of tag %d, level %d (generation %lu):\n",
+           tag, TEST_LEVEL, stats[tag].gen);
+    printf("  sends: %lu, deliveries: %lu, discards: %lu\n",
+           lvl_stats->sends, lvl_stats->deliveries, lvl_stats->discards);
+    printf("  bytes: %lu, wakeups: %lu, errors: %lu\n",
+           lvl_stats->bytes, lvl_stats->wakeups, lvl_stats->errors);
+    if ((stats[tag].gen == 0) || (lvl_stats->sends != NR_SENDS) ||
+        (lvl_stats->discards != NR_SENDS) || (lvl_stats->deliveries != 0) ||
+        (lvl_stats->bytes != NR_SENDS * sizeof(msg)) ||
+        (lvl_stats->wakeups != 0) || (lvl_stats->errors != 1)) {
+        fprintf(stderr, "ERROR: Bad traffic counters.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    tag_stats_unmap(stats, max_tags);
+    close(fd);
+    printf("Stats tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -20,6 +20,7 @@ void sighandler(int sig) {
 
 int main(void) {
     int ret, tag;
+    char buf[16];
     signal(SIGINT, sighandler);
     ret = tag_get(TEST_KEY, TAG_CREATE, TAG_USR);
     printf("tag_get: %d.\n", ret);
@@ -35,6 +36,21 @@ int main(void) {
     ret = tag_send(tag, 0, NULL, 0);
     printf("tag_send: %d.\n", ret);
     perror("tag_send");
+    ret = tag_level_ctl(tag, TAG_LVL_SET, 1, TAG_LVL_STICKY);
+    printf("tag_level_ctl: %d.\n", ret);
+    perror("tag_level_ctl");
+    ret = tag_send(tag, 1, "sticky", 7);
+    printf("tag_send: %d.\n", ret);
+    perror("tag_send");
+    ret = tag_receive_flags(tag, 1, buf, sizeof(buf), TAG_RCV_LAST);
+    printf("tag_receive_flags: %d (%s).\n", ret, ret > 0 ? buf : "");
+    perror("tag_receive_flags");
+    ret = tag_level_ctl(tag, TAG_LVL_SET, 2, TAG_LVL_CONFLATE);
+    printf("tag_level_ctl: %d.\n", ret);
+    perror("tag_level_ctl");
+    ret = tag_send(tag, 2, "conflated", 10);
+    printf("tag_send: %d.\n", ret);
+    perror("tag_send");
     ret = tag_ctl(tag, REMOVE);
     printf("tag_ctl: %d.\n", ret);
     perror("tag_ctl");
@@ -0,0 +1,123 @@
+/**
+ * @brief Tester for sparse level identifiers.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ipc.h>
+#include <pthread.h>
+
+#include "../aos-tag.h"
+
+#define UNUSED(arg) (void)(arg)
+
+#define TEST_TOPIC TAG_SPARSE(1000003UL)
+#define OTHER_TOPIC TAG_SPARSE(2000003UL)
+#define BUFSIZE 64
+
+int tag;
+
+/**
+ * @brief Reader routine: waits for a message on a sparse level.
+ *
+ * @param arg Thread argument (unused).
+ * @return Thread exit status.
+ */
+void *reader(void *arg) {
+    UNUSED(arg);
+    char buf[BUFSIZE];
+    memset(buf, 0, BUFSIZE);
+    if (tag_receive(tag, TEST_TOPIC, buf, BUFSIZE) == -1) {
+        fprintf(stderr, "ERROR: Failed to receive message.\n");
+        perror("tag_receive");
+        exit(EXIT_FAILURE);
+    }
+    printf("Reader got: %s\n", buf);
+    pthread_exit(NULL);
+}
+
+/* The works. */
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    pthread_t reader_tid;
+    char msg[BUFSIZE];
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    // Sparse levels don't have cached messages.
+    if ((tag_receive_flags(tag, TEST_TOPIC, msg, BUFSIZE, TAG_RCV_LAST) != -1)
+        || (errno != EINVAL)) {
+        fprintf(stderr, "ERROR: TAG_RCV_LAST accepted on a sparse level.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&reader_tid, NULL, reader, NULL)) {
+        fprintf(stderr, "ERROR: Failed to spawn reader.\n");
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    sleep(1);
+    // No one is waiting on this one.
+    strcpy(msg, "Unseen message");
+    if (tag_send(tag, OTHER_TOPIC, msg, strlen(msg) + 1) != 1) {
+        fprintf(stderr, "ERROR: Message on idle level was not discarded.\n");
+        exit(EXIT_FAILURE);
+    }
+    // This one instead must be delivered.
+    strcpy(msg, "Sparse message");
+    if (tag_send(tag, TEST_TOPIC, msg, strlen(msg) + 1) != 0) {
+        fprintf(stderr, "ERROR: Message on sparse level was not delivered.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(reader_tid, NULL);
+    // The level must be gone together with its last receiver.
+    if (tag_send(tag, TEST_TOPIC, msg, strlen(msg) + 1) != 1) {
+        fprintf(stderr, "ERROR: Sparse level outlived its receivers.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Stray levels must not be taken for sparse ones.
+    if ((tag_send(tag, TAG_LEVELS, msg, strlen(msg) + 1) != -1) ||
+        (errno != EINVAL) || (tag_send(tag, -1, msg, strlen(msg) + 1) != -1) ||
+        (errno != EINVAL) ||
+        (tag_receive(tag, 1000003UL, msg, BUFSIZE) != -1) ||
+        (errno != EINVAL)) {
+        fprintf(stderr, "ERROR: Untagged level accepted as a sparse one.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    // Sparse levels can't enforce topologies.
+    tag = tag_get(IPC_PRIVATE, TAG_CREATE, TAG_ALL | TAG_SP);
+    if (tag == -1) {
+        fprintf(stderr, "ERROR: Failed to create new tag service instance.\n");
+        perror("tag_get");
+        exit(EXIT_FAILURE);
+    }
+    if ((tag_send(tag, TEST_TOPIC, msg, strlen(msg) + 1) != -1) ||
+        (errno != EOPNOTSUPP)) {
+        fprintf(stderr, "ERROR: Sparse level accepted on an SP instance.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (tag_ctl(tag, REMOVE)) {
+        fprintf(stderr, "ERROR: Failed to remove tag service instance.\n");
+        perror("tag_ctl");
+        exit(EXIT_FAILURE);
+    }
+    printf("Topic tester done!\n");
+    exit(EXIT_SUCCESS);
+}
@@ -26,41 +26,31 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/slab.h>
-#include <linux/vmalloc.h>
 #include <linux/uaccess.h>
 #include <linux/cred.h>
 #include <linux/rwsem.h>
 #include <linux/string.h>
 #include <linux/types.h>
 #include <linux/compiler.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
 
 #include "include/aos-tag.h"
 #include "include/aos-tag_dev-driver.h"
 #include "include/aos-tag_types.h"
-
-/* Magic number: expected maximum status file line length, given its content. */
-#define __STAT_LINE_LEN 64
-
-/* As LEN, but considering the null terminator. */
-#define __STAT_LINE_SZ (__STAT_LINE_LEN + 1)
+#include "include/aos-tag_syscalls.h"
+#include "include/aos-tag_rings.h"
+#include "include/aos-tag_locks.h"
+#include "utils/aos-tag_messages.h"
+#include "utils/aos-tag_bitmask.h"
 
 extern int tag_drv_major;
 extern unsigned int max_tags;
 extern tag_ptr_t *tags_list;
-
-/* Status device file size and data. */
-typedef struct _tag_stat_t {
-    size_t stat_len;
-    char *stat_data;
-} tag_stat_t;
-
-/* Instance status snapshot raw data buffer. */
-typedef struct _tag_snap_t {
-    unsigned char valid : 1;
-    int key;
-    kuid_t c_euid;
-    unsigned long readers_cnts[__NR_LEVELS];
-} tag_snap_t;
+extern tag_bitmask *tags_mask;
+extern tag_stats_t *tags_stats;
 
 /* AOS-TAG service character device driver. */
 struct file_operations tag_fops = {
@@ -69,133 +59,201 @@ struct file_operations tag_fops = {
     .read = aos_tag_read,
     .write = aos_tag_write,
     .unlocked_ioctl = aos_tag_ioctl,
+    .mmap = aos_tag_mmap,
     .release = aos_tag_release
 };
 
 /* Character device structure. */
 struct cdev tag_cdev;
 
-/* Device structure and number. */
+/* Device structures and numbers. */
 struct device *tag_dev;
 dev_t tag_status_dvn;
+struct device *tag_io_dev;
+dev_t tag_io_dvn;
 
 /* Device class in sysfs. */
 struct class *tag_status_cls;
 
+/**
+ * @brief Takes a snapshot of the status of all levels of an instance. 
+ * Being this a snapshot, we don't grab any lock other than the senders one, 
+ * just to keep removers away, and the level spinlocks, and don't care about 
+ * race conditions at all. 
+ * Instances that are being created or removed, AKA busy, are skipped.
+ *
+ * @param tag Tag descriptor of the instance.
+ * @param recs Records to fill, one for each level.
+ * @return 0, or -1 if the instance was skipped.
+ */
+static int aos_tag_snap_take(unsigned int tag, tag_snap_rec_t *recs) {
+    unsigned int lvl;
+    tag_t *curr_tag;
+    // The senders rw_semaphore is only trylocked: locking the receivers one
+    // would look like a receiver for removers.
+    if (down_read_trylock(&(tags_list[tag].snd_rwsem)) == 0) {
+        // Instance is being created or removed: we are too late.
+        return -1;
+    }
+    curr_tag = tags_list[tag].ptr;
+    if (curr_tag == NULL) {
+        // Instance not present.
+        up_read(&(tags_list[tag].snd_rwsem));
+        return -1;
+    }
+    // Get instance and levels status.
+    for (lvl = 0; lvl < __NR_LEVELS; lvl++) {
+        tag_snap_rec_t *rec = &(recs[lvl]);
+        struct list_head *node;
+        rec->tag = (int)tag;
+        rec->key = curr_tag->key;
+        rec->euid = curr_tag->creator_euid.val;
+        rec->lvl = lvl;
+        // By adding the two presence counters we get the total number
+        // of waiting threads: those that are still copying a message
+        // and those that were too late for the last one, which are all
+        // threads currently waiting for a message on this level.
+        rec->waiting = (curr_tag->lvl_conds)[lvl]._pres_count[0] +
+                       (curr_tag->lvl_conds)[lvl]._pres_count[1];
+        rec->filtered = 0;
+        rec->pending = 0;
+        rec->relay = READ_ONCE((curr_tag->relays)[lvl]);
+        rec->flags = (unsigned int)((curr_tag->lvl_flags)[lvl]);
+        // Filtered receivers and pending receives are waiting too, but in
+        // lists.
+        spin_lock(&((curr_tag->msg_locks)[lvl]));
+        list_for_each(node, &((curr_tag->flt_rcvs)[lvl]))
+            rec->filtered++;
+        list_for_each(node, &((curr_tag->ring_rcvs)[lvl]))
+            rec->pending++;
+        rec->last_size = (curr_tag->last_msgs)[lvl] == NULL ? 0 :
+            (unsigned int)TAG_MSG_SIZE((curr_tag->last_msgs)[lvl]);
+        spin_unlock(&((curr_tag->msg_locks)[lvl]));
+    }
+    up_read(&(tags_list[tag].snd_rwsem));
+    return 0;
+}
+
+/**
+ * @brief Status file iterator: looks for the next descriptor in use, starting 
+ * from the given one. 
+ * Follows the descriptors bitmask, so free entries of the instances array are 
+ * never touched. Being this a snapshot, the mask is read without its lock.
+ *
+ * @param pos Descriptor to start from, updated with the one found.
+ * @return Instances array entry, or NULL if there are no more.
+ */
+static void *aos_tag_stat_find(loff_t *pos) {
+    unsigned long tag;
+    if ((*pos < 0) || (*pos >= max_tags)) return NULL;
+    tag = find_next_bit(tags_mask->_mask, max_tags, (unsigned long)*pos);
+    if (tag >= max_tags) return NULL;
+    *pos = (loff_t)tag;
+    return (void *)&(tags_list[tag]);
+}
+
+/**
+ * @brief Status file iterator: starts, or resumes, a pass over the instances.
+ *
+ * @param m Status file.
+ * @param pos Descriptor to start from.
+ * @return Instances array entry, or NULL if there are no more.
+ */
+static void *aos_tag_stat_start(struct seq_file *m, loff_t *pos) {
+    return aos_tag_stat_find(pos);
+}
+
+/**
+ * @brief Status file iterator: moves past the current instance.
+ *
+ * @param m Status file.
+ * @param v Current instances array entry.
+ * @param pos Current descriptor, updated with the next one.
+ * @return Instances array entry, or NULL if there are no more.
+ */
+static void *aos_tag_stat_next(struct seq_file *m, void *v, loff_t *pos) {
+    (*pos)++;
+    return aos_tag_stat_find(pos);
+}
+
+/**
+ * @brief Status file iterator: ends a pass over the instances (a nop).
+ *
+ * @param m Status file.
+ * @param v Current instances array entry.
+ */
+static void aos_tag_stat_stop(struct seq_file *m, void *v) {
+    return;
+}
+
+/**
+ * @brief Status file iterator: takes a snapshot of an instance, then prints a 
+ * line for each of its levels. 
+ * Records live in a buffer allocated at open time, in the file's private data.
+ *
+ * @param m Status file.
+ * @param v Instances array entry.
+ * @return 0, or SEQ_SKIP if the instance was skipped.
+ */
+static int aos_tag_stat_show(struct seq_file *m, void *v) {
+    tag_snap_rec_t *recs = (tag_snap_rec_t *)(m->private);
+    unsigned int lvl;
+    if (aos_tag_snap_take((unsigned int)((tag_ptr_t *)v - tags_list), recs))
+        return SEQ_SKIP;
+    // Print lines outside of the lock: they might have to wait for a page.
+    // Filtered receivers and pending receives count as waiting threads.
+    for (lvl = 0; lvl < __NR_LEVELS; lvl++)
+        seq_printf(m, "%d\t%d\t%u\t%u\t%lu\n",
+                   recs[lvl].tag, recs[lvl].key, recs[lvl].euid, lvl,
+                   recs[lvl].waiting + recs[lvl].filtered +
+                   recs[lvl].pending);
+    return 0;
+}
+
+/* Status file iterator. */
+static const struct seq_operations tag_stat_sops = {
+    .start = aos_tag_stat_start,
+    .next = aos_tag_stat_next,
+    .stop = aos_tag_stat_stop,
+    .show = aos_tag_stat_show
+};
+
 /**
  * @brief Opens a new session for the device file. 
- * Takes a snapshot of the status of the system by scanning the instances array. 
- * Then, creates a fake text file in kernel memory: the data for the current 
- * session.
+ * On the status device, sets up an iterator over active instances: the text 
+ * is generated while it's read, a page at a time, so memory usage doesn't 
+ * depend on how many instances there are. A buffer for the records of a 
+ * single instance is also allocated. 
+ * Sessions on the data plane device need none of this: they might get a ring 
+ * set later.
  *
  * @param inode Device file inode.
  * @param file Device file struct.
  * @return 0, or error code for errno.
  */
 int aos_tag_open(struct inode *inode, struct file *filp) {
-    char *write_ptr;
-    tag_stat_t *new_stat;
-    tag_snap_t *snaps;
-    unsigned int tag, valid_cnt = 0;
-    size_t new_stat_sz;
+    tag_snap_rec_t *recs;
+    int ret;
     // Consistency checks.
     if ((inode == NULL) || (filp == NULL)) return -EINVAL;
-    // Allocate memory for the new objects.
-    new_stat = (tag_stat_t *)kzalloc(sizeof(tag_stat_t), GFP_KERNEL);
-    if (new_stat == NULL) return -ENOMEM;
-    snaps = (tag_snap_t *)kzalloc(max_tags * sizeof(tag_snap_t), GFP_KERNEL);
-    if (snaps == NULL) {
-        kfree(new_stat);
-        return -ENOMEM;
-    }
-    // First pass: linear scan of the instance array to get a snapshot of the
-    // current status of the service.
-    // Note that, being this a snapshot, we don't grab any lock, and don't care
-    // about race conditions at all.
-    for (tag = 0; tag < max_tags; tag++) {
-        tag_t *curr_tag;
-        unsigned int lvl;
-        if (down_read_trylock(&(tags_list[tag].snd_rwsem)) == 0) {
-            // Instance is being created or removed AKA busy: we are too late.
-            snaps[tag].valid = 0x0;
-            continue;
-        }
-        curr_tag = tags_list[tag].ptr;
-        if (curr_tag == NULL) {
-            // Instance not present.
-            up_read(&(tags_list[tag].snd_rwsem));
-            snaps[tag].valid = 0x0;
-            continue;
-        }
-        // Get instance and levels status.
-        snaps[tag].valid = 0x1;
-        valid_cnt++;
-        snaps[tag].key = curr_tag->key;
-        snaps[tag].c_euid.val = curr_tag->creator_euid.val;
-        for (lvl = 0; lvl < __NR_LEVELS; lvl++)
-            // By adding the two presence counters we get the total number
-            // of waiting threads: those that are still copying a message
-            // and those that were too late for the last one, which are all
-            // threads currently waiting for a message on this level.
-            snaps[tag].readers_cnts[lvl] =
-                (curr_tag->lvl_conds)[lvl]._pres_count[0] +
-                (curr_tag->lvl_conds)[lvl]._pres_count[1];
-        asm volatile ("sfence" ::: "memory");
-        up_read(&(tags_list[tag].snd_rwsem));
+    if (iminor(inode) == __IO_MINOR) {
+        filp->private_data = NULL;
+        return 0;
     }
-    // Second pass: build the fake text file contents.
-    // Compute text length.
-    new_stat_sz = valid_cnt * __NR_LEVELS * __STAT_LINE_LEN;
-    if (new_stat_sz == 0) {
-        // This will result in an immediate EOF.
-        new_stat->stat_data = NULL;
-        new_stat->stat_len = 0;
-    } else {
-        char new_line[__STAT_LINE_SZ];
-        int chars;
-        unsigned int lvl;
-        // Allocate (a lot of) memory for the fake text file.
-        write_ptr = (char *)vzalloc(new_stat_sz);
-        if (write_ptr == NULL) {
-            kfree(snaps);
-            kfree(new_stat);
-            return -ENOMEM;
-        }
-        new_stat->stat_data = write_ptr;
-        // "Print" lines.
-        for (tag = 0; tag < max_tags; tag++) {
-            if (!(snaps[tag].valid)) continue;
-            for (lvl = 0; lvl < __NR_LEVELS; lvl++) {
-                memset(new_line, 0, __STAT_LINE_SZ);
-                chars = scnprintf(new_line, __STAT_LINE_SZ,
-                                  "%u\t%d\t%u\t%u\t%lu\n",
-                                  tag,
-                                  snaps[tag].key,
-                                  snaps[tag].c_euid.val,
-                                  lvl,
-                                  snaps[tag].readers_cnts[lvl]);
-                if (unlikely(!chars)) {
-                    printk(KERN_ERR "%s: Failed to \"print\" line in file.\n",
-                           MODNAME);
-                    kfree(snaps);
-                    vfree(new_stat->stat_data);
-                    kfree(new_stat);
-                    return -EFAULT;
-                }
-                memcpy(write_ptr, new_line, chars);
-                write_ptr += chars;
-                new_stat->stat_len += chars;
-            }
-        }
+    recs = (tag_snap_rec_t *)kmalloc(__NR_LEVELS * sizeof(tag_snap_rec_t),
+                                     GFP_KERNEL);
+    if (recs == NULL) return -ENOMEM;
+    ret = seq_open(filp, &tag_stat_sops);
+    if (ret) {
+        kfree(recs);
+        return ret;
     }
-    // Set session data and we're done.
-    kfree(snaps);
-    filp->private_data = (void *)new_stat;
+    ((struct seq_file *)(filp->private_data))->private = (void *)recs;
     return 0;
 }
 
 /**
- * @brief Read operation: returns some content from the fake text file.
+ * @brief Read operation: returns some content from the status file.
  *
  * @param file Device file struct.
  * @param buf Userspace buffer address.
@@ -204,28 +262,13 @@ int aos_tag_open(struct inode *inode, struct file *filp) {
  * @return Number of bytes read, or error code for errno.
  */
 ssize_t aos_tag_read(struct file *filp, char *buf, size_t size, loff_t *off) {
-    tag_stat_t *stat;
-    char *file_buf;
-    size_t file_sz;
-    unsigned long to_copy, copied;
     // Consistency checks.
     if ((filp == NULL) || (buf == NULL) || (off == NULL) || (*off < 0) ||
         (size == 0))
         return -EINVAL;
-    stat = (tag_stat_t *)(filp->private_data);
-    file_buf = stat->stat_data;
-    file_sz = stat->stat_len;
-    // Check for EOF condition.
-    if ((*off >= file_sz) || (stat->stat_len == 0))
-        return 0;  // This SHOULD be interpreted as EOF.
-    // Determine the correct amount of data to copy.
-    // Didn't know that this macro existed but many thanks to its author.
-    to_copy = min((unsigned long)size, file_sz - (unsigned long)*off);
-    copied = to_copy - copy_to_user(buf, file_buf + *off, to_copy);
-    if (copied == 0) return -EFAULT;
-    // Update file offset and we're done.
-    *off += copied;
-    return (ssize_t)copied;
+    if (iminor(file_inode(filp)) == __IO_MINOR) return -EPERM;
+    if (filp->private_data == NULL) return -EPERM;
+    return seq_read(filp, buf, size, off);
 }
 
 /**
@@ -243,31 +286,262 @@ ssize_t aos_tag_write(struct file *filp, const char *buf, size_t size,
 }
 
 /**
- * @brief I/O control: a nop.
+ * @brief Binary snapshot: copies status records of active instances to a 
+ * userspace buffer, one for each level, starting from a cursor. 
+ * The cursor encodes the next tag descriptor and level to report, starting 
+ * from 0, and is updated so that the next call resumes from there. 
+ * Each instance is read as the status file would, but nothing is formatted. 
+ * Records of an instance copied in two calls might come from two snapshots.
+ *
+ * @param version Records layout version expected by the caller.
+ * @param urecs Userspace records buffer.
+ * @param nr_recs Number of records the buffer can hold.
+ * @param ucursor Userspace address of the cursor.
+ * @return Number of records copied, 0 at the end, or error code for errno.
+ */
+static long aos_tag_snapshot(unsigned int version, tag_snap_rec_t *urecs,
+                             unsigned int nr_recs, unsigned long *ucursor) {
+    tag_snap_rec_t *recs;
+    unsigned long cursor, tag;
+    unsigned int lvl, copied = 0;
+    long ret = 0;
+    // Consistency checks.
+    if (version != __TAG_SNAP_VERSION) return -EPROTONOSUPPORT;
+    if ((urecs == NULL) || (nr_recs == 0) || (ucursor == NULL))
+        return -EINVAL;
+    if (get_user(cursor, ucursor)) return -EFAULT;
+    tag = cursor / __NR_LEVELS;
+    lvl = (unsigned int)(cursor % __NR_LEVELS);
+    recs = (tag_snap_rec_t *)kmalloc(__NR_LEVELS * sizeof(tag_snap_rec_t),
+                                     GFP_KERNEL);
+    if (recs == NULL) return -ENOMEM;
+    while (copied < nr_recs) {
+        unsigned int to_copy;
+        // Look for the next descriptor in use, as the status file would.
+        if (tag >= max_tags) break;
+        tag = find_next_bit(tags_mask->_mask, max_tags, tag);
+        if (tag >= max_tags) break;
+        if (aos_tag_snap_take((unsigned int)tag, recs)) {
+            tag++;
+            lvl = 0;
+            continue;
+        }
+        // Copy only after the instance has been released.
+        to_copy = min(nr_recs - copied, __NR_LEVELS - lvl);
+        if (copy_to_user(urecs + copied, recs + lvl,
+                         to_copy * sizeof(tag_snap_rec_t))) {
+            ret = -EFAULT;
+            break;
+        }
+        copied += to_copy;
+        lvl += to_copy;
+        if (lvl == __NR_LEVELS) {
+            tag++;
+            lvl = 0;
+        }
+    }
+    kfree(recs);
+    if (ret) return ret;
+    // Update the cursor and we're done.
+    if (tag >= max_tags) {
+        tag = max_tags;
+        lvl = 0;
+    }
+    cursor = (tag * __NR_LEVELS) + lvl;
+    if (put_user(cursor, ucursor)) return -EFAULT;
+    return (long)copied;
+}
+
+/**
+ * @brief Resets the latency histograms of all levels of an instance. 
+ * Only its creator, or root, may do this, whatever the instance permissions. 
+ * Records that race with the reset may survive it.
+ *
+ * @param tag Tag descriptor of the instance.
+ * @return 0, or error code for errno.
+ */
+static long aos_tag_hist_reset(int tag) {
+    tag_t *tag_inst;
+    // Consistency checks.
+    if ((tag < 0) || (tag >= max_tags)) return -EINVAL;
+    // Keep removers away while we're at it.
+    if (down_read_killable(&(tags_list[tag].snd_rwsem)) == -EINTR)
+        return -EINTR;
+    tag_inst = tags_list[tag].ptr;
+    if (tag_inst == NULL) {
+        up_read(&(tags_list[tag].snd_rwsem));
+        return -EIDRM;
+    }
+    if ((current_euid().val != 0) &&
+        (tag_inst->creator_euid.val != current_euid().val)) {
+        up_read(&(tags_list[tag].snd_rwsem));
+        return -EACCES;
+    }
+    memset(&((tag_inst->stats)->hists), 0, sizeof((tag_inst->stats)->hists));
+    up_read(&(tags_list[tag].snd_rwsem));
+    return 0;
+}
+
+/**
+ * @brief Copies the contention counters of all lock classes, in class order. 
+ * Classes bound to descriptors are summed over all of them, each counting 
+ * since it was last taken by an instance. 
+ * Counters are read while they are updated, with no ordering between them.
+ *
+ * @param ustats Userspace buffer to fill.
+ * @param nr_stats Number of classes the buffer can hold.
+ * @return Number of classes copied, or error code for errno.
+ */
+static long aos_tag_lock_stats(tag_lock_stats_t *ustats,
+                               unsigned int nr_stats) {
+    tag_lock_stats_t sums[__TAG_LOCK_CLASSES];
+    unsigned int tag, cls;
+    // Consistency checks.
+    if ((ustats == NULL) || (nr_stats == 0)) return -EINVAL;
+    if (nr_stats > __TAG_LOCK_CLASSES) nr_stats = __TAG_LOCK_CLASSES;
+    memset(sums, 0, sizeof(sums));
+    for (tag = 0; tag < max_tags; tag++) {
+        for (cls = 0; cls < __TAG_INST_LOCKS; cls++) {
+            tag_lock_stats_t *st = TAG_LOCK_INST(tag, cls);
+            atomic_long_add(atomic_long_read(&(st->acquired)),
+                            &(sums[cls].acquired));
+            atomic_long_add(atomic_long_read(&(st->contended)),
+                            &(sums[cls].contended));
+            atomic_long_add(atomic_long_read(&(st->wait_ns)),
+                            &(sums[cls].wait_ns));
+            atomic_long_add(atomic_long_read(&(st->hold_ns)),
+                            &(sums[cls].hold_ns));
+        }
+    }
+    for (cls = __TAG_INST_LOCKS; cls < __TAG_LOCK_CLASSES; cls++) {
+        tag_lock_stats_t *st = TAG_LOCK_GLOBL(cls);
+        atomic_long_set(&(sums[cls].acquired),
+                        atomic_long_read(&(st->acquired)));
+        atomic_long_set(&(sums[cls].contended),
+                        atomic_long_read(&(st->contended)));
+        atomic_long_set(&(sums[cls].wait_ns), atomic_long_read(&(st->wait_ns)));
+        atomic_long_set(&(sums[cls].hold_ns), atomic_long_read(&(st->hold_ns)));
+    }
+    if (copy_to_user(ustats, sums, nr_stats * sizeof(tag_lock_stats_t)))
+        return -EFAULT;
+    return (long)nr_stats;
+}
+
+/**
+ * @brief I/O control: on the data plane device, executes one of the service 
+ * operations, exactly as the corresponding system call would. 
+ * This way the service is available even without the system calls. 
+ * Also sets up and drives the session's ring set, if any. 
+ * On the status device, takes binary snapshots, resets latency histograms and 
+ * reads lock contention counters. 
+ * The module can't go away while the device file is open, so no further 
+ * reference is taken here.
  *
  * @param file Device file struct.
  * @param cmd Command to execute.
- * @param param Parameter for the aforementioned command execution.
- * @return 0, or error code for errno.
+ * @param param Userspace address of the arguments for the command.
+ * @return Result of the operation, or error code for errno.
  */
 long aos_tag_ioctl(struct file *filp, unsigned int cmd, unsigned long param) {
-    return -EPERM;
+    tag_ioc_args_t ioc;
+    unsigned long *args = ioc.args;
+    // Consistency checks.
+    if (filp == NULL) return -EPERM;
+    if (_IOC_TYPE(cmd) != __TAG_IOC_MAGIC) return -ENOTTY;
+    if (copy_from_user(&ioc, (void *)param, sizeof(tag_ioc_args_t)))
+        return -EFAULT;
+    // The status device only takes snapshots, resets histograms and reads
+    // lock counters.
+    if (iminor(file_inode(filp)) != __IO_MINOR) {
+        if (cmd == __TAG_IOC_HIST_RESET)
+            return aos_tag_hist_reset((int)args[0]);
+        if (cmd == __TAG_IOC_LOCK_STATS)
+            return aos_tag_lock_stats((tag_lock_stats_t *)args[0],
+                                      (unsigned int)args[1]);
+        if (cmd != __TAG_IOC_SNAPSHOT) return -EPERM;
+        return aos_tag_snapshot((unsigned int)args[0],
+                                (tag_snap_rec_t *)args[1],
+                                (unsigned int)args[2],
+                                (unsigned long *)args[3]);
+    }
+    switch (cmd) {
+    case __TAG_IOC_GET:
+        return aos_tag_get((int)args[0], (int)args[1], (int)args[2]);
+    case __TAG_IOC_RECEIVE:
+        return aos_tag_rcv((int)args[0], (tag_lvl_t)args[1], (char *)args[2],
+                           (size_t)args[3], (int)args[4],
+                           (tag_filter_t *)args[5]);
+    case __TAG_IOC_SEND:
+        return aos_tag_snd((int)args[0], (tag_lvl_t)args[1], (char *)args[2],
+                           (size_t)args[3]);
+    case __TAG_IOC_CTL:
+        return aos_tag_ctl((int)args[0], (int)args[1], (int)args[2], args[3]);
+    case __TAG_IOC_SEND_MULTI:
+        return aos_tag_snd_multi((tag_target_t *)args[0],
+                                 (unsigned int)args[1], (char *)args[2],
+                                 (size_t)args[3]);
+    case __TAG_IOC_CALL:
+        return aos_tag_call((int)args[0], (int)args[1], (int)args[2],
+                            (char *)args[3], (size_t)args[4],
+                            (size_t)args[5]);
+    case __TAG_IOC_RING_SETUP:
+        return aos_tag_ring_setup(filp, (unsigned int)args[0],
+                                  (size_t)args[1]);
+    case __TAG_IOC_RING_ENTER:
+        if (READ_ONCE(filp->private_data) == NULL) return -ENXIO;
+        return aos_tag_ring_enter((tag_ring_t *)(filp->private_data),
+                                  (unsigned int)args[0],
+                                  (unsigned int)args[1]);
+    default:
+        return -ENOTTY;
+    }
+}
+
+/**
+ * @brief Memory map: on the data plane device, maps the shared area of the 
+ * session's ring set. On the status device, maps the traffic counters of all 
+ * tag descriptors, read-only.
+ *
+ * @param file Device file struct.
+ * @param vma Userspace VMA to map the area into.
+ * @return 0, or error code for errno.
+ */
+int aos_tag_mmap(struct file *filp, struct vm_area_struct *vma) {
+    tag_ring_t *ring;
+    // Consistency checks.
+    if ((filp == NULL) || (vma == NULL)) return -EINVAL;
+    if (iminor(file_inode(filp)) != __IO_MINOR) {
+        // The traffic counters are read-only, and always mapped whole.
+        if ((vma->vm_pgoff != 0) ||
+            ((vma->vm_end - vma->vm_start) != TAG_STATS_SZ(max_tags)))
+            return -EINVAL;
+        if (vma->vm_flags & VM_WRITE) return -EPERM;
+        TAG_VM_FLAGS_CLEAR(vma, VM_MAYWRITE);
+        TAG_VM_FLAGS_SET(vma, VM_DONTEXPAND | VM_DONTDUMP);
+        return remap_vmalloc_range(vma, (void *)tags_stats, 0);
+    }
+    ring = (tag_ring_t *)READ_ONCE(filp->private_data);
+    if (ring == NULL) return -ENXIO;
+    return aos_tag_ring_mmap(ring, vma);
 }
 
 /**
- * @brief When the last session is closed, releases the fake file.
+ * @brief When the last session is closed, releases the status file iterator, 
+ * or the ring set on the data plane device.
  *
  * @param inode Device file inode.
  * @param file Device file struct.
  * @return 0, or error code for errno.
  */
 int aos_tag_release(struct inode *inode, struct file *filp) {
-    tag_stat_t *stat;
     if (filp == NULL) return -EINVAL;
-    stat = (tag_stat_t *)(filp->private_data);
-    filp->private_data = NULL;
-    stat->stat_len = 0;
-    vfree(stat->stat_data);
-    kfree(stat);
-    return 0;
+    if (iminor(file_inode(filp)) == __IO_MINOR) {
+        if (filp->private_data != NULL)
+            aos_tag_ring_release((tag_ring_t *)(filp->private_data));
+        filp->private_data = NULL;
+        return 0;
+    }
+    if (filp->private_data == NULL) return 0;
+    kfree(((struct seq_file *)(filp->private_data))->private);
+    return seq_release(inode, filp);
 }
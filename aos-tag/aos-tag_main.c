@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/syscalls.h>
 #include <linux/fs.h>
 #include <linux/cdev.h>
@@ -32,6 +33,13 @@
 #include <linux/errno.h>
 #include <linux/version.h>
 #include <linux/compiler.h>
+#include <linux/percpu-refcount.h>
+#include <linux/completion.h>
+#include <linux/jiffies.h>
+#include <linux/eventfd.h>
+#include <linux/moduleparam.h>
+#include <linux/jump_label.h>
+#include <linux/namei.h>
 
 #include "scth/include/scth.h"
 
@@ -39,6 +47,11 @@
 #include "include/aos-tag_types.h"
 #include "include/aos-tag_syscalls.h"
 #include "include/aos-tag_dev-driver.h"
+#include "include/aos-tag_debug.h"
+#include "include/aos-tag_locks.h"
+
+#define CREATE_TRACE_POINTS
+#include "include/aos-tag_trace.h"
 
 #include "utils/aos-tag_bitmask.h"
 
@@ -49,6 +62,13 @@
 #error "This module requires kernel >= 4.17."
 #endif
 
+/* class_create lost its owner argument in 6.4. */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 4, 0)
+#define TAG_CLASS_CREATE(name) class_create(THIS_MODULE, (name))
+#else
+#define TAG_CLASS_CREATE(name) class_create(name)
+#endif
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Roberto Masocco <robmasocco@gmail.com>");
 MODULE_DESCRIPTION("Tag-based IPC service.");
@@ -77,6 +97,16 @@ int tag_ctl_nr = 0;
 module_param(tag_ctl_nr, int, S_IRUGO);
 MODULE_PARM_DESC(tag_ctl_nr, "tag_ctl syscall number.");
 
+/* tag_send_multi system call number. */
+int tag_send_multi_nr = 0;
+module_param(tag_send_multi_nr, int, S_IRUGO);
+MODULE_PARM_DESC(tag_send_multi_nr, "tag_send_multi syscall number.");
+
+/* tag_call system call number. */
+int tag_call_nr = 0;
+module_param(tag_call_nr, int, S_IRUGO);
+MODULE_PARM_DESC(tag_call_nr, "tag_call syscall number.");
+
 /* Device driver major number. */
 int tag_drv_major = 0;
 module_param(tag_drv_major, int, S_IRUGO);
@@ -92,40 +122,144 @@ unsigned int max_msg_sz = __MAX_MSG_SZ_DFL;
 module_param(max_msg_sz, uint, S_IRUGO);
 MODULE_PARM_DESC(max_msg_sz, "Max message size for all instances.");
 
+/* Refuse insertion if system calls can't be installed. */
+bool require_scth = false;
+module_param(require_scth, bool, S_IRUGO);
+MODULE_PARM_DESC(require_scth, "Fail insertion without the SCTH module.");
+
+/* Debug print switches, one per subsystem. */
+struct static_key_false tag_dbg_keys[__TAG_DBG_NR] = {
+    [0 ... __TAG_DBG_NR - 1] = STATIC_KEY_FALSE_INIT
+};
+
+/**
+ * @brief Sets the debug mask, flipping the keys of the subsystems in it.
+ *
+ * @param val New mask, as written by the user.
+ * @param kp Parameter to set.
+ * @return 0 if all went well, or an error code.
+ */
+static int aos_tag_dbg_set(const char *val, const struct kernel_param *kp) {
+    unsigned int mask;
+    int i, ret;
+    ret = kstrtouint(val, 0, &mask);
+    if (ret) return ret;
+    if (mask & ~__TAG_DBG_ALL) return -EINVAL;
+    // Callers are serialized by the parameters lock.
+    for (i = 0; i < __TAG_DBG_NR; i++) {
+        if (mask & (1U << i)) static_branch_enable(&(tag_dbg_keys[i]));
+        else static_branch_disable(&(tag_dbg_keys[i]));
+    }
+    *((unsigned int *)kp->arg) = mask;
+    return 0;
+}
+
+static const struct kernel_param_ops tag_dbg_ops = {
+    .set = aos_tag_dbg_set,
+    .get = param_get_uint,
+};
+
+/* Debug mask: get, receive, send, ctl, rings (bits 0 to 4). */
+#ifdef DEBUG
+unsigned int tag_dbg_mask = __TAG_DBG_ALL;
+#else
+unsigned int tag_dbg_mask = 0;
+#endif
+module_param_cb(debug, &tag_dbg_ops, &tag_dbg_mask, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(debug, "Debug prints mask: 0x1 get, 0x2 receive, 0x4 send, "
+                 "0x8 ctl, 0x10 rings.");
+
+/* Lock contention accounting switch. */
+DEFINE_STATIC_KEY_FALSE(tag_lockstat_key);
+
+/**
+ * @brief Sets the lock contention accounting switch, flipping its key.
+ *
+ * @param val New value, as written by the user.
+ * @param kp Parameter to set.
+ * @return 0 if all went well, or an error code.
+ */
+static int aos_tag_lockstat_set(const char *val,
+                                const struct kernel_param *kp) {
+    int ret = param_set_bool(val, kp);
+    if (ret) return ret;
+    if (*((bool *)kp->arg)) static_branch_enable(&tag_lockstat_key);
+    else static_branch_disable(&tag_lockstat_key);
+    return 0;
+}
+
+static const struct kernel_param_ops tag_lockstat_ops = {
+    .set = aos_tag_lockstat_set,
+    .get = param_get_bool,
+};
+
+/* Enables lock contention accounting. */
+bool tag_lock_stats = false;
+module_param_cb(lock_stats, &tag_lockstat_ops, &tag_lock_stats,
+                S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(lock_stats, "Enables lock contention accounting.");
+
+/* Module liveness reference, taken by system calls. */
+struct percpu_ref tag_ref;
+DECLARE_COMPLETION(tag_ref_done);
+
 /* SYSTEM CALLS STUBS */
 /* tag_get kernel level stub. */
 __SYSCALL_DEFINEx(3, _tag_get, int, key, int, cmd, int, perm) {
     int ret;
-    if (!try_module_get(THIS_MODULE)) return -ENOSYS;
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
     ret = aos_tag_get(key, cmd, perm);
-    module_put(THIS_MODULE);
+    percpu_ref_put(&tag_ref);
     return ret;
 }
 
 /* tag_receive kernel level stub. */
-__SYSCALL_DEFINEx(4, _tag_rcv, int, tag, int, lvl, char*, buf, size_t, size) {
+__SYSCALL_DEFINEx(6, _tag_rcv, int, tag, tag_lvl_t, lvl, char*, buf, size_t, size,
+                  int, flags, tag_filter_t*, flt) {
     int ret;
-    if (!try_module_get(THIS_MODULE)) return -ENOSYS;
-    ret = aos_tag_rcv(tag, lvl, buf, size);
-    module_put(THIS_MODULE);
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
+    ret = aos_tag_rcv(tag, lvl, buf, size, flags, flt);
+    percpu_ref_put(&tag_ref);
     return ret;
 }
 
 /* tag_send kernel level stub. */
-__SYSCALL_DEFINEx(4, _tag_snd, int, tag, int, lvl, char*, buf, size_t, size) {
+__SYSCALL_DEFINEx(4, _tag_snd, int, tag, tag_lvl_t, lvl, char*, buf,
+                  size_t, size) {
     int ret;
-    if (!try_module_get(THIS_MODULE)) return -ENOSYS;
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
     ret = aos_tag_snd(tag, lvl, buf, size);
-    module_put(THIS_MODULE);
+    percpu_ref_put(&tag_ref);
     return ret;
 }
 
 /* tag_ctl kernel level stub. */
-__SYSCALL_DEFINEx(2, _tag_ctl, int, tag, int, cmd) {
+__SYSCALL_DEFINEx(4, _tag_ctl, int, tag, int, cmd, int, lvl,
+                  unsigned long, arg) {
+    int ret;
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
+    ret = aos_tag_ctl(tag, cmd, lvl, arg);
+    percpu_ref_put(&tag_ref);
+    return ret;
+}
+
+/* tag_send_multi kernel level stub. */
+__SYSCALL_DEFINEx(4, _tag_snd_multi, tag_target_t*, targets,
+                  unsigned int, nr_targets, char*, buf, size_t, size) {
+    int ret;
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
+    ret = aos_tag_snd_multi(targets, nr_targets, buf, size);
+    percpu_ref_put(&tag_ref);
+    return ret;
+}
+
+/* tag_call kernel level stub. */
+__SYSCALL_DEFINEx(6, _tag_call, int, tag, int, lvl, int, rpl_lvl, char*, buf,
+                  size_t, size, size_t, rpl_size) {
     int ret;
-    if (!try_module_get(THIS_MODULE)) return -ENOSYS;
-    ret = aos_tag_ctl(tag, cmd);
-    module_put(THIS_MODULE);
+    if (!percpu_ref_tryget_live(&tag_ref)) return -ENOSYS;
+    ret = aos_tag_call(tag, lvl, rpl_lvl, buf, size, rpl_size);
+    percpu_ref_put(&tag_ref);
     return ret;
 }
 
@@ -133,19 +267,34 @@ extern struct file_operations tag_fops;
 extern struct cdev tag_cdev;
 extern struct device *tag_dev;
 extern dev_t tag_status_dvn;
+extern struct device *tag_io_dev;
+extern dev_t tag_io_dvn;
 extern struct class *tag_status_cls;
 
-/* Required module's reference. */
-struct module *scth_mod;
+/* SCTH routines, if that module is there. */
+int (*scth_hack_fn)(void *) = NULL;
+void (*scth_unhack_fn)(int) = NULL;
 
 /* GLOBAL MODULE VARIABLES */
-/* Shared instances BST-dictionary. */
-SplayIntTree *shared_bst = NULL;
-DECLARE_RWSEM(shared_bst_lock);
+/* Shared instances BST-dictionary, split in independently locked shards. */
+SplayIntTree *shared_bsts[__TAG_BST_SHARDS];
+struct rw_semaphore shared_bst_locks[__TAG_BST_SHARDS];
+u64 shared_bst_stamps[__TAG_BST_SHARDS];
+
+/* Relay rules: changed by writers, while removers are readers. */
+DECLARE_RWSEM(relay_rwsem);
+atomic_t nr_relays = ATOMIC_INIT(0);
 
 /* Instances array and related bitmask. */
 tag_ptr_t *tags_list = NULL;
 tag_bitmask *tags_mask = NULL;
+u64 tags_mask_stamp = 0;
+
+/* Traffic counters, one slot for each tag descriptor. */
+tag_stats_t *tags_stats = NULL;
+
+/* Contention counters of lock classes not bound to descriptors. */
+tag_lock_stats_t tag_lock_globl[__TAG_LOCK_CLASSES - __TAG_INST_LOCKS];
 
 /**
  * @brief Routine to set access permissions for device files through sysfs's 
@@ -162,6 +311,50 @@ static char *tag_devnode(struct device *dev, umode_t *mode) {
     return NULL;
 }
 
+/**
+ * @brief Releases the SCTH module, if it was found.
+ */
+static void scth_release(void) {
+    if (scth_hack_fn != NULL) symbol_put(scth_hack);
+    if (scth_unhack_fn != NULL) symbol_put(scth_unhack);
+    scth_hack_fn = NULL;
+    scth_unhack_fn = NULL;
+}
+
+/**
+ * @brief Tells whether the SCTH module is loaded, even if its routines can't
+ * be resolved, e.g. because it was built with exports we can't link to.
+ *
+ * @return 1 if it's loaded, 0 otherwise.
+ */
+static int scth_loaded(void) {
+    struct path path;
+    if (kern_path("/sys/module/scth", LOOKUP_DIRECTORY, &path)) return 0;
+    path_put(&path);
+    return 1;
+}
+
+/**
+ * @brief Frees all shards of the BST dictionary that have been created.
+ */
+static void shared_bsts_delete(void) {
+    unsigned int i;
+    for (i = 0; i < __TAG_BST_SHARDS; i++) {
+        delete_splay_int_tree(shared_bsts[i]);
+        shared_bsts[i] = NULL;
+    }
+}
+
+/**
+ * @brief Release routine for the module liveness reference, called once it 
+ * has been killed and the last system call in progress has left.
+ *
+ * @param ref Reference that dropped to zero.
+ */
+static void tag_ref_release(struct percpu_ref *ref) {
+    complete(&tag_ref_done);
+}
+
 /**
  * @brief Module initialization routine. 
  * Initializes the module's data and internal structures, and 
@@ -176,36 +369,53 @@ int init_module(void) {
     // Consistency check on module parameters.
     if (max_tags < __MAX_TAGS_DFL) max_tags = __MAX_TAGS_DFL;
     if (max_msg_sz < __MAX_MSG_SZ_DFL) max_msg_sz = __MAX_MSG_SZ_DFL;
-    // Lock the SCTH module.
-    mutex_lock(&module_mutex);
-    scth_mod = find_module("scth");
-    if (!try_module_get(scth_mod)) {
-        mutex_unlock(&module_mutex);
-        printk(KERN_ERR "%s: SCTH module not found.\n", MODNAME);
-        return -EPERM;
+    // Apply the default debug mask, if it wasn't set from the command line.
+    for (i = 0; i < __TAG_DBG_NR; i++)
+        if (tag_dbg_mask & (1U << i)) static_branch_enable(&(tag_dbg_keys[i]));
+    // Lock the SCTH module, if it's there: otherwise, the service will only
+    // be available through the data plane device file. If it's there but we
+    // can't link to it, something is wrong with it, so don't hide that.
+    scth_hack_fn = symbol_get(scth_hack);
+    scth_unhack_fn = symbol_get(scth_unhack);
+    if ((scth_hack_fn == NULL) || (scth_unhack_fn == NULL)) {
+        scth_release();
+        if (scth_loaded()) {
+            printk(KERN_ERR "%s: SCTH module is loaded, but its routines "
+                            "can't be resolved.\n", MODNAME);
+            return -ENOENT;
+        }
+        if (require_scth) {
+            printk(KERN_ERR "%s: SCTH module not found.\n", MODNAME);
+            return -ENOENT;
+        }
+        printk(KERN_WARNING "%s: SCTH module not found, system calls will not "
+                            "be installed.\n", MODNAME);
     }
-    mutex_unlock(&module_mutex);
-    // Create BST dictionary.
-    shared_bst = create_splay_int_tree();
-    if (unlikely(shared_bst == NULL)) {
-        printk(KERN_ERR "%s: Failed to create BST dictionary.\n", MODNAME);
-        module_put(scth_mod);
-        return -ENOMEM;
+    // Create BST dictionary shards.
+    for (i = 0; i < __TAG_BST_SHARDS; i++) {
+        init_rwsem(&(shared_bst_locks[i]));
+        shared_bsts[i] = create_splay_int_tree();
+        if (unlikely(shared_bsts[i] == NULL)) {
+            printk(KERN_ERR "%s: Failed to create BST dictionary.\n", MODNAME);
+            scth_release();
+            shared_bsts_delete();
+            return -ENOMEM;
+        }
     }
     // Create the tags bitmask.
     tags_mask = TAG_MASK_CREATE(max_tags);
     if (unlikely(tags_mask == NULL)) {
         printk(KERN_ERR "%s: Failed to create tags bitmask.\n", MODNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        scth_release();
+        shared_bsts_delete();
         return -ENOMEM;
     }
     // Create the tags list.
     tags_list = (tag_ptr_t *)kzalloc(sizeof(tag_ptr_t) * max_tags, GFP_KERNEL);
     if (unlikely(tags_list == NULL)) {
         printk(KERN_ERR "%s: Failed to create tags list.\n", MODNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         return -ENOMEM;
     }
@@ -214,91 +424,163 @@ int init_module(void) {
         init_rwsem(&(tags_list[i].rcv_rwsem));
         init_rwsem(&(tags_list[i].snd_rwsem));
     }
+    // Create the traffic counters area, which is mapped in user space.
+    tags_stats = (tag_stats_t *)vmalloc_user(TAG_STATS_SZ(max_tags));
+    if (unlikely(tags_stats == NULL)) {
+        printk(KERN_ERR "%s: Failed to create traffic counters.\n", MODNAME);
+        scth_release();
+        shared_bsts_delete();
+        TAG_MASK_FREE(tags_mask);
+        kfree(tags_list);
+        return -ENOMEM;
+    }
     // Initialize and register device driver.
     cdev_init(&tag_cdev, &tag_fops);
-    tag_drv_major = __register_chrdev(0, 0, 1, __DRVNAME, &tag_fops);
+    tag_drv_major = __register_chrdev(0, 0, __NR_MINORS, __DRVNAME, &tag_fops);
     if (tag_drv_major < 0) {
         printk(KERN_ERR "%s: Failed to register char device.\n", MODNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         kfree(tags_list);
+        vfree(tags_stats);
         return tag_drv_major;
     }
     // Must create kobjects in /sys/class before doing stuff in /dev, also
     // to get access permissions right.
-    tag_status_cls = class_create(THIS_MODULE, __STAT_DEVFILE);
+    tag_status_cls = TAG_CLASS_CREATE(__STAT_DEVFILE);
     if (IS_ERR(tag_status_cls)) {
         printk(KERN_ERR "%s: Failed to create status device class.\n", MODNAME);
-        __unregister_chrdev(tag_drv_major, 0, 1, __DRVNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         kfree(tags_list);
+        vfree(tags_stats);
         return -EPERM;
     }
     tag_status_cls->devnode = tag_devnode;
-    // Create device file in /dev.
-    tag_status_dvn = MKDEV(tag_drv_major, 0);
+    // Create device files in /dev.
+    tag_status_dvn = MKDEV(tag_drv_major, __STAT_MINOR);
     tag_dev = device_create(tag_status_cls, NULL, tag_status_dvn,
                             NULL, __STAT_DEVFILE);
     if (IS_ERR(tag_dev)) {
         printk(KERN_ERR "%s: Failed to create device file %s.\n",
                MODNAME, __STAT_DEVFILE);
         class_destroy(tag_status_cls);
-        __unregister_chrdev(tag_drv_major, 0, 1, __DRVNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         kfree(tags_list);
+        vfree(tags_stats);
         return -EPERM;
     }
-    // Device goes live.
-    ret = cdev_add(&tag_cdev, tag_status_dvn, 1);
+    tag_io_dvn = MKDEV(tag_drv_major, __IO_MINOR);
+    tag_io_dev = device_create(tag_status_cls, NULL, tag_io_dvn,
+                               NULL, __IO_DEVFILE);
+    if (IS_ERR(tag_io_dev)) {
+        printk(KERN_ERR "%s: Failed to create device file %s.\n",
+               MODNAME, __IO_DEVFILE);
+        device_destroy(tag_status_cls, tag_status_dvn);
+        class_destroy(tag_status_cls);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
+        scth_release();
+        shared_bsts_delete();
+        TAG_MASK_FREE(tags_mask);
+        kfree(tags_list);
+        vfree(tags_stats);
+        return -EPERM;
+    }
+    // Devices go live.
+    ret = cdev_add(&tag_cdev, tag_status_dvn, __NR_MINORS);
     if (ret < 0) {
         printk(KERN_ERR "%s: Failed to add char device.\n", MODNAME);
+        device_destroy(tag_status_cls, tag_io_dvn);
+        device_destroy(tag_status_cls, tag_status_dvn);
+        class_destroy(tag_status_cls);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
+        scth_release();
+        shared_bsts_delete();
+        TAG_MASK_FREE(tags_mask);
+        kfree(tags_list);
+        vfree(tags_stats);
+        return ret;
+    }
+    // Initialize the liveness reference, that system calls will take.
+    ret = percpu_ref_init(&tag_ref, tag_ref_release, 0, GFP_KERNEL);
+    if (ret < 0) {
+        printk(KERN_ERR "%s: Failed to initialize module reference.\n",
+               MODNAME);
+        cdev_del(&tag_cdev);
+        device_destroy(tag_status_cls, tag_io_dvn);
         device_destroy(tag_status_cls, tag_status_dvn);
         class_destroy(tag_status_cls);
-        __unregister_chrdev(tag_drv_major, 0, 1, __DRVNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         kfree(tags_list);
+        vfree(tags_stats);
         return ret;
     }
-    // Install the new system calls.
-    tag_get_nr = scth_hack(__x64_sys_tag_get);
-    tag_receive_nr = scth_hack(__x64_sys_tag_rcv);
-    tag_send_nr = scth_hack(__x64_sys_tag_snd);
-    tag_ctl_nr = scth_hack(__x64_sys_tag_ctl);
-    if ((tag_get_nr == -1) ||
+    // Install the new system calls, if we can.
+    if (scth_hack_fn != NULL) {
+        tag_get_nr = scth_hack_fn(__x64_sys_tag_get);
+        tag_receive_nr = scth_hack_fn(__x64_sys_tag_rcv);
+        tag_send_nr = scth_hack_fn(__x64_sys_tag_snd);
+        tag_ctl_nr = scth_hack_fn(__x64_sys_tag_ctl);
+        tag_send_multi_nr = scth_hack_fn(__x64_sys_tag_snd_multi);
+        tag_call_nr = scth_hack_fn(__x64_sys_tag_call);
+    } else {
+        tag_get_nr = -1;
+        tag_receive_nr = -1;
+        tag_send_nr = -1;
+        tag_ctl_nr = -1;
+        tag_send_multi_nr = -1;
+        tag_call_nr = -1;
+    }
+    if ((scth_hack_fn != NULL) && ((tag_get_nr == -1) ||
         (tag_receive_nr == -1) ||
         (tag_send_nr == -1) ||
-        (tag_ctl_nr == -1)) {
-        if (tag_get_nr != -1) scth_unhack(tag_get_nr);
-        if (tag_receive_nr != -1) scth_unhack(tag_receive_nr);
-        if (tag_send_nr != -1) scth_unhack(tag_send_nr);
-        if (tag_ctl_nr != -1) scth_unhack(tag_ctl_nr);
+        (tag_ctl_nr == -1) ||
+        (tag_send_multi_nr == -1) ||
+        (tag_call_nr == -1))) {
+        if (tag_get_nr != -1) scth_unhack_fn(tag_get_nr);
+        if (tag_receive_nr != -1) scth_unhack_fn(tag_receive_nr);
+        if (tag_send_nr != -1) scth_unhack_fn(tag_send_nr);
+        if (tag_ctl_nr != -1) scth_unhack_fn(tag_ctl_nr);
+        if (tag_send_multi_nr != -1) scth_unhack_fn(tag_send_multi_nr);
+        if (tag_call_nr != -1) scth_unhack_fn(tag_call_nr);
         printk(KERN_ERR "%s: Failed to install system calls.\n", MODNAME);
-        module_put(scth_mod);
-        delete_splay_int_tree(shared_bst);
+        percpu_ref_exit(&tag_ref);
+        scth_release();
+        shared_bsts_delete();
         TAG_MASK_FREE(tags_mask);
         kfree(tags_list);
+        vfree(tags_stats);
         cdev_del(&tag_cdev);
+        device_destroy(tag_status_cls, tag_io_dvn);
         device_destroy(tag_status_cls, tag_status_dvn);
         class_destroy(tag_status_cls);
-        __unregister_chrdev(tag_drv_major, 0, 1, __DRVNAME);
+        __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
         return -EPERM;
     }
     printk(KERN_INFO "%s: Initialization completed successfully.\n", MODNAME);
-    printk(KERN_INFO "%s: tag_get installed at entry no. %d.\n",
-           MODNAME, tag_get_nr);
-    printk(KERN_INFO "%s: tag_receive installed at entry no. %d.\n",
-           MODNAME, tag_receive_nr);
-    printk(KERN_INFO "%s: tag_send installed at entry no. %d.\n",
-           MODNAME, tag_send_nr);
-    printk(KERN_INFO "%s: tag_ctl installed at entry no. %d.\n",
-           MODNAME, tag_ctl_nr);
+    if (scth_hack_fn != NULL) {
+        printk(KERN_INFO "%s: tag_get installed at entry no. %d.\n",
+               MODNAME, tag_get_nr);
+        printk(KERN_INFO "%s: tag_receive installed at entry no. %d.\n",
+               MODNAME, tag_receive_nr);
+        printk(KERN_INFO "%s: tag_send installed at entry no. %d.\n",
+               MODNAME, tag_send_nr);
+        printk(KERN_INFO "%s: tag_ctl installed at entry no. %d.\n",
+               MODNAME, tag_ctl_nr);
+        printk(KERN_INFO "%s: tag_send_multi installed at entry no. %d.\n",
+               MODNAME, tag_send_multi_nr);
+        printk(KERN_INFO "%s: tag_call installed at entry no. %d.\n",
+               MODNAME, tag_call_nr);
+    }
     printk(KERN_INFO "%s: Device driver registered with major number: %d.\n",
            MODNAME, tag_drv_major);
     return 0;
@@ -306,20 +588,46 @@ int init_module(void) {
 
 /**
  * @brief Module cleanup routine. 
- * Undoes all that init_module did, in reverse.
+ * Undoes all that init_module did, in reverse. 
+ * System calls do not pin the module, so threads might still be in there: 
+ * after the table is restored and the liveness reference is killed, all 
+ * instances are awoken until the last of them leaves.
  */
 void cleanup_module(void) {
     unsigned int i = 0;
     // Restore the system call table and release the SCTH module.
-    scth_unhack(tag_get_nr);
-    scth_unhack(tag_receive_nr);
-    scth_unhack(tag_send_nr);
-    scth_unhack(tag_ctl_nr);
-    module_put(scth_mod);
+    if (scth_unhack_fn != NULL) {
+        scth_unhack_fn(tag_get_nr);
+        scth_unhack_fn(tag_receive_nr);
+        scth_unhack_fn(tag_send_nr);
+        scth_unhack_fn(tag_ctl_nr);
+        scth_unhack_fn(tag_send_multi_nr);
+        scth_unhack_fn(tag_call_nr);
+    }
+    scth_release();
+    // From now on, threads that still get to the stubs will be turned away.
+    percpu_ref_kill(&tag_ref);
+    // Receivers that registered after an AWAKE_ALL wouldn't get it, so repeat
+    // it until everyone is gone.
+    while (!wait_for_completion_timeout(&tag_ref_done,
+                                        msecs_to_jiffies(100))) {
+        for (i = 0; i < max_tags; i++) {
+            down_read(&(tags_list[i].snd_rwsem));
+            if (tags_list[i].ptr != NULL) {
+                mutex_lock(&(tags_list[i].ptr->awake_all_lock));
+                aos_tag_awake_all(tags_list[i].ptr);
+                mutex_unlock(&(tags_list[i].ptr->awake_all_lock));
+            }
+            up_read(&(tags_list[i].snd_rwsem));
+        }
+    }
+    percpu_ref_exit(&tag_ref);
+    i = 0;
     cdev_del(&tag_cdev);
+    device_destroy(tag_status_cls, tag_io_dvn);
     device_destroy(tag_status_cls, tag_status_dvn);
     class_destroy(tag_status_cls);
-    __unregister_chrdev(tag_drv_major, 0, 1, __DRVNAME);
+    __unregister_chrdev(tag_drv_major, 0, __NR_MINORS, __DRVNAME);
     // Scan the tags list, releasing leftovers.
     for (; i < max_tags; i++) {
         tag_t *curr_tag;
@@ -327,15 +635,17 @@ void cleanup_module(void) {
         if (curr_tag != NULL) {
             unsigned int j = 0;
             for (; j < __NR_LEVELS; j++) {
-                char *curr_buf;
-                curr_buf = (curr_tag->msg_bufs)[j];
-                if (curr_buf != NULL) kfree(curr_buf);
+                TAG_MSG_PUT((curr_tag->last_msgs)[j]);
+                TAG_MSG_PUT((curr_tag->next_msgs)[j]);
+                if ((curr_tag->lvl_evfds)[j] != NULL)
+                    eventfd_ctx_put((curr_tag->lvl_evfds)[j]);
             }
             kfree(curr_tag);
         }
     }
     kfree(tags_list);
+    vfree(tags_stats);
     TAG_MASK_FREE(tags_mask);
-    delete_splay_int_tree(shared_bst);
+    shared_bsts_delete();
     printk(KERN_INFO "%s: Shutdown...\n", MODNAME);
 }
@@ -0,0 +1,534 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Source code file for the submission/completion rings of the data 
+ * plane device.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/list.h>
+#include <linux/rwsem.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/cred.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/errno.h>
+#include <linux/compiler.h>
+
+#include "include/aos-tag.h"
+#include "include/aos-tag_types.h"
+#include "include/aos-tag_syscalls.h"
+#include "include/aos-tag_rings.h"
+#include "include/aos-tag_debug.h"
+#include "include/aos-tag_locks.h"
+
+#include "utils/aos-tag_messages.h"
+
+extern tag_ptr_t *tags_list;
+
+extern unsigned int max_tags;
+
+/**
+ * @brief Posts a completion on a ring, and wakes up whoever is waiting for it. 
+ * The caller must hold the ring's completion queue lock, and must have made 
+ * sure that there is room for the completion.
+ *
+ * @param ring Ring to post the completion on.
+ * @param user_data User data of the completed operation.
+ * @param res Result of the completed operation.
+ */
+static void aos_tag_ring_post_cqe(tag_ring_t *ring, unsigned long user_data,
+                                  long res) {
+    tag_cqe_t *cqe;
+    cqe = &((ring->cqes)[ring->cq_tail & (ring->hdr->cq_entries - 1)]);
+    cqe->user_data = user_data;
+    cqe->res = res;
+    ring->cq_tail++;
+    // Make the completion visible before the new tail.
+    smp_store_release(&(ring->hdr->cq_tail), ring->cq_tail);
+    wake_up_all(&(ring->cq_wait));
+}
+
+/**
+ * @brief Completes a pending receive, and releases it. 
+ * The receive must have already been unlinked from its level list. 
+ * After this, the ring can go away at any time.
+ *
+ * @param rcv Pending receive to complete.
+ * @param res Result of the receive.
+ */
+static void aos_tag_ring_complete(tag_ring_rcv_t *rcv, long res) {
+    tag_ring_t *ring = rcv->ring;
+    spin_lock(&(ring->cq_lock));
+    list_del(&(rcv->ring_node));
+    ring->nr_pending--;
+    aos_tag_ring_post_cqe(ring, rcv->user_data, res);
+    spin_unlock(&(ring->cq_lock));
+    kfree(rcv);
+}
+
+/**
+ * @brief Delivers a message to all receives pending on a level of an instance, 
+ * copying it straight into their buffers in the shared areas. 
+ * Called by senders: the caller must be entitled to deliver on the level, as 
+ * for aos_tag_post_locked. 
+ * Receives that come after the pending list has been taken are too late, as 
+ * threads that register after the level epoch flip are.
+ *
+ * @param tag_inst Instance to deliver the message on.
+ * @param lvl Level of the aforementioned instance.
+ * @param msg Message to deliver, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return Number of receives that got the message.
+ */
+int aos_tag_ring_deliver(tag_t *tag_inst, int lvl, tag_msg_t *msg,
+                         size_t size) {
+    tag_ring_rcv_t *rcv, *tmp;
+    LIST_HEAD(rcvs);
+    int delivered = 0;
+    if (list_empty(&((tag_inst->ring_rcvs)[lvl]))) return 0;
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    list_splice_init(&((tag_inst->ring_rcvs)[lvl]), &rcvs);
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    list_for_each_entry_safe(rcv, tmp, &rcvs, lvl_node) {
+        if (size > rcv->size) {
+            // Not enough space in the buffer.
+            aos_tag_ring_complete(rcv, -ENOBUFS);
+            continue;
+        }
+        if (size != 0)
+            memcpy(rcv->ring->area + rcv->off, TAG_MSG_DATA(msg), size);
+        aos_tag_ring_complete(rcv, (long)size);
+        delivered++;
+    }
+    return delivered;
+}
+
+/**
+ * @brief Completes receives pending on a level of an instance with the given 
+ * result, without a message. 
+ * The caller must hold one of the instance's rw_semaphores as reader.
+ *
+ * @param tag_inst Instance to operate on.
+ * @param lvl Level of the aforementioned instance.
+ * @param ring Only cancel receives of this ring, or all of them if NULL.
+ * @param res Result of the canceled receives.
+ */
+void aos_tag_ring_cancel(tag_t *tag_inst, int lvl, tag_ring_t *ring,
+                         long res) {
+    tag_ring_rcv_t *rcv, *tmp;
+    LIST_HEAD(rcvs);
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    list_for_each_entry_safe(rcv, tmp, &((tag_inst->ring_rcvs)[lvl]),
+                             lvl_node)
+        if ((ring == NULL) || (rcv->ring == ring))
+            list_move_tail(&(rcv->lvl_node), &rcvs);
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    list_for_each_entry_safe(rcv, tmp, &rcvs, lvl_node)
+        aos_tag_ring_complete(rcv, res);
+}
+
+/**
+ * @brief Submits a receive: if it can't be completed right away, links it in 
+ * the level list, for a sender to complete it. 
+ * Performs the same checks as tag_receive, and the message buffer must lie in 
+ * the buffer area of the ring. 
+ * Single-consumer levels are not supported, since pending receives would keep 
+ * the level busy for an indefinite time. Filters aren't either, since entries 
+ * have no room for them.
+ *
+ * @param ring Ring the receive comes from.
+ * @param sqe Submission queue entry of the receive.
+ * @return Result of the receive, or __TAG_RING_QUEUED if it's now pending.
+ */
+static long aos_tag_ring_rcv(tag_ring_t *ring, tag_sqe_t *sqe) {
+    tag_ring_rcv_t *rcv;
+    tag_t *tag_inst;
+    unsigned long buf_start, buf_end;
+    int tag = sqe->tag, lvl = sqe->lvl;
+    long ret;
+    // Consistency checks on input arguments.
+    if ((tag < 0) || (tag >= max_tags) || (lvl < 0) || (lvl >= __NR_LEVELS) ||
+        (sqe->flags & ~__TAG_RCV_LAST))
+        return -EINVAL;
+    buf_start = ring->uaddr + ring->hdr->buf_off;
+    buf_end = buf_start + ring->hdr->buf_size;
+    if ((ring->uaddr == 0) || (sqe->addr < buf_start) ||
+        (sqe->size > buf_end - buf_start) ||
+        (sqe->addr > buf_end - sqe->size))
+        return -EFAULT;
+    // First, check if the instance exists and we're allowed to access it.
+    if (TAG_RCV_DOWN_READ(tag) == -EINTR)
+        return -EINTR;
+    tag_inst = tags_list[tag].ptr;
+    if (tag_inst == NULL) {
+        // Instance is not there anymore, or yet.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EIDRM;
+    }
+    if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+        (tag_inst->creator_euid.val != current_euid().val)) {
+        // We're not allowed to receive messages from this instance.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EACCES;
+    }
+    // We're in.
+    if (sqe->flags & __TAG_RCV_LAST) {
+        tag_msg_t *last_msg;
+        // We've just been asked for the cached message, if any.
+        spin_lock(&((tag_inst->msg_locks)[lvl]));
+        last_msg = (tag_inst->last_msgs)[lvl];
+        if (last_msg != NULL) TAG_MSG_GET(last_msg);
+        spin_unlock(&((tag_inst->msg_locks)[lvl]));
+        up_read(&(tags_list[tag].rcv_rwsem));
+        if (last_msg == NULL) return -ENOMSG;
+        ret = (long)TAG_MSG_SIZE(last_msg);
+        if (TAG_MSG_SIZE(last_msg) > sqe->size) ret = -ENOBUFS;
+        else if (ret != 0)
+            memcpy(ring->area + (sqe->addr - ring->uaddr),
+                   TAG_MSG_DATA(last_msg), TAG_MSG_SIZE(last_msg));
+        TAG_MSG_PUT(last_msg);
+        return ret;
+    }
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC) {
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EOPNOTSUPP;
+    }
+    rcv = (tag_ring_rcv_t *)kzalloc(sizeof(tag_ring_rcv_t), GFP_KERNEL);
+    if (unlikely(rcv == NULL)) {
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -ENOMEM;
+    }
+    rcv->ring = ring;
+    rcv->user_data = sqe->user_data;
+    rcv->off = sqe->addr - ring->uaddr;
+    rcv->size = sqe->size;
+    rcv->tag = tag;
+    rcv->lvl = lvl;
+    // Make it known to the ring first, so that it can be found while it's
+    // pending, then to senders.
+    spin_lock(&(ring->cq_lock));
+    list_add_tail(&(rcv->ring_node), &(ring->pending));
+    ring->nr_pending++;
+    spin_unlock(&(ring->cq_lock));
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    list_add_tail(&(rcv->lvl_node), &((tag_inst->ring_rcvs)[lvl]));
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    up_read(&(tags_list[tag].rcv_rwsem));
+    if (TAG_DBG_ON(__TAG_DBG_RING))
+        printk(KERN_DEBUG "%s: tag_ring: Pending receive on tag: %d, level: "
+               "%d.\n", MODNAME, tag, lvl);
+    return __TAG_RING_QUEUED;
+}
+
+/**
+ * @brief Carries out the sends queued on a ring, in submission order, posting 
+ * a completion for each one. 
+ * Each send is performed with the credentials of its submitter, so that 
+ * permissions are checked as the system call would. 
+ * Runs as the ring's work item: the ring is released only after it is done.
+ *
+ * @param work Work item of the ring.
+ */
+static void aos_tag_ring_snd_work(struct work_struct *work) {
+    tag_ring_t *ring = container_of(work, tag_ring_t, snd_work);
+    const struct cred *old_cred;
+    tag_ring_snd_t *snd;
+    long res;
+    for (;;) {
+        spin_lock(&(ring->cq_lock));
+        if (list_empty(&(ring->sends))) {
+            spin_unlock(&(ring->cq_lock));
+            return;
+        }
+        snd = list_first_entry(&(ring->sends), tag_ring_snd_t, node);
+        list_del(&(snd->node));
+        spin_unlock(&(ring->cq_lock));
+        old_cred = override_creds(snd->cred);
+        res = aos_tag_snd_msg(snd->tag, snd->lvl, snd->msg, snd->size);
+        revert_creds(old_cred);
+        put_cred(snd->cred);
+        TAG_MSG_PUT(snd->msg);
+        spin_lock(&(ring->cq_lock));
+        ring->nr_sends--;
+        aos_tag_ring_post_cqe(ring, snd->user_data, res);
+        spin_unlock(&(ring->cq_lock));
+        kfree(snd);
+    }
+}
+
+/**
+ * @brief Submits a send: the message is brought in kernel space right away, 
+ * then the send is queued on the ring's work, so that the submitter doesn't 
+ * wait for receivers to drain the level. 
+ * Sparse levels are not supported here.
+ *
+ * @param ring Ring the send comes from.
+ * @param sqe Submission queue entry of the send.
+ * @return Error code for errno, or __TAG_RING_QUEUED if it's now queued.
+ */
+static long aos_tag_ring_snd(tag_ring_t *ring, tag_sqe_t *sqe) {
+    tag_ring_snd_t *snd;
+    size_t size = (size_t)sqe->size;
+    // Consistency checks on input arguments.
+    if ((sqe->tag < 0) || (sqe->tag >= max_tags) || (sqe->lvl < 0) ||
+        (sqe->lvl >= __NR_LEVELS) || ((size != 0) && (sqe->addr == 0)))
+        return -EINVAL;
+    snd = (tag_ring_snd_t *)kzalloc(sizeof(tag_ring_snd_t), GFP_KERNEL);
+    if (unlikely(snd == NULL)) return -ENOMEM;
+    if (size != 0) {
+        // Bring the message in kernel space, while we're in the submitter's
+        // address space.
+        snd->msg = TAG_MSG_ALLOC(size);
+        if (unlikely(snd->msg == NULL)) {
+            kfree(snd);
+            return -ENOMEM;
+        }
+        if (copy_from_user(TAG_MSG_DATA(snd->msg), (char *)sqe->addr, size)) {
+            TAG_MSG_PUT(snd->msg);
+            kfree(snd);
+            return -EFAULT;
+        }
+    }
+    snd->cred = get_current_cred();
+    snd->size = size;
+    snd->user_data = sqe->user_data;
+    snd->tag = sqe->tag;
+    snd->lvl = sqe->lvl;
+    spin_lock(&(ring->cq_lock));
+    list_add_tail(&(snd->node), &(ring->sends));
+    ring->nr_sends++;
+    spin_unlock(&(ring->cq_lock));
+    queue_work(system_unbound_wq, &(ring->snd_work));
+    if (TAG_DBG_ON(__TAG_DBG_RING))
+        printk(KERN_DEBUG "%s: tag_ring: Queued send on tag: %d, level: %d.\n",
+               MODNAME, snd->tag, snd->lvl);
+    return __TAG_RING_QUEUED;
+}
+
+/**
+ * @brief Executes a submission queue entry. 
+ * Control operations are carried out right away, as the corresponding system 
+ * call would, so their arguments are in the submitter's address space. 
+ * Sends are queued, and receives may stay pending.
+ *
+ * @param ring Ring the entry comes from.
+ * @param sqe Submission queue entry to execute.
+ * @return Result of the operation, or __TAG_RING_QUEUED if it will be 
+ * completed later.
+ */
+static long aos_tag_ring_exec(tag_ring_t *ring, tag_sqe_t *sqe) {
+    switch (sqe->op) {
+    case __TAG_OP_SEND:
+        return aos_tag_ring_snd(ring, sqe);
+    case __TAG_OP_RECEIVE:
+        return aos_tag_ring_rcv(ring, sqe);
+    case __TAG_OP_CTL:
+        return aos_tag_ctl(sqe->tag, sqe->flags, sqe->lvl, sqe->addr);
+    default:
+        return -EINVAL;
+    }
+}
+
+/**
+ * @brief Creates the ring set of a data plane session. 
+ * The shared area is laid out here, and must then be mapped by userspace with 
+ * mmap on the same file. 
+ * The completion queue has twice as many entries as the submission queue.
+ *
+ * @param filp Device file struct of the session.
+ * @param entries Number of submission queue entries, a power of two.
+ * @param buf_size Size of the buffer area, for pending receives.
+ * @return Size of the shared area to map, or an error code for errno.
+ */
+long aos_tag_ring_setup(struct file *filp, unsigned int entries,
+                        size_t buf_size) {
+    tag_ring_t *ring;
+    unsigned long sq_off, cq_off, buf_off;
+    // Consistency checks on input arguments.
+    if ((entries == 0) || (entries > __TAG_RING_MAX_ENTRIES) ||
+        !is_power_of_2(entries) || (buf_size > __TAG_RING_MAX_BUF))
+        return -EINVAL;
+    if (READ_ONCE(filp->private_data) != NULL) return -EBUSY;
+    // Lay out the shared area: queues start on cache lines, buffers on pages.
+    sq_off = ALIGN(sizeof(tag_ring_hdr_t), L1_CACHE_BYTES);
+    cq_off = ALIGN(sq_off + (entries * sizeof(tag_sqe_t)), L1_CACHE_BYTES);
+    buf_off = PAGE_ALIGN(cq_off + (2 * entries * sizeof(tag_cqe_t)));
+    ring = (tag_ring_t *)kzalloc(sizeof(tag_ring_t), GFP_KERNEL);
+    if (unlikely(ring == NULL)) return -ENOMEM;
+    ring->area_size = buf_off + PAGE_ALIGN(buf_size);
+    ring->area = (char *)vmalloc_user(ring->area_size);
+    if (unlikely(ring->area == NULL)) {
+        kfree(ring);
+        return -ENOMEM;
+    }
+    ring->hdr = (tag_ring_hdr_t *)ring->area;
+    ring->sqes = (tag_sqe_t *)(ring->area + sq_off);
+    ring->cqes = (tag_cqe_t *)(ring->area + cq_off);
+    ring->hdr->sq_entries = entries;
+    ring->hdr->cq_entries = 2 * entries;
+    ring->hdr->sq_off = sq_off;
+    ring->hdr->cq_off = cq_off;
+    ring->hdr->buf_off = buf_off;
+    ring->hdr->buf_size = PAGE_ALIGN(buf_size);
+    mutex_init(&(ring->sq_lock));
+    spin_lock_init(&(ring->cq_lock));
+    INIT_LIST_HEAD(&(ring->pending));
+    INIT_LIST_HEAD(&(ring->sends));
+    INIT_WORK(&(ring->snd_work), aos_tag_ring_snd_work);
+    init_waitqueue_head(&(ring->cq_wait));
+    // Another thread might have been faster.
+    if (cmpxchg(&(filp->private_data), NULL, (void *)ring) != NULL) {
+        vfree(ring->area);
+        kfree(ring);
+        return -EBUSY;
+    }
+    if (TAG_DBG_ON(__TAG_DBG_RING))
+        printk(KERN_DEBUG "%s: tag_ring: New ring with %u entries, %lu byte(s) "
+               "shared area.\n", MODNAME, entries, ring->area_size);
+    return (long)(ring->area_size);
+}
+
+/**
+ * @brief Maps the shared area of a ring set in userspace. 
+ * It can be mapped only once, as a whole.
+ *
+ * @param ring Ring set to map.
+ * @param vma Userspace VMA to map the area into.
+ * @return 0, or an error code for errno.
+ */
+int aos_tag_ring_mmap(tag_ring_t *ring, struct vm_area_struct *vma) {
+    int ret;
+    if ((vma->vm_pgoff != 0) ||
+        ((vma->vm_end - vma->vm_start) != ring->area_size))
+        return -EINVAL;
+    if (cmpxchg(&(ring->uaddr), 0UL, vma->vm_start) != 0UL) return -EBUSY;
+    TAG_VM_FLAGS_SET(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    ret = remap_vmalloc_range(vma, ring->area, 0);
+    if (ret) WRITE_ONCE(ring->uaddr, 0UL);
+    return ret;
+}
+
+/**
+ * @brief Consumes entries from the submission queue of a ring set, then waits 
+ * for completions if asked to. 
+ * A completion is posted for each consumed entry, either before this returns 
+ * or, for queued sends, when the ring's work carries them out, and for pending 
+ * receives, when a sender delivers a message or the receive is canceled. 
+ * Entries are consumed only while the completion queue has room for all 
+ * completions that may come.
+ *
+ * @param ring Ring set to operate on.
+ * @param to_submit Maximum number of entries to consume.
+ * @param min_complete Number of available completions to wait for.
+ * @return Number of consumed entries, or an error code for errno.
+ */
+long aos_tag_ring_enter(tag_ring_t *ring, unsigned int to_submit,
+                        unsigned int min_complete) {
+    unsigned int sq_tail, cq_entries = ring->hdr->cq_entries, submitted = 0;
+    tag_sqe_t sqe;
+    long res;
+    if (mutex_lock_interruptible(&(ring->sq_lock)) == -EINTR) return -EINTR;
+    sq_tail = smp_load_acquire(&(ring->hdr->sq_tail));
+    if ((sq_tail - ring->sq_head) > ring->hdr->sq_entries) {
+        // Userspace messed with the indexes.
+        mutex_unlock(&(ring->sq_lock));
+        return -EINVAL;
+    }
+    while ((submitted < to_submit) && (ring->sq_head != sq_tail)) {
+        unsigned int used;
+        spin_lock(&(ring->cq_lock));
+        used = ring->cq_tail - READ_ONCE(ring->hdr->cq_head);
+        used = min(used, cq_entries);
+        if ((used + ring->nr_pending + ring->nr_sends) >= cq_entries) {
+            // No room for another completion.
+            spin_unlock(&(ring->cq_lock));
+            break;
+        }
+        spin_unlock(&(ring->cq_lock));
+        // Work on a copy, since userspace can still write on the entry.
+        sqe = (ring->sqes)[ring->sq_head & (ring->hdr->sq_entries - 1)];
+        ring->sq_head++;
+        smp_store_release(&(ring->hdr->sq_head), ring->sq_head);
+        res = aos_tag_ring_exec(ring, &sqe);
+        if (res != __TAG_RING_QUEUED) {
+            spin_lock(&(ring->cq_lock));
+            aos_tag_ring_post_cqe(ring, sqe.user_data, res);
+            spin_unlock(&(ring->cq_lock));
+        }
+        submitted++;
+    }
+    mutex_unlock(&(ring->sq_lock));
+    if (min_complete == 0) return (long)submitted;
+    min_complete = min(min_complete, cq_entries);
+    if ((wait_event_interruptible(ring->cq_wait,
+            (READ_ONCE(ring->cq_tail) - READ_ONCE(ring->hdr->cq_head)) >=
+            min_complete) == -ERESTARTSYS) && (submitted == 0))
+        return -EINTR;
+    return (long)submitted;
+}
+
+/**
+ * @brief Releases the ring set of a data plane session, when it's closed. 
+ * Queued sends are carried out first, then receives still pending are 
+ * canceled, and the shared area is released only when no sender is completing 
+ * one of them anymore.
+ *
+ * @param ring Ring set to release.
+ */
+void aos_tag_ring_release(tag_ring_t *ring) {
+    tag_ring_rcv_t *rcv;
+    tag_t *tag_inst;
+    int tag, lvl;
+    // No one can submit anymore, so this waits for the last send.
+    flush_work(&(ring->snd_work));
+    for (;;) {
+        spin_lock(&(ring->cq_lock));
+        if (ring->nr_pending == 0) {
+            spin_unlock(&(ring->cq_lock));
+            break;
+        }
+        rcv = list_first_entry(&(ring->pending), tag_ring_rcv_t, ring_node);
+        tag = rcv->tag;
+        lvl = rcv->lvl;
+        spin_unlock(&(ring->cq_lock));
+        // Instances with pending receives can't be removed, so this one is
+        // still there. If a sender already took the receive, it is just a
+        // matter of time.
+        TAG_DOWN_READ(&(tags_list[tag].rcv_rwsem),
+                      TAG_LOCK_INST(tag, __TAG_LOCK_RCV));
+        tag_inst = tags_list[tag].ptr;
+        if (tag_inst != NULL)
+            aos_tag_ring_cancel(tag_inst, lvl, ring, -ECANCELED);
+        up_read(&(tags_list[tag].rcv_rwsem));
+        schedule();
+    }
+    vfree(ring->area);
+    kfree(ring);
+}
@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/rwsem.h>
 #include <linux/wait.h>
@@ -33,25 +34,88 @@
 #include <linux/cred.h>
 #include <linux/errno.h>
 #include <linux/compiler.h>
+#include <linux/eventfd.h>
+#include <linux/version.h>
 
 #include "include/aos-tag.h"
 #include "include/aos-tag_types.h"
 #include "include/aos-tag_syscalls.h"
+#include "include/aos-tag_rings.h"
+#include "include/aos-tag_trace.h"
+#include "include/aos-tag_debug.h"
+#include "include/aos-tag_locks.h"
 
 #include "utils/aos-tag_bitmask.h"
 #include "utils/aos-tag_conditions.h"
+#include "utils/aos-tag_messages.h"
 
 #include "splay-trees_int-keys/splay-trees_int-keys.h"
 
-extern SplayIntTree *shared_bst;
-extern struct rw_semaphore shared_bst_lock;
+extern SplayIntTree *shared_bsts[__TAG_BST_SHARDS];
+extern struct rw_semaphore shared_bst_locks[__TAG_BST_SHARDS];
+extern struct rw_semaphore relay_rwsem;
+extern atomic_t nr_relays;
 
 extern tag_ptr_t *tags_list;
 extern tag_bitmask *tags_mask;
+extern tag_stats_t *tags_stats;
 
 extern unsigned int max_tags;
 extern unsigned int max_msg_sz;
 
+/* eventfd_signal lost its increment argument in 6.8. */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 8, 0)
+#define TAG_EVENTFD_SIGNAL(ctx) eventfd_signal((ctx), 1)
+#else
+#define TAG_EVENTFD_SIGNAL(ctx) eventfd_signal(ctx)
+#endif
+
+/* Buffers of in-kernel callers are copied as they are, with no user access. */
+#define TAG_COPY_TO(dst, src, n, kern) \
+    ((kern) ? (memcpy((dst), (src), (n)), 0UL) : copy_to_user((dst), (src), (n)))
+#define TAG_COPY_FROM(dst, src, n, kern) \
+    ((kern) ? (memcpy((dst), (src), (n)), 0UL) : \
+              copy_from_user((dst), (src), (n)))
+
+/**
+ * @brief Allocates and initializes a new instance structure, which is not 
+ * visible to anyone yet, so no lock is needed here.
+ *
+ * @param key Key of the new instance.
+ * @param perm Enables EUID checks for following operations.
+ * @param topo Topology of the new instance.
+ * @return Address of the new instance structure, or NULL.
+ */
+static tag_t *aos_tag_alloc(int key, int perm, int topo) {
+    tag_t *new_srv;
+    unsigned int i;
+    new_srv = (tag_t *)kzalloc(sizeof(tag_t), GFP_KERNEL);
+    if (unlikely(new_srv == NULL)) return NULL;
+    new_srv->key = key;
+    for (i = 0; i < __NR_LEVELS; i++) {
+        mutex_init(&((new_srv->snd_locks)[i]));
+        init_waitqueue_head(&((new_srv->lvl_queues)[i][0]));
+        init_waitqueue_head(&((new_srv->lvl_queues)[i][1]));
+        TAG_COND_INIT(&((new_srv->lvl_conds)[i]));
+        spin_lock_init(&((new_srv->msg_locks)[i]));
+        INIT_LIST_HEAD(&((new_srv->ring_rcvs)[i]));
+        INIT_LIST_HEAD(&((new_srv->flt_rcvs)[i]));
+        (new_srv->relays)[i] = __TAG_RELAY_NONE;
+        if (topo & __TAG_SP) (new_srv->lvl_flags)[i] |= __TAG_LVL_SP;
+        if (topo & __TAG_SC) (new_srv->lvl_flags)[i] |= __TAG_LVL_SC;
+    }
+    for (i = 0; i < __TAG_TOPIC_BKTS; i++) {
+        INIT_HLIST_HEAD(&((new_srv->topics)[i].head));
+        spin_lock_init(&((new_srv->topics)[i].lock));
+    }
+    new_srv->creator_euid.val = current_euid().val;
+    if (perm == __TAG_USR) new_srv->perm_check = 0x1;
+    else new_srv->perm_check = 0x0;
+    mutex_init(&(new_srv->awake_all_lock));
+    TAG_COND_INIT(&(new_srv->globl_cond));
+    return new_srv;
+}
+
 /**
  * @brief Opens a new instance of the service. 
  * Instances can be shared or not, depending on the value of key. 
@@ -59,57 +123,75 @@ extern unsigned int max_msg_sz;
  * With perm, it is possible to specify whether permission checks should be 
  * performed to limit access to threads executing on behalf of the same user 
  * that created the instance. 
- * Shared instances will be added to the BST, thus everyone could potentially 
- * reopen them (but following operations might check permissions), 
- * instead PRIVATE ones will only be created and added to the static list.
+ * Upon creation, perm can also declare the instance as single-producer and/or 
+ * single-consumer, which applies to each of its levels. 
+ * Shared instances will be added to the BST shard that holds their key, thus 
+ * everyone could potentially reopen them (but following operations might 
+ * check permissions), instead PRIVATE ones will only be created and added to 
+ * the static list. 
+ * New instance structures are allocated before any lock is taken, and simply 
+ * freed if the key turns out to be taken already.
  *
  * @param key Key to assign to the new instance, or to look for in the BST.
  * @param cmd Open a new instance, or look for an existing one.
- * @param perm Enables EUID checks for following operations.
+ * @param perm Enables EUID checks for following operations, and topology.
  * @return Static list index as tag descriptor, or an error code for errno.
  */
-int aos_tag_get(int key, int cmd, int perm) {
-    int tag, full = 0;
+static int aos_tag_do_get(int key, int cmd, int perm) {
+    int tag, full = 0, topo;
     SplayIntNode *search_res;
+    SplayIntTree *bst = NULL;
+    int shard = 0;
     tag_t *new_srv;
-    unsigned int i;
     unsigned long ins_res;
-    #ifdef DEBUG
-    printk(KERN_DEBUG "%s: tag_get: Called with (%d, %d, %d).\n",
-        MODNAME, key, cmd, perm);
-    #endif
+    if (TAG_DBG_ON(__TAG_DBG_GET))
+        printk(KERN_DEBUG "%s: tag_get: Called with (%d, %d, %d).\n",
+            MODNAME, key, cmd, perm);
     // Consistency check on input arguments.
     if ((cmd != __TAG_OPEN) && (cmd != __TAG_CREATE)) return -EINVAL;
+    topo = perm & (__TAG_SP | __TAG_SC);
+    perm &= ~topo;
     if ((perm != __TAG_ALL) && (perm != __TAG_USR)) return -EINVAL;
+    if (key != __TAG_IPC_PRIVATE) {
+        // Only the shard that holds this key is involved.
+        bst = shared_bsts[TAG_BST_SHARD(key)];
+        shard = TAG_BST_SHARD(key);
+    }
     // Normal operation basically follows one of two paths.
     if ((cmd == __TAG_OPEN) && (key != __TAG_IPC_PRIVATE)) {
         // We have been asked to reopen an instance, if it exists.
-        if (down_read_killable(&shared_bst_lock) == -EINTR) return -EINTR;
-        search_res =
-            (SplayIntNode *)splay_int_search(shared_bst, key);
+        if (TAG_BST_DOWN_READ(shard) == -EINTR) return -EINTR;
+        search_res = (SplayIntNode *)splay_int_search(bst, key);
         if (search_res == NULL) {
-            up_read(&shared_bst_lock);
+            up_read(&(shared_bst_locks[shard]));
             return -ENOKEY;
         }
         tag = search_res->_data;
         asm volatile ("lfence" ::: "memory");
-        up_read(&shared_bst_lock);
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_get: Requested key: %d.\n", MODNAME, tag);
-        #endif
+        up_read(&(shared_bst_locks[shard]));
+        if (TAG_DBG_ON(__TAG_DBG_GET))
+            printk(KERN_DEBUG "%s: tag_get: Requested key: %d.\n",
+                   MODNAME, tag);
         return tag;
     }
     if (cmd == __TAG_CREATE) {
         // We have been asked to create a new instance.
+        // Allocate and initialize a new instance struct first, so that no
+        // one waits for us to do so.
+        new_srv = aos_tag_alloc(key, perm, topo);
+        if (unlikely(new_srv == NULL)) return -ENOMEM;
         if (key != __TAG_IPC_PRIVATE) {
             // We have been asked to create a new shared instance.
-            // We gotta lock the BST and look for the key first.
-            if (down_write_killable(&shared_bst_lock) == -EINTR) return -EINTR;
-            search_res =
-                (SplayIntNode *)splay_int_search(shared_bst, key);
+            // We gotta lock the BST shard and look for the key first.
+            if (TAG_BST_DOWN_WRITE_KILLABLE(shard) == -EINTR) {
+                kfree(new_srv);
+                return -EINTR;
+            }
+            search_res = (SplayIntNode *)splay_int_search(bst, key);
             if (search_res != NULL) {
                 // Key already exists: exit.
-                up_write(&shared_bst_lock);
+                TAG_BST_UP_WRITE(shard);
+                kfree(new_srv);
                 return -EALREADY;
             }
             // At this point we must hold the lock until done.
@@ -117,80 +199,69 @@ int aos_tag_get(int key, int cmd, int perm) {
         tag = TAG_NEXT(tags_mask, full);
         if (full) {
             // System is full: we can't add a new instance.
-            if (key != __TAG_IPC_PRIVATE) up_write(&shared_bst_lock);
-            return -ENOMEM;
-        }
-        // Allocate and initialize a new instance struct.
-        new_srv = (tag_t *)kzalloc(sizeof(tag_t), GFP_KERNEL);
-        if (unlikely(new_srv == NULL)) {
-            if (key != __TAG_IPC_PRIVATE) up_write(&shared_bst_lock);
+            if (key != __TAG_IPC_PRIVATE) TAG_BST_UP_WRITE(shard);
+            kfree(new_srv);
             return -ENOMEM;
         }
         // Add the new entry to the BST.
         // We do this now to simplify handling of error conditions (see notes),
         // but make the effect visible later by releasing the BST lock later on.
         if (key != __TAG_IPC_PRIVATE) {
-            ins_res = splay_int_insert(shared_bst, key, tag);
+            ins_res = splay_int_insert(bst, key, tag);
             if (unlikely(ins_res == 0)) {
                 // Insertion failed, probably 'cause we're out of memory.
-                up_write(&shared_bst_lock);
+                TAG_BST_UP_WRITE(shard);
                 kfree(new_srv);
                 TAG_CLR(tags_mask, tag);
                 printk(KERN_ERR "%s: tag_get: Failed to insert new pair "
                                 "(%d, %d).\n", MODNAME, key, tag);
                 return -ENOMEM;
             }
-            #ifdef DEBUG
-            printk(KERN_DEBUG "%s: tag_get: Insert returned: %lu.\n",
-                MODNAME, ins_res);
-            #endif
+            if (TAG_DBG_ON(__TAG_DBG_GET))
+                printk(KERN_DEBUG "%s: tag_get: Insert returned: %lu.\n",
+                    MODNAME, ins_res);
         }
-        new_srv->key = key;
-        for (i = 0; i < __NR_LEVELS; i++) {
-            mutex_init(&((new_srv->snd_locks)[i]));
-            init_waitqueue_head(&((new_srv->lvl_queues)[i][0]));
-            init_waitqueue_head(&((new_srv->lvl_queues)[i][1]));
-            TAG_COND_INIT(&((new_srv->lvl_conds)[i]));
-        }
-        new_srv->creator_euid.val = current_euid().val;
-        if (perm == __TAG_USR) new_srv->perm_check = 0x1;
-        else new_srv->perm_check = 0x0;
-        mutex_init(&(new_srv->awake_all_lock));
-        TAG_COND_INIT(&(new_srv->globl_cond));
         // Add the new instance struct pointer to the static list.
         // Failsafe paths will quickly get us out of here, preserving module's
         // internal state.
-        if (unlikely(down_write_killable(&(tags_list[tag].rcv_rwsem))
-            == -EINTR)) {
+        if (unlikely(TAG_RCV_DOWN_WRITE(tag) == -EINTR)) {
             if (key != __TAG_IPC_PRIVATE) {
-                splay_int_delete(shared_bst, key);
-                up_write(&shared_bst_lock);
+                splay_int_delete(bst, key);
+                TAG_BST_UP_WRITE(shard);
             }
             kfree(new_srv);
             TAG_CLR(tags_mask, tag);
             return -EINTR;
         }
-        if (unlikely(down_write_killable(&(tags_list[tag].snd_rwsem))
-            == -EINTR)) {
-            up_write(&(tags_list[tag].rcv_rwsem));
+        if (unlikely(TAG_SND_DOWN_WRITE(tag) == -EINTR)) {
+            TAG_RCV_UP_WRITE(tag);
             if (key != __TAG_IPC_PRIVATE) {
-                splay_int_delete(shared_bst, key);
-                up_write(&shared_bst_lock);
+                splay_int_delete(bst, key);
+                TAG_BST_UP_WRITE(shard);
             }
             kfree(new_srv);
             TAG_CLR(tags_mask, tag);
             return -EINTR;
         }
+        // Reset the traffic counters of this descriptor, which nobody is
+        // updating now, and let tracepoints know where we are.
+        new_srv->tag = tag;
+        new_srv->stats = &(tags_stats[tag]);
+        memset(&((new_srv->stats)->lvls), 0, sizeof((new_srv->stats)->lvls));
+        memset(&((new_srv->stats)->hists), 0,
+               sizeof((new_srv->stats)->hists));
+        memset(&((new_srv->stats)->locks), 0,
+               sizeof((new_srv->stats)->locks));
+        atomic_long_inc(&((new_srv->stats)->gen));
         tags_list[tag].ptr = new_srv;
         asm volatile ("sfence" ::: "memory");
-        up_write(&(tags_list[tag].snd_rwsem));
-        up_write(&(tags_list[tag].rcv_rwsem));
+        TAG_SND_UP_WRITE(tag);
+        TAG_RCV_UP_WRITE(tag);
         if (key != __TAG_IPC_PRIVATE)
             // Now that all is in place we make the addition visible to all.
-            up_write(&shared_bst_lock);
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_get: New tag: %d.\n", MODNAME, tag);
-        #endif
+            TAG_BST_UP_WRITE(shard);
+        if (TAG_DBG_ON(__TAG_DBG_GET))
+            printk(KERN_DEBUG "%s: tag_get: New tag: %d.\n", MODNAME, tag);
         return tag;
     }
     // If we get here, it means that we've been asked to reopen an IPC_PRIVATE
@@ -199,51 +270,73 @@ int aos_tag_get(int key, int cmd, int perm) {
 }
 
 /**
- * @brief Allows a thread to receive a message from a level of an instance. 
- * The instance should have been previously opened with tag_get, however 
- * presence and permissions checks are always performed. 
- * The userspace buffer provided must be large enough to store the new message.
+ * @brief Opens a new instance of the service, see aos_tag_do_get. 
+ * Traced at entry and exit.
  *
- * @param tag Tag descriptor of the instance to access.
+ * @param key Key to assign to the new instance, or to look for in the BST.
+ * @param cmd Open a new instance, or look for an existing one.
+ * @param perm Enables EUID checks for following operations, and topology.
+ * @return Static list index as tag descriptor, or an error code for errno.
+ */
+int aos_tag_get(int key, int cmd, int perm) {
+    int ret;
+    trace_tag_get_enter(key, cmd, perm);
+    ret = aos_tag_do_get(key, cmd, perm);
+    trace_tag_get_exit(key, ret);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(aos_tag_get);
+
+/**
+ * @brief Registers the calling thread on the current epoch of a level 
+ * condition of an instance, the cheap way if the level has a single consumer. 
+ * In that case the caller must own the level's consumer flag.
+ *
+ * @param tag_inst Instance to operate on.
+ * @param lvl Level of the aforementioned instance.
+ * @return Level condition epoch the thread registered on.
+ */
+static inline unsigned char aos_tag_lvl_reg(tag_t *tag_inst, int lvl) {
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC)
+        return TAG_COND_REG_EXCL(&((tag_inst->lvl_conds)[lvl]));
+    return TAG_COND_REG(&((tag_inst->lvl_conds)[lvl]));
+}
+
+/**
+ * @brief Unregisters the calling thread from a level condition of an 
+ * instance, on which it registered with aos_tag_lvl_reg.
+ *
+ * @param tag_inst Instance to operate on.
+ * @param lvl Level of the aforementioned instance.
+ * @param lvl_epoch Level condition epoch the thread registered on.
+ */
+static inline void aos_tag_lvl_unreg(tag_t *tag_inst, int lvl,
+                                     unsigned char lvl_epoch) {
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC)
+        TAG_COND_UNREG_EXCL(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
+    else TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
+}
+
+/**
+ * @brief Waits for a message on a level of an instance, after the calling 
+ * thread registered on both the level and the global conditions, then copies 
+ * it to user space and unregisters from both conditions. 
+ * The caller must hold the instance's receivers rw_semaphore as reader, and 
+ * must have registered on the level with aos_tag_lvl_reg.
+ *
+ * @param tag_inst Instance to receive from.
  * @param lvl Level of the aforementioned instance to receive from.
+ * @param lvl_epoch Level condition epoch the thread registered on.
+ * @param globl_epoch Global condition epoch the thread registered on.
  * @param buf Userspace buffer in which to copy the new message.
  * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
  * @return Size of the successfully copied message, or an error code for errno.
  */
-int aos_tag_rcv(int tag, int lvl, char *buf, size_t size) {
-    tag_t *tag_inst;
-    unsigned char lvl_epoch, globl_epoch;
+static int aos_tag_consume(tag_t *tag_inst, int lvl, unsigned char lvl_epoch,
+                           unsigned char globl_epoch, char *buf, size_t size,
+                           int kern) {
     int wait_res = 0, ret = 0;
-    #ifdef DEBUG
-    printk(KERN_INFO "%s: tag_receive: Called with (%d, %d, 0x%px, %lu).\n",
-        MODNAME, tag, lvl, buf, size);
-    #endif
-    // Consistency check on input arguments.
-    if ((tag < 0) || (tag >= max_tags) || (lvl < 0) || (lvl >= __NR_LEVELS))
-        return -EINVAL;
-    // First, check if the instance exists and we're allowed to access it.
-    if (down_read_killable(&(tags_list[tag].rcv_rwsem)) == -EINTR)
-        return -EINTR;
-    tag_inst = tags_list[tag].ptr;
-    if (tag_inst == NULL) {
-        // Instance is not there anymore, or yet.
-        up_read(&(tags_list[tag].rcv_rwsem));
-        return -EIDRM;
-    }
-    if ((tag_inst->perm_check) && (current_euid().val != 0) &&
-        (tag_inst->creator_euid.val != current_euid().val)) {
-        // We're not allowed to receive messages from this instance.
-        up_read(&(tags_list[tag].rcv_rwsem));
-        return -EACCES;
-    }
-    // We're in.
-    // Now let's register for the current local and global wait conditions.
-    lvl_epoch = TAG_COND_REG(&((tag_inst->lvl_conds)[lvl]));
-    globl_epoch = TAG_COND_REG(&(tag_inst->globl_cond));
-    #ifdef DEBUG
-    printk(KERN_DEBUG "%s: tag_receive: Local epoch: %d, global epoch: %d.\n",
-           MODNAME, lvl_epoch, globl_epoch);
-    #endif
     // Now we can wait on our level's wait queue, keeping an eye out for both
     // the local and the global conditions, of the respective epochs.
     wait_res =
@@ -254,142 +347,669 @@ int aos_tag_rcv(int tag, int lvl, char *buf, size_t size) {
     // Let's check what happened.
     if (wait_res == -ERESTARTSYS) {
         // We got a signal.
-        TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
+        aos_tag_lvl_unreg(tag_inst, lvl, lvl_epoch);
         TAG_COND_UNREG(&(tag_inst->globl_cond), globl_epoch);
-        up_read(&(tags_list[tag].rcv_rwsem));
         return -EINTR;
     }
     if (TAG_COND_VAL(&(tag_inst->globl_cond), globl_epoch) == 0x1) {
         // We got hit by an AWAKE_ALL.
-        TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
+        aos_tag_lvl_unreg(tag_inst, lvl, lvl_epoch);
         TAG_COND_UNREG(&(tag_inst->globl_cond), globl_epoch);
-        up_read(&(tags_list[tag].rcv_rwsem));
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_receive: Got hit by AWAKE_ALL.\n", MODNAME);
-        #endif
+        if (TAG_DBG_ON(__TAG_DBG_RCV))
+            printk(KERN_DEBUG "%s: tag_receive: Got hit by AWAKE_ALL.\n",
+                   MODNAME);
         return -ECANCELED;
     }
     // If we got here means that there's a message. Let's get to it.
     TAG_COND_UNREG(&(tag_inst->globl_cond), globl_epoch);
     if (tag_inst->msg_sizes[lvl] != 0) {
         unsigned long not_copied = 0;
+        u64 copy_start;
         // Remember that zero-length messages are allowed!
         // Must only check if the provided buffer is large enough.
         if ((buf == NULL) || (size < tag_inst->msg_sizes[lvl])) {
             // Not enough space in the buffer.
-            TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
-            up_read(&(tags_list[tag].rcv_rwsem));
+            aos_tag_lvl_unreg(tag_inst, lvl, lvl_epoch);
             return -ENOBUFS;
         }
-        not_copied = copy_to_user(buf, tag_inst->msg_bufs[lvl],
-                                  tag_inst->msg_sizes[lvl]);
+        copy_start = TAG_CLOCK();
+        not_copied = TAG_COPY_TO(buf, tag_inst->msg_bufs[lvl],
+                                 tag_inst->msg_sizes[lvl], kern);
         asm volatile ("mfence" ::: "memory");
+        TAG_HIST_ADD(tag_inst, lvl, copy, TAG_CLOCK() - copy_start);
         if (not_copied != 0) {
             // copy_to_user failed. Since it shouldn't, this service doesn't
             // retry, so the operation is aborted.
-            TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
-            up_read(&(tags_list[tag].rcv_rwsem));
+            aos_tag_lvl_unreg(tag_inst, lvl, lvl_epoch);
             return -EFAULT;
         }
         ret = (int)(tag_inst->msg_sizes[lvl]);  // Should still fit.
     }
-    TAG_COND_UNREG(&((tag_inst->lvl_conds)[lvl]), lvl_epoch);
-    up_read(&(tags_list[tag].rcv_rwsem));
-    #ifdef DEBUG
-    printk(KERN_DEBUG "%s: tag_receive: Got message from tag: %d, on level "
-           "%d.\n", MODNAME, tag, lvl);
-    #endif
+    // The sender is still waiting for us, so its start time is still there.
+    TAG_HIST_ADD(tag_inst, lvl, wakeup,
+                 TAG_CLOCK() - tag_inst->snd_stamps[lvl]);
+    aos_tag_lvl_unreg(tag_inst, lvl, lvl_epoch);
     return ret;
 }
 
 /**
- * @brief Allows a thread to send a message on a level of an instance. 
+ * @brief Loads the filter prefix of a message as a word, with the bytes that 
+ * are missing from shorter messages read as zero.
+ *
+ * @param msg Message to look at, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return Message prefix.
+ */
+static inline u64 aos_tag_flt_prefix(tag_msg_t *msg, size_t size) {
+    u64 prefix = 0;
+    if (size != 0)
+        memcpy(&prefix, TAG_MSG_DATA(msg), min(size, (size_t)__TAG_FLT_LEN));
+    return prefix;
+}
+
+/**
+ * @brief Prepares a filtered receiver for the calling thread. 
+ * Without a filter, the receiver matches every message.
+ *
+ * @param rcv Filtered receiver to initialize.
+ * @param flt Filter, already in kernel space, or NULL.
+ */
+static inline void aos_tag_flt_init(tag_flt_rcv_t *rcv, tag_filter_t *flt) {
+    rcv->mask = 0;
+    rcv->value = 0;
+    if (flt != NULL) {
+        memcpy(&(rcv->mask), flt->mask, __TAG_FLT_LEN);
+        memcpy(&(rcv->value), flt->value, __TAG_FLT_LEN);
+        rcv->value &= rcv->mask;
+    }
+    rcv->task = current;
+    rcv->msg = NULL;
+    rcv->res = 0;
+}
+
+/**
+ * @brief Puts the calling thread to sleep until its filtered receiver is 
+ * completed, or it gets a signal. 
+ * Senders only wake it up for a message that it wants.
+ *
+ * @param rcv Filtered receiver of the calling thread, already linked.
+ */
+static void aos_tag_flt_sleep(tag_flt_rcv_t *rcv) {
+    for (;;) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (READ_ONCE(rcv->res) != 0) break;
+        if (signal_pending(current)) break;
+        schedule();
+    }
+    __set_current_state(TASK_RUNNING);
+}
+
+/**
+ * @brief Copies the message handed to a filtered receiver to user space, and 
+ * drops the receiver's reference to it. 
+ * The receiver must have already been unlinked.
+ *
+ * @param rcv Filtered receiver of the calling thread.
+ * @param buf Userspace buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
+ * @return Size of the successfully copied message, or an error code for errno.
+ */
+static int aos_tag_flt_copy(tag_flt_rcv_t *rcv, char *buf, size_t size,
+                            int kern) {
+    size_t msg_size;
+    int ret = 0;
+    if (rcv->res == 0) return -EINTR;  // We got a signal.
+    if (rcv->res < 0) return rcv->res;  // We got hit by an AWAKE_ALL.
+    // If we got here means that there's a message, and it's ours.
+    msg_size = (rcv->msg != NULL) ? TAG_MSG_SIZE(rcv->msg) : 0;
+    if (msg_size != 0) {
+        if ((buf == NULL) || (size < msg_size)) ret = -ENOBUFS;
+        else if (TAG_COPY_TO(buf, TAG_MSG_DATA(rcv->msg), msg_size, kern))
+            ret = -EFAULT;
+        else ret = (int)msg_size;
+    }
+    TAG_MSG_PUT(rcv->msg);
+    return ret;
+}
+
+/**
+ * @brief Hands a message to all filtered receivers in a list that match it, 
+ * unlinking them and waking them up. 
+ * Each of them gets its own reference to the message, so there is no need to 
+ * wait for them to copy it: the others are left alone. 
+ * The caller must hold the lock that protects the list.
+ *
+ * @param rcvs List of filtered receivers.
+ * @param msg Message to deliver, or NULL for zero-length ones.
+ * @param prefix Filter prefix of the message.
+ * @return Number of receivers that got the message.
+ */
+static int aos_tag_flt_wake(struct list_head *rcvs, tag_msg_t *msg,
+                            u64 prefix) {
+    tag_flt_rcv_t *rcv, *tmp;
+    int delivered = 0;
+    list_for_each_entry_safe(rcv, tmp, rcvs, node) {
+        if ((prefix & rcv->mask) != rcv->value) continue;
+        list_del(&(rcv->node));
+        if (msg != NULL) TAG_MSG_GET(msg);
+        rcv->msg = msg;
+        WRITE_ONCE(rcv->res, 1);
+        wake_up_process(rcv->task);
+        delivered++;
+    }
+    return delivered;
+}
+
+/**
+ * @brief Cancels all filtered receivers in a list, unlinking them and waking 
+ * them up without a message. 
+ * The caller must hold the lock that protects the list.
+ *
+ * @param rcvs List of filtered receivers.
+ */
+static void aos_tag_flt_cancel_list(struct list_head *rcvs) {
+    tag_flt_rcv_t *rcv, *tmp;
+    list_for_each_entry_safe(rcv, tmp, rcvs, node) {
+        list_del(&(rcv->node));
+        WRITE_ONCE(rcv->res, -ECANCELED);
+        wake_up_process(rcv->task);
+    }
+}
+
+/**
+ * @brief Waits for a message that matches a filter on a level of an instance, 
+ * then copies it to user space. 
+ * Instead of registering on the level condition, the thread links itself in 
+ * the level list of filtered receivers, and sleeps until a sender hands it a 
+ * matching message or an AWAKE_ALL cancels it. 
+ * The caller must hold the instance's receivers rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to receive from.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param flt Filter, already in kernel space.
+ * @param buf Userspace buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
+ * @return Size of the successfully copied message, or an error code for errno.
+ */
+static int aos_tag_consume_filtered(tag_t *tag_inst, int lvl,
+                                    tag_filter_t *flt, char *buf,
+                                    size_t size, int kern) {
+    tag_flt_rcv_t rcv;
+    aos_tag_flt_init(&rcv, flt);
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    list_add_tail(&(rcv.node), &((tag_inst->flt_rcvs)[lvl]));
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    aos_tag_flt_sleep(&rcv);
+    // Whoever completed us did so under the lock, so taking it ensures that
+    // they're done with us. If no one did, we leave on our own.
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    if (rcv.res == 0) list_del(&(rcv.node));
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    return aos_tag_flt_copy(&rcv, buf, size, kern);
+}
+
+/**
+ * @brief Hands a message to all filtered receivers on a level of an instance 
+ * that match it. 
+ * Called by senders: the caller must be entitled to deliver on the level, as 
+ * for aos_tag_post_locked.
+ *
+ * @param tag_inst Instance to deliver the message on.
+ * @param lvl Level of the aforementioned instance.
+ * @param msg Message to deliver, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return Number of receivers that got the message.
+ */
+static int aos_tag_flt_deliver(tag_t *tag_inst, int lvl, tag_msg_t *msg,
+                               size_t size) {
+    u64 prefix;
+    int delivered;
+    if (list_empty(&((tag_inst->flt_rcvs)[lvl]))) return 0;
+    prefix = aos_tag_flt_prefix(msg, size);
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    delivered = aos_tag_flt_wake(&((tag_inst->flt_rcvs)[lvl]), msg, prefix);
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    return delivered;
+}
+
+/**
+ * @brief Cancels all filtered receivers on a level of an instance. 
+ * The caller must hold one of the instance's rw_semaphores as reader.
+ *
+ * @param tag_inst Instance to operate on.
+ * @param lvl Level of the aforementioned instance.
+ */
+static void aos_tag_flt_cancel(tag_t *tag_inst, int lvl) {
+    if (list_empty(&((tag_inst->flt_rcvs)[lvl]))) return;
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    aos_tag_flt_cancel_list(&((tag_inst->flt_rcvs)[lvl]));
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+}
+
+/**
+ * @brief Looks for a sparse level in its bucket of an instance. 
+ * The caller must hold the bucket lock.
+ *
+ * @param bkt Bucket to look into.
+ * @param lvl Sparse level identifier.
+ * @return Address of the sparse level, or NULL if there is none.
+ */
+static tag_topic_t *aos_tag_topic_find(tag_topic_bkt_t *bkt, tag_lvl_t lvl) {
+    tag_topic_t *topic;
+    hlist_for_each_entry(topic, &(bkt->head), node)
+        if (topic->id == lvl) return topic;
+    return NULL;
+}
+
+/**
+ * @brief Waits for a message on a sparse level of an instance, then copies it 
+ * to user space. 
+ * The level is created if no one else is waiting on it, and it's destroyed 
+ * when the last one of its receivers leaves. 
+ * Receivers on sparse levels are filtered receivers, with an optional filter. 
+ * The caller must hold the instance's receivers rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to receive from.
+ * @param lvl Sparse level identifier.
+ * @param flt Filter, already in kernel space, or NULL.
+ * @param buf Userspace buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
+ * @return Size of the successfully copied message, or an error code for errno.
+ */
+static int aos_tag_consume_topic(tag_t *tag_inst, tag_lvl_t lvl,
+                                 tag_filter_t *flt, char *buf, size_t size,
+                                 int kern) {
+    tag_topic_bkt_t *bkt = TAG_TOPIC_BKT(tag_inst, lvl);
+    tag_topic_t *topic, *new_topic;
+    tag_flt_rcv_t rcv;
+    aos_tag_flt_init(&rcv, flt);
+    // Allocate the level in advance, since we can't sleep in the bucket.
+    new_topic = (tag_topic_t *)kzalloc(sizeof(tag_topic_t), GFP_KERNEL);
+    if (unlikely(new_topic == NULL)) return -ENOMEM;
+    spin_lock(&(bkt->lock));
+    topic = aos_tag_topic_find(bkt, lvl);
+    if (topic == NULL) {
+        topic = new_topic;
+        new_topic = NULL;
+        topic->id = lvl;
+        INIT_LIST_HEAD(&(topic->rcvs));
+        hlist_add_head(&(topic->node), &(bkt->head));
+    }
+    list_add_tail(&(rcv.node), &(topic->rcvs));
+    spin_unlock(&(bkt->lock));
+    kfree(new_topic);
+    aos_tag_flt_sleep(&rcv);
+    // If no one completed us, the level is still there since we're in it.
+    // Then, if we were the last one, it's up to us to destroy it.
+    spin_lock(&(bkt->lock));
+    if (rcv.res == 0) {
+        list_del(&(rcv.node));
+        if (list_empty(&(topic->rcvs))) hlist_del(&(topic->node));
+        else topic = NULL;
+    } else topic = NULL;
+    spin_unlock(&(bkt->lock));
+    kfree(topic);
+    return aos_tag_flt_copy(&rcv, buf, size, kern);
+}
+
+/**
+ * @brief Delivers a message on a sparse level of an instance, waking up only 
+ * its matching receivers. 
+ * There are no senders mutexes nor grace periods here, since each receiver 
+ * gets its own reference to the message. The level is destroyed if it is left 
+ * with no receivers. 
+ * The caller must hold the instance's senders rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to deliver the message on.
+ * @param lvl Sparse level identifier.
+ * @param msg Message to send, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return 0 if the message was successully delivered, 1 if no one was there.
+ */
+static int aos_tag_topic_post(tag_t *tag_inst, tag_lvl_t lvl, tag_msg_t *msg,
+                              size_t size) {
+    tag_topic_bkt_t *bkt = TAG_TOPIC_BKT(tag_inst, lvl);
+    tag_topic_t *topic;
+    u64 prefix;
+    int delivered = 0;
+    if (hlist_empty(&(bkt->head))) return 1;
+    prefix = aos_tag_flt_prefix(msg, size);
+    spin_lock(&(bkt->lock));
+    topic = aos_tag_topic_find(bkt, lvl);
+    if (topic != NULL) {
+        delivered = aos_tag_flt_wake(&(topic->rcvs), msg, prefix);
+        if (list_empty(&(topic->rcvs))) hlist_del(&(topic->node));
+        else topic = NULL;
+    }
+    spin_unlock(&(bkt->lock));
+    kfree(topic);
+    return delivered ? 0 : 1;
+}
+
+/**
+ * @brief Cancels all receivers on all sparse levels of an instance, and 
+ * destroys the levels. 
+ * The caller must hold one of the instance's rw_semaphores as reader.
+ *
+ * @param tag_inst Instance to operate on.
+ */
+static void aos_tag_topic_cancel_all(tag_t *tag_inst) {
+    tag_topic_t *topic;
+    struct hlist_node *tmp;
+    unsigned int i;
+    for (i = 0; i < __TAG_TOPIC_BKTS; i++) {
+        tag_topic_bkt_t *bkt = &((tag_inst->topics)[i]);
+        HLIST_HEAD(dead);
+        if (hlist_empty(&(bkt->head))) continue;
+        spin_lock(&(bkt->lock));
+        hlist_for_each_entry_safe(topic, tmp, &(bkt->head), node) {
+            aos_tag_flt_cancel_list(&(topic->rcvs));
+            hlist_del(&(topic->node));
+            hlist_add_head(&(topic->node), &dead);
+        }
+        spin_unlock(&(bkt->lock));
+        hlist_for_each_entry_safe(topic, tmp, &dead, node) kfree(topic);
+    }
+}
+
+/**
+ * @brief Copies the last message posted on a sticky level of an instance to 
+ * user space, without waiting. 
+ * If a filter is given, the message must match it. 
+ * The caller must hold the instance's receivers rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to receive from.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param flt Filter, already in kernel space, or NULL.
+ * @param buf Userspace buffer in which to copy the message.
+ * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
+ * @return Size of the successfully copied message, or an error code for errno.
+ */
+static int aos_tag_consume_last(tag_t *tag_inst, int lvl, tag_filter_t *flt,
+                                char *buf, size_t size, int kern) {
+    tag_msg_t *last_msg;
+    int ret = 0;
+    // Get a reference to the cached message, if any, so that it can't be
+    // released by a sender that replaces it while we're copying it.
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    last_msg = (tag_inst->last_msgs)[lvl];
+    if (last_msg != NULL) TAG_MSG_GET(last_msg);
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    if (last_msg == NULL) return -ENOMSG;
+    if (flt != NULL) {
+        u64 mask, value;
+        memcpy(&mask, flt->mask, __TAG_FLT_LEN);
+        memcpy(&value, flt->value, __TAG_FLT_LEN);
+        if ((aos_tag_flt_prefix(last_msg, TAG_MSG_SIZE(last_msg)) & mask) !=
+            (value & mask)) {
+            // The cached message is not what we're looking for.
+            TAG_MSG_PUT(last_msg);
+            return -ENOMSG;
+        }
+    }
+    if (TAG_MSG_SIZE(last_msg) != 0) {
+        if ((buf == NULL) || (size < TAG_MSG_SIZE(last_msg))) {
+            // Not enough space in the buffer.
+            TAG_MSG_PUT(last_msg);
+            return -ENOBUFS;
+        }
+        if (TAG_COPY_TO(buf, TAG_MSG_DATA(last_msg), TAG_MSG_SIZE(last_msg),
+                        kern)) {
+            TAG_MSG_PUT(last_msg);
+            return -EFAULT;
+        }
+        ret = (int)TAG_MSG_SIZE(last_msg);
+    }
+    TAG_MSG_PUT(last_msg);
+    return ret;
+}
+
+/**
+ * @brief Allows a thread to receive a message from a level of an instance. 
  * The instance should have been previously opened with tag_get, however 
  * presence and permissions checks are always performed. 
- * I/O is packetized: the entire size of the userspace buffer provided will 
- * be copied into kernel space for distribution to readers. The operation will 
- * fail if this is not possible. 
- * Note that zero-length messages are allowed, and the execution path in such 
- * case is simplified.
+ * The userspace buffer provided must be large enough to store the new message. 
+ * Supported flags are: 
+ * - TAG_RCV_LAST: Do not wait, get the last message posted on a sticky level. 
+ * - TAG_RCV_FILTER: Only get a message that matches the given filter. 
+ *                   Senders don't wake the thread up for others. 
+ * Levels tagged with __TAG_SPARSE_BIT are sparse: they don't support 
+ * TAG_RCV_LAST, nor single-producer or single-consumer instances, and their 
+ * receivers are all filtered ones, possibly with an empty filter. 
+ * Buffers can be in kernel space, for in-kernel callers.
  *
  * @param tag Tag descriptor of the instance to access.
- * @param lvl Level of the aforementioned instance to write into.
- * @param buf Userspace buffer holding the message to send.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param buf Userspace buffer in which to copy the new message.
  * @param size Size of the aforementioned buffer.
- * @return 0 if the message was successully sent, 1 if no one was there, or an
- * error code for errno.
+ * @param flags Receive flags.
+ * @param flt Userspace filter, only for TAG_RCV_FILTER.
+ * @param kern Whether the buffer and the filter are in kernel space instead.
+ * @return Size of the successfully copied message, or an error code for errno.
  */
-int aos_tag_snd(int tag, int lvl, char *buf, size_t size) {
+static int aos_tag_do_rcv(int tag, tag_lvl_t lvl, char *buf, size_t size,
+                          int flags, tag_filter_t *flt, int kern) {
     tag_t *tag_inst;
-    char *new_msg;
-    unsigned char lvl_epoch;
-    #ifdef DEBUG
-    printk(KERN_INFO "%s: tag_send: Called with (%d, %d, 0x%px, %lu).\n",
-        MODNAME, tag, lvl, buf, size);
-    #endif
-    // Consistency checks on input arguments.
-    if ((tag < 0) || (tag >= max_tags) || ((size != 0) && (buf == NULL)) ||
-        (lvl < 0) || (lvl >= __NR_LEVELS)) return -EINVAL;
+    tag_filter_t filter;
+    unsigned char lvl_epoch, globl_epoch;
+    int ret;
+    if (TAG_DBG_ON(__TAG_DBG_RCV))
+        printk(KERN_INFO "%s: tag_receive: Called with (%d, %lu, 0x%px, %lu, "
+            "0x%x).\n", MODNAME, tag, lvl, buf, size, flags);
+    // Consistency check on input arguments.
+    if ((tag < 0) || (tag >= max_tags) || (flags & ~__TAG_RCV_FLAGS) ||
+        ((flags & __TAG_RCV_FILTER) && (flt == NULL)) || !TAG_LVL_VALID(lvl) ||
+        (TAG_LVL_SPARSE(lvl) && (flags & __TAG_RCV_LAST)))
+        return -EINVAL;
+    if ((flags & __TAG_RCV_FILTER) &&
+        TAG_COPY_FROM(&filter, flt, sizeof(tag_filter_t), kern))
+        return -EFAULT;
     // First, check if the instance exists and we're allowed to access it.
-    if (down_read_killable(&(tags_list[tag].snd_rwsem)) == -EINTR)
+    if (TAG_RCV_DOWN_READ(tag) == -EINTR)
         return -EINTR;
     tag_inst = tags_list[tag].ptr;
     if (tag_inst == NULL) {
         // Instance is not there anymore, or yet.
-        up_read(&(tags_list[tag].snd_rwsem));
+        up_read(&(tags_list[tag].rcv_rwsem));
         return -EIDRM;
     }
     if ((tag_inst->perm_check) && (current_euid().val != 0) &&
         (tag_inst->creator_euid.val != current_euid().val)) {
-        // We're not allowed to send messages on this instance.
-        up_read(&(tags_list[tag].snd_rwsem));
+        // We're not allowed to receive messages from this instance.
+        up_read(&(tags_list[tag].rcv_rwsem));
         return -EACCES;
     }
     // We're in.
-    if (size != 0) {
-        unsigned long not_copied = 0;
-        // Bring the new message in kernel space.
-        new_msg = (char *)kzalloc(size, GFP_KERNEL);
-        if (unlikely(new_msg == NULL)) {
-            up_read(&(tags_list[tag].snd_rwsem));
-            return -ENOMEM;
+    if (TAG_LVL_SPARSE(lvl)) {
+        // Sparse levels have nothing but filtered receivers, so they can't
+        // tell a single consumer; topologies are the same on all levels.
+        if ((tag_inst->lvl_flags)[0] & (__TAG_LVL_SP | __TAG_LVL_SC)) {
+            up_read(&(tags_list[tag].rcv_rwsem));
+            return -EOPNOTSUPP;
         }
-        not_copied = copy_from_user(new_msg, buf, size);
-        asm volatile ("mfence" ::: "memory");
-        if (not_copied != 0) {
-            // copy_from_user failed. Since it shouldn't, this service doesn't
-            // retry, so the operation is aborted.
-            up_read(&(tags_list[tag].snd_rwsem));
-            kfree(new_msg);
-            return -EFAULT;
+        ret = aos_tag_consume_topic(tag_inst, lvl,
+                                    (flags & __TAG_RCV_FILTER) ? &filter : NULL,
+                                    buf, size, kern);
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return ret;
+    }
+    if (flags & __TAG_RCV_LAST) {
+        // We've just been asked for the cached message, if any.
+        ret = aos_tag_consume_last(tag_inst, lvl,
+                                   (flags & __TAG_RCV_FILTER) ? &filter : NULL,
+                                   buf, size, kern);
+        if (ret < 0) TAG_STAT_INC(tag_inst, lvl, errors);
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return ret;
+    }
+    if (((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC) &&
+        !TAG_EXCL_ENTER(&((tag_inst->rcv_excl)[lvl]))) {
+        // Someone else is receiving on this single-consumer level.
+        TAG_STAT_INC(tag_inst, lvl, errors);
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EBUSY;
+    }
+    if (flags & __TAG_RCV_FILTER) {
+        // We don't need wait conditions, just our filter.
+        ret = aos_tag_consume_filtered(tag_inst, lvl, &filter, buf, size,
+                                       kern);
+    } else {
+        // Now let's register for the current local and global wait conditions.
+        lvl_epoch = aos_tag_lvl_reg(tag_inst, lvl);
+        globl_epoch = TAG_COND_REG(&(tag_inst->globl_cond));
+        if (TAG_DBG_ON(__TAG_DBG_RCV))
+            printk(KERN_DEBUG "%s: tag_receive: Local epoch: %d, global epoch: "
+                   "%d.\n", MODNAME, lvl_epoch, globl_epoch);
+        ret = aos_tag_consume(tag_inst, lvl, lvl_epoch, globl_epoch, buf,
+                              size, kern);
+    }
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC)
+        TAG_EXCL_EXIT(&((tag_inst->rcv_excl)[lvl]));
+    if (ret < 0) TAG_STAT_INC(tag_inst, lvl, errors);
+    up_read(&(tags_list[tag].rcv_rwsem));
+    if (TAG_DBG_ON(__TAG_DBG_RCV) && (ret >= 0))
+        printk(KERN_DEBUG "%s: tag_receive: Got message from tag: %d, on level "
+               "%lu.\n", MODNAME, tag, lvl);
+    return ret;
+}
+
+/**
+ * @brief Allows a thread to receive a message from a level of an instance, 
+ * into a userspace buffer. See aos_tag_do_rcv.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param buf Userspace buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param flags Receive flags.
+ * @param flt Userspace filter, only for TAG_RCV_FILTER.
+ * @return Size of the successfully copied message, or an error code for errno.
+ */
+int aos_tag_rcv(int tag, tag_lvl_t lvl, char *buf, size_t size, int flags,
+                tag_filter_t *flt) {
+    int ret;
+    trace_tag_rcv_enter(tag, lvl, size, flags);
+    ret = aos_tag_do_rcv(tag, lvl, buf, size, flags, flt, 0);
+    trace_tag_rcv_exit(tag, lvl, ret);
+    return ret;
+}
+
+/**
+ * @brief Allows kernel code to receive a message from a level of an instance, 
+ * into a kernel buffer. See aos_tag_do_rcv. 
+ * Must be called from process context, since it may sleep. Permissions are 
+ * checked against the current task's credentials.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param buf Kernel buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param flags Receive flags.
+ * @param flt Kernel filter, only for TAG_RCV_FILTER.
+ * @return Size of the successfully copied message, or an error code.
+ */
+int aos_tag_krcv(int tag, tag_lvl_t lvl, void *buf, size_t size, int flags,
+                 const tag_filter_t *flt) {
+    int ret;
+    trace_tag_rcv_enter(tag, lvl, size, flags);
+    ret = aos_tag_do_rcv(tag, lvl, (char *)buf, size, flags,
+                         (tag_filter_t *)flt, 1);
+    trace_tag_rcv_exit(tag, lvl, ret);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(aos_tag_krcv);
+
+/**
+ * @brief Delivers a message, already in kernel space, on a level of an 
+ * instance. 
+ * The caller must hold the level's senders mutex, or its producer flag if the 
+ * level has a single producer, as well as the instance's senders rw_semaphore 
+ * as reader, and must have already performed presence 
+ * and permissions checks. 
+ * The caller's reference to the message is not dropped here: the message is 
+ * only linked in the instance structure for the duration of the delivery, so 
+ * that the same buffer can be posted multiple times. 
+ * If the level is sticky, the message also replaces the level's cached one, 
+ * whether someone was there to get it or not. 
+ * Receives pending on rings and matching filtered receivers count as someone 
+ * being there. 
+ * The level's eventfd, if any, is signaled in any case, after the message has 
+ * been cached.
+ *
+ * @param tag_inst Instance to deliver the message on.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param msg Message to send, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @param stamp Time at which the delivery started, for latency histograms.
+ * @return 0 if the message was successully delivered, 1 if no one was there, 
+ * or an error code for errno.
+ */
+static int aos_tag_post_locked(tag_t *tag_inst, int lvl, tag_msg_t *msg,
+                               size_t size, u64 stamp) {
+    unsigned char lvl_epoch;
+    u64 drain_start, drain_ns;
+    int delivered;
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_STICKY) {
+        tag_msg_t *last_msg;
+        // Zero-length messages must be cached too, so they need a buffer.
+        if (msg == NULL) last_msg = TAG_MSG_ALLOC(0);
+        else {
+            last_msg = msg;
+            TAG_MSG_GET(last_msg);
         }
+        if (unlikely(last_msg == NULL)) return -ENOMEM;
+        spin_lock(&((tag_inst->msg_locks)[lvl]));
+        swap(last_msg, (tag_inst->last_msgs)[lvl]);
+        spin_unlock(&((tag_inst->msg_locks)[lvl]));
+        TAG_MSG_PUT(last_msg);
     }
-    // Acquire the right to send a message, and mark the start of the delivery.
-    if (mutex_lock_interruptible(&((tag_inst->snd_locks)[lvl])) == -EINTR) {
-        // Message delivery has been aborted with a signal.
-        up_read(&(tags_list[tag].snd_rwsem));
-        if (size != 0) kfree(new_msg);
-        return -EINTR;
+    // Receives pending on rings and filtered receivers get the message
+    // straight away, with no need to wait for them.
+    delivered = aos_tag_ring_deliver(tag_inst, lvl, msg, size);
+    delivered += aos_tag_flt_deliver(tag_inst, lvl, msg, size);
+    // Notify whoever watches this level, if anyone does.
+    if (READ_ONCE((tag_inst->lvl_evfds)[lvl]) != NULL) {
+        spin_lock(&((tag_inst->msg_locks)[lvl]));
+        if ((tag_inst->lvl_evfds)[lvl] != NULL)
+            TAG_EVENTFD_SIGNAL((tag_inst->lvl_evfds)[lvl]);
+        spin_unlock(&((tag_inst->msg_locks)[lvl]));
     }
     lvl_epoch = TAG_COND_FLIP(&((tag_inst->lvl_conds)[lvl]));
+    // A single consumer registers without the condition spinlock: this pairs
+    // with the barrier in TAG_COND_REG_EXCL.
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SC)
+        asm volatile ("mfence" ::: "memory");
+    trace_tag_flip(tag_inst->tag, lvl, lvl_epoch, size,
+                   TAG_COND_COUNT(&((tag_inst->lvl_conds)[lvl]), lvl_epoch));
     if (!TAG_COND_COUNT(&((tag_inst->lvl_conds)[lvl]), lvl_epoch)) {
-        // No one is waiting for this message: discard it.
-        mutex_unlock(&((tag_inst->snd_locks)[lvl]));
-        up_read(&(tags_list[tag].snd_rwsem));
-        if (size != 0) kfree(new_msg);
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_send: Discarded message on tag: %d, "
-                          "level: %d.\n", MODNAME, tag, lvl);
-        #endif
-        return 1;
+        // No one is waiting for this message: discard it, unless someone
+        // already got it from the lists.
+        if (!delivered) {
+            TAG_STAT_INC(tag_inst, lvl, discards);
+            return 1;
+        }
+        TAG_STAT_INC(tag_inst, lvl, deliveries);
+        TAG_STAT_ADD(tag_inst, lvl, wakeups, delivered);
+        return 0;
     }
+    TAG_STAT_INC(tag_inst, lvl, deliveries);
+    TAG_STAT_ADD(tag_inst, lvl, wakeups, delivered +
+                 TAG_COND_COUNT(&((tag_inst->lvl_conds)[lvl]), lvl_epoch));
     // Now we actually have someone to deliver to.
-    if (size != 0) tag_inst->msg_bufs[lvl] = new_msg;
+    if (size != 0) tag_inst->msg_bufs[lvl] = TAG_MSG_DATA(msg);
     tag_inst->msg_sizes[lvl] = size;
+    tag_inst->snd_stamps[lvl] = stamp;
     asm volatile ("sfence" ::: "memory");
+    drain_start = TAG_CLOCK();
     TAG_COND_VAL(&((tag_inst->lvl_conds)[lvl]), lvl_epoch) = 0x1;
     // Wake up the current epoch's wait queue.
     wake_up_all(&((tag_inst->lvl_queues)[lvl][lvl_epoch]));
+    trace_tag_wakeup(tag_inst->tag, lvl, lvl_epoch, size,
+                     TAG_COND_COUNT(&((tag_inst->lvl_conds)[lvl]), lvl_epoch));
     // Wait for receivers to consume both the message and the condition.
     // Since busy-wait loops are bad in the kernel let the scheduler run
     // some other task on this CPU in the meantime.
@@ -399,47 +1019,744 @@ int aos_tag_snd(int tag, int lvl, char *buf, size_t size) {
         // gracefully or not, so this thread will never become an
         // unkillable idle process *knocks on wood*.
         schedule();
+    drain_ns = TAG_CLOCK() - drain_start;
+    TAG_HIST_ADD(tag_inst, lvl, drain, drain_ns);
+    trace_tag_drain(tag_inst->tag, lvl, lvl_epoch, size,
+                    (unsigned long)drain_ns);
     // All done!
     if (size != 0) tag_inst->msg_bufs[lvl] = NULL;
     tag_inst->msg_sizes[lvl] = 0;
     asm volatile ("sfence" ::: "memory");
-    mutex_unlock(&((tag_inst->snd_locks)[lvl]));
-    up_read(&(tags_list[tag].snd_rwsem));
-    if (size != 0) kfree(new_msg);
-    #ifdef DEBUG
-    printk(KERN_DEBUG "%s: tag_send: Delivered %lu byte(s) message on tag: %d,"
-                      " level: %d.\n", MODNAME, size, tag, lvl);
-    #endif
     return 0;
 }
 
+
 /**
- * @brief Once the tag descriptor has been retrieved via tag_get, 
- * allows to control an instance. 
- * Supported commands are: 
+ * @brief Releases the senders mutex of a level of an instance. 
+ * On conflating levels, the sender of the pending message, if any, waits for 
+ * the mutex to deliver it by itself, so it is woken up here. 
+ * The caller must hold the instance's senders rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to operate on.
+ * @param lvl Level of the aforementioned instance.
+ */
+static void aos_tag_snd_unlock(tag_t *tag_inst, int lvl) {
+    TAG_SNDL_UNLOCK(tag_inst, lvl);
+    // Pairs with the wait in aos_tag_post: either we see the message, or its
+    // sender sees the mutex free.
+    asm volatile ("mfence" ::: "memory");
+    if (READ_ONCE((tag_inst->next_msgs)[lvl]) != NULL)
+        wake_up_var(&((tag_inst->next_msgs)[lvl]));
+}
+
+/**
+ * @brief Delivers a message, already in kernel space, on a level of an 
+ * instance. 
+ * The caller must hold the instance's senders rw_semaphore as reader, and must 
+ * have already performed presence and permissions checks. 
+ * The caller's reference to the message is not dropped here. 
+ * On conflating levels, if another delivery is in progress the message is left 
+ * pending, replacing any other one, and its sender waits for the mutex only 
+ * as long as no newer message replaces it, returning as soon as one does: 
+ * this way, receivers that come next always get the latest message, senders 
+ * wait for at most one delivery, and no one delivers for others. 
+ * The level modes are sampled without the mutex, so a sender that races with 
+ * a mode change may still behave according to the previous one. 
+ * On single-producer levels the mutex is not used at all: the sender only 
+ * marks the level's producer flag, and fails if it is already marked. 
+ * Conflation is pointless there, and is ignored.
+ *
+ * @param tag_inst Instance to deliver the message on.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param msg Message to send, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return 0 if the message was successully delivered, 1 if no one was there, 
+ * 2 if it was superseded by a newer one, or an error code for errno.
+ */
+static int aos_tag_post(tag_t *tag_inst, int lvl, tag_msg_t *msg,
+                        size_t size) {
+    u64 stamp = TAG_CLOCK();
+    tag_msg_t *next_msg, *own_msg;
+    int ret;
+    TAG_STAT_INC(tag_inst, lvl, sends);
+    TAG_STAT_ADD(tag_inst, lvl, bytes, size);
+    if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SP) {
+        if (!TAG_EXCL_ENTER(&((tag_inst->snd_excl)[lvl])))
+            // Someone else is sending on this single-producer level.
+            return -EBUSY;
+        ret = aos_tag_post_locked(tag_inst, lvl, msg, size, stamp);
+        TAG_EXCL_EXIT(&((tag_inst->snd_excl)[lvl]));
+        return ret;
+    }
+    if (!(READ_ONCE((tag_inst->lvl_flags)[lvl]) & __TAG_LVL_CONFLATE)) {
+        // Acquire the right to send a message, and deliver it.
+        if (TAG_SNDL_LOCK(tag_inst, lvl) == -EINTR)
+            // Message delivery has been aborted with a signal.
+            return -EINTR;
+        ret = aos_tag_post_locked(tag_inst, lvl, msg, size, stamp);
+        aos_tag_snd_unlock(tag_inst, lvl);
+        return ret;
+    }
+    // Zero-length messages must be left pending too, so they need a buffer.
+    if (msg == NULL) own_msg = TAG_MSG_ALLOC(0);
+    else {
+        own_msg = msg;
+        TAG_MSG_GET(own_msg);
+    }
+    if (unlikely(own_msg == NULL)) return -ENOMEM;
+    // Make this the next message to deliver, superseding the pending one.
+    // Our own reference keeps its address from being reused while we wait.
+    next_msg = own_msg;
+    TAG_MSG_GET(next_msg);
+    spin_lock(&((tag_inst->msg_locks)[lvl]));
+    swap(next_msg, (tag_inst->next_msgs)[lvl]);
+    spin_unlock(&((tag_inst->msg_locks)[lvl]));
+    if (next_msg != NULL) {
+        // Let its sender go.
+        TAG_MSG_PUT(next_msg);
+        wake_up_var(&((tag_inst->next_msgs)[lvl]));
+    }
+    for (;;) {
+        // Pairs with the one in aos_tag_snd_unlock.
+        asm volatile ("mfence" ::: "memory");
+        if (READ_ONCE((tag_inst->next_msgs)[lvl]) != own_msg) {
+            // Superseded by a newer message.
+            ret = 2;
+            break;
+        }
+        if (TAG_SNDL_TRYLOCK(tag_inst, lvl)) {
+            // Take our message back, unless a newer one superseded it in the
+            // meantime: its sender is waiting for the mutex to deliver it, and
+            // will be let go as we release it.
+            spin_lock(&((tag_inst->msg_locks)[lvl]));
+            next_msg = (tag_inst->next_msgs)[lvl];
+            if (next_msg == own_msg) (tag_inst->next_msgs)[lvl] = NULL;
+            spin_unlock(&((tag_inst->msg_locks)[lvl]));
+            ret = 2;
+            if (next_msg == own_msg) {
+                ret = aos_tag_post_locked(tag_inst, lvl, own_msg,
+                                          TAG_MSG_SIZE(own_msg), stamp);
+                // Drop the reference that was pending.
+                TAG_MSG_PUT(own_msg);
+            }
+            aos_tag_snd_unlock(tag_inst, lvl);
+            break;
+        }
+        // A delivery is in progress: wait for it, unless we're superseded.
+        if (wait_var_event_killable(&((tag_inst->next_msgs)[lvl]),
+                (READ_ONCE((tag_inst->next_msgs)[lvl]) != own_msg) ||
+                !mutex_is_locked(&((tag_inst->snd_locks)[lvl])))) {
+            // Withdraw our message, if it's still pending.
+            next_msg = NULL;
+            spin_lock(&((tag_inst->msg_locks)[lvl]));
+            if ((tag_inst->next_msgs)[lvl] == own_msg)
+                swap(next_msg, (tag_inst->next_msgs)[lvl]);
+            spin_unlock(&((tag_inst->msg_locks)[lvl]));
+            TAG_MSG_PUT(next_msg);
+            ret = -EINTR;
+            break;
+        }
+    }
+    TAG_MSG_PUT(own_msg);
+    return ret;
+}
+
+/**
+ * @brief Evaluates to the number of instances created on the tag descriptor of 
+ * a relay destination, which pins down the destination instance.
+ *
+ * @param dst Relay destination.
+ * @return Instances created on its tag descriptor so far.
+ */
+#define TAG_RELAY_GEN(dst) \
+    atomic_long_read(&(tags_stats[TAG_RELAY_TAG(dst)].gen))
+
+/**
+ * @brief Relays a message, already posted on a level of an instance, along 
+ * the chain of relay rules that starts there, reusing the same buffer. 
+ * Each hop is a delivery as the one of tag_send, and the chain is followed for 
+ * at most __TAG_RELAY_HOPS hops. Permissions were checked when the rules were 
+ * set. 
+ * Instances are never locked together: each rule is read, along with the 
+ * creation count of its destination descriptor, while holding the instance 
+ * that has it, and the destination is only taken after that one has been 
+ * released. A rule can't be dropped while its instance is held, and a tag 
+ * descriptor can't be reused before all rules towards it are dropped, so a 
+ * matching count means that the destination is still the same instance. 
+ * The caller must not hold any instance, and must keep a reference to the 
+ * message.
+ *
+ * @param dst First relay destination, read from the source level.
+ * @param gen Creation count of the aforementioned destination descriptor.
+ * @param msg Message to relay, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return Number of hops on which the message was delivered.
+ */
+static int aos_tag_relay(unsigned long dst, long gen, tag_msg_t *msg,
+                         size_t size) {
+    tag_t *tag_inst;
+    unsigned int hops;
+    int tag, lvl, delivered = 0;
+    for (hops = 0; (hops < __TAG_RELAY_HOPS) && (dst != __TAG_RELAY_NONE);
+         hops++) {
+        tag = TAG_RELAY_TAG(dst);
+        lvl = TAG_RELAY_LVL(dst);
+        if (TAG_SND_DOWN_READ(tag) == -EINTR) break;
+        tag_inst = tags_list[tag].ptr;
+        if ((tag_inst == NULL) || (TAG_RELAY_GEN(dst) != gen)) {
+            // The destination is gone, and its descriptor may be reused.
+            up_read(&(tags_list[tag].snd_rwsem));
+            break;
+        }
+        if (aos_tag_post(tag_inst, lvl, msg, size) == 0) delivered++;
+        dst = READ_ONCE((tag_inst->relays)[lvl]);
+        if (dst != __TAG_RELAY_NONE) gen = TAG_RELAY_GEN(dst);
+        up_read(&(tags_list[tag].snd_rwsem));
+    }
+    return delivered;
+}
+
+/**
+ * @brief Checks that a new relay rule would not close a loop, following the 
+ * chain of rules from its destination. 
+ * Instances found along the way can't be removed, since the caller must hold 
+ * the relays rw_semaphore as writer.
+ *
+ * @param tag Tag descriptor of the source instance.
+ * @param lvl Level of the aforementioned instance.
+ * @param dst Relay destination.
+ * @return 0 if the rule can be set, or an error code for errno.
+ */
+static int aos_tag_relay_check(int tag, int lvl, unsigned long dst) {
+    tag_t *dst_inst;
+    unsigned int hops;
+    for (hops = 0; hops < __TAG_RELAY_HOPS; hops++) {
+        if ((TAG_RELAY_TAG(dst) == tag) && (TAG_RELAY_LVL(dst) == lvl))
+            return -ELOOP;
+        dst_inst = READ_ONCE(tags_list[TAG_RELAY_TAG(dst)].ptr);
+        if (dst_inst == NULL) return -EIDRM;
+        if ((hops == 0) && (dst_inst->perm_check) &&
+            (current_euid().val != 0) &&
+            (dst_inst->creator_euid.val != current_euid().val))
+            // We're not allowed to send messages on the destination.
+            return -EACCES;
+        dst = READ_ONCE((dst_inst->relays)[TAG_RELAY_LVL(dst)]);
+        if (dst == __TAG_RELAY_NONE) return 0;
+    }
+    // The chain would be too long anyway.
+    return -ELOOP;
+}
+
+/**
+ * @brief Drops all relay rules that point to an instance being removed. 
+ * Each instance that has some is locked out for senders while they're 
+ * cleared, so that no one can still be relaying to the tag descriptor once it 
+ * is reused. Other removers may run at the same time, so each instance is 
+ * looked at while holding its senders rw_semaphore. 
+ * The caller must hold the relays rw_semaphore as reader, and must have 
+ * already disconnected the instance.
+ *
+ * @param tag Tag descriptor of the instance being removed.
+ */
+static void aos_tag_relay_unlink(int tag) {
+    tag_t *tag_inst;
+    unsigned long dst;
+    unsigned int i, j;
+    for (i = 0; i < max_tags; i++) {
+        if (READ_ONCE(tags_list[i].ptr) == NULL) continue;
+        TAG_DOWN_READ(&(tags_list[i].snd_rwsem),
+                      TAG_LOCK_INST(i, __TAG_LOCK_SND));
+        tag_inst = tags_list[i].ptr;
+        for (j = 0; (tag_inst != NULL) && (j < __NR_LEVELS); j++) {
+            dst = READ_ONCE((tag_inst->relays)[j]);
+            if ((dst != __TAG_RELAY_NONE) && (TAG_RELAY_TAG(dst) == tag))
+                break;
+        }
+        up_read(&(tags_list[i].snd_rwsem));
+        if ((tag_inst == NULL) || (j == __NR_LEVELS)) continue;
+        TAG_DOWN_WRITE(&(tags_list[i].snd_rwsem),
+                       TAG_LOCK_INST(i, __TAG_LOCK_SND),
+                       &(tags_list[i].snd_stamp));
+        tag_inst = tags_list[i].ptr;
+        for (j = 0; (tag_inst != NULL) && (j < __NR_LEVELS); j++) {
+            dst = (tag_inst->relays)[j];
+            if ((dst != __TAG_RELAY_NONE) && (TAG_RELAY_TAG(dst) == tag)) {
+                WRITE_ONCE((tag_inst->relays)[j], __TAG_RELAY_NONE);
+                atomic_dec(&nr_relays);
+            }
+        }
+        TAG_SND_UP_WRITE(i);
+    }
+}
+
+/**
+ * @brief Sends a message, already in kernel space, on a level of an instance. 
+ * Presence and permissions checks are performed here, against the current 
+ * task's credentials. 
+ * Levels tagged with __TAG_SPARSE_BIT are sparse: messages only reach the 
+ * receivers currently waiting on them, with no ordering among concurrent 
+ * senders, so they aren't supported on single-producer or single-consumer 
+ * instances. 
+ * Messages on dense levels are also relayed, if the level has a relay rule. 
+ * The caller's reference to the message is not dropped here.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param msg Message to send, or NULL for zero-length ones.
+ * @param size Size of the aforementioned message.
+ * @return 0 if the message was successully sent, 1 if no one was there, 2 if 
+ * it was superseded by a newer one on a conflating level, or an error code 
+ * for errno.
+ */
+int aos_tag_snd_msg(int tag, tag_lvl_t lvl, tag_msg_t *msg, size_t size) {
+    tag_t *tag_inst;
+    unsigned long dst = __TAG_RELAY_NONE;
+    long gen = 0;
+    int ret;
+    if ((tag < 0) || (tag >= max_tags) || !TAG_LVL_VALID(lvl)) return -EINVAL;
+    // First, check if the instance exists and we're allowed to access it.
+    if (TAG_SND_DOWN_READ(tag) == -EINTR)
+        return -EINTR;
+    tag_inst = tags_list[tag].ptr;
+    if (tag_inst == NULL) {
+        // Instance is not there anymore, or yet.
+        up_read(&(tags_list[tag].snd_rwsem));
+        return -EIDRM;
+    }
+    if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+        (tag_inst->creator_euid.val != current_euid().val)) {
+        // We're not allowed to send messages on this instance.
+        up_read(&(tags_list[tag].snd_rwsem));
+        return -EACCES;
+    }
+    // We're in.
+    if (lvl < __NR_LEVELS) {
+        ret = aos_tag_post(tag_inst, lvl, msg, size);
+        // Relay rules are followed only after the instance is released.
+        if (ret >= 0) dst = READ_ONCE((tag_inst->relays)[lvl]);
+        if (dst != __TAG_RELAY_NONE) gen = TAG_RELAY_GEN(dst);
+    } else if ((tag_inst->lvl_flags)[0] & (__TAG_LVL_SP | __TAG_LVL_SC)) {
+        // Topologies are the same on all levels, and can't hold here.
+        ret = -EOPNOTSUPP;
+    } else ret = aos_tag_topic_post(tag_inst, lvl, msg, size);
+    up_read(&(tags_list[tag].snd_rwsem));
+    // Deliveries on relay destinations count as someone being there.
+    if ((dst != __TAG_RELAY_NONE) && aos_tag_relay(dst, gen, msg, size) &&
+        (ret == 1)) ret = 0;
+    return ret;
+}
+
+/**
+ * @brief Allows a thread to send a message on a level of an instance. 
+ * The instance should have been previously opened with tag_get, however 
+ * presence and permissions checks are always performed. 
+ * I/O is packetized: the entire size of the userspace buffer provided will 
+ * be copied into kernel space for distribution to readers, before the instance 
+ * is accessed. The operation will fail if this is not possible. 
+ * Note that zero-length messages are allowed, and the execution path in such 
+ * case is simplified. 
+ * Delivery is then carried out by aos_tag_snd_msg. 
+ * Buffers can be in kernel space, for in-kernel callers.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param buf Userspace buffer holding the message to send.
+ * @param size Size of the aforementioned buffer.
+ * @param kern Whether the buffer is in kernel space instead.
+ * @return 0 if the message was successully sent, 1 if no one was there, 2 if 
+ * it was superseded by a newer one on a conflating level, or an error code 
+ * for errno.
+ */
+static int aos_tag_do_snd(int tag, tag_lvl_t lvl, char *buf, size_t size,
+                          int kern) {
+    tag_msg_t *new_msg = NULL;
+    int ret;
+    if (TAG_DBG_ON(__TAG_DBG_SND))
+        printk(KERN_INFO "%s: tag_send: Called with (%d, %lu, 0x%px, %lu).\n",
+            MODNAME, tag, lvl, buf, size);
+    // Consistency checks on input arguments.
+    if ((tag < 0) || (tag >= max_tags) || ((size != 0) && (buf == NULL)))
+        return -EINVAL;
+    if (size != 0) {
+        unsigned long not_copied = 0;
+        // Bring the new message in kernel space.
+        new_msg = TAG_MSG_ALLOC(size);
+        if (unlikely(new_msg == NULL)) return -ENOMEM;
+        not_copied = TAG_COPY_FROM(TAG_MSG_DATA(new_msg), buf, size, kern);
+        asm volatile ("mfence" ::: "memory");
+        if (not_copied != 0) {
+            // copy_from_user failed. Since it shouldn't, this service doesn't
+            // retry, so the operation is aborted.
+            TAG_MSG_PUT(new_msg);
+            return -EFAULT;
+        }
+    }
+    ret = aos_tag_snd_msg(tag, lvl, new_msg, size);
+    TAG_MSG_PUT(new_msg);
+    if (TAG_DBG_ON(__TAG_DBG_SND)) {
+        if (ret == 1)
+            printk(KERN_DEBUG "%s: tag_send: Discarded message on tag: %d, "
+                              "level: %lu.\n", MODNAME, tag, lvl);
+        else if (ret == 0)
+            printk(KERN_DEBUG "%s: tag_send: Delivered %lu byte(s) message on "
+                              "tag: %d, level: %lu.\n",
+                   MODNAME, size, tag, lvl);
+        else if (ret == 2)
+            printk(KERN_DEBUG "%s: tag_send: Superseded message on tag: %d, "
+                              "level: %lu.\n", MODNAME, tag, lvl);
+    }
+    return ret;
+}
+
+/**
+ * @brief Allows a thread to send a message on a level of an instance, from a 
+ * userspace buffer. See aos_tag_do_snd.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param buf Userspace buffer holding the message to send.
+ * @param size Size of the aforementioned buffer.
+ * @return 0 if the message was successully sent, 1 if no one was there, 2 if 
+ * it was superseded by a newer one on a conflating level, or an error code 
+ * for errno.
+ */
+int aos_tag_snd(int tag, tag_lvl_t lvl, char *buf, size_t size) {
+    int ret;
+    trace_tag_snd_enter(tag, lvl, size, 0);
+    ret = aos_tag_do_snd(tag, lvl, buf, size, 0);
+    trace_tag_snd_exit(tag, lvl, ret);
+    return ret;
+}
+
+/**
+ * @brief Allows kernel code to send a message on a level of an instance, from 
+ * a kernel buffer. See aos_tag_do_snd. 
+ * Must be called from process context, since it may sleep. Permissions are 
+ * checked against the current task's credentials.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to write into.
+ * @param buf Kernel buffer holding the message to send.
+ * @param size Size of the aforementioned buffer.
+ * @return 0 if the message was successully sent, 1 if no one was there, 2 if 
+ * it was superseded by a newer one on a conflating level, or an error code.
+ */
+int aos_tag_ksnd(int tag, tag_lvl_t lvl, const void *buf, size_t size) {
+    int ret;
+    trace_tag_snd_enter(tag, lvl, size, 0);
+    ret = aos_tag_do_snd(tag, lvl, (char *)buf, size, 1);
+    trace_tag_snd_exit(tag, lvl, ret);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(aos_tag_ksnd);
+
+/**
+ * @brief Allows a thread to send the same message on multiple levels, possibly 
+ * of different instances, with a single call. 
+ * The message is copied into kernel space only once, and the same kernel 
+ * buffer is then posted on each target in the order in which they are given. 
+ * Each target is handled exactly like a tag_send would, and its outcome is 
+ * stored in its result field: 0 if the message was delivered, 1 if no one was 
+ * there, or a negative error code. 
+ * If the calling thread gets a signal, targets that have not been served yet 
+ * are marked with -EINTR.
+ *
+ * @param targets Userspace array of targets, results are written back in it.
+ * @param nr_targets Number of entries in the aforementioned array, at most 
+ *                   __TAG_MULTI_MAX.
+ * @param buf Userspace buffer holding the message to send.
+ * @param size Size of the aforementioned buffer.
+ * @return Number of targets on which the message was delivered, or an error 
+ * code for errno.
+ */
+int aos_tag_snd_multi(tag_target_t *targets, unsigned int nr_targets,
+                      char *buf, size_t size) {
+    tag_target_t *tgts;
+    tag_t *tag_inst;
+    tag_msg_t *new_msg = NULL;
+    unsigned long dst;
+    unsigned int i;
+    long gen = 0;
+    int delivered = 0;
+    if (TAG_DBG_ON(__TAG_DBG_SND))
+        printk(KERN_INFO "%s: tag_send_multi: Called with (0x%px, %u, 0x%px, "
+               "%lu).\n", MODNAME, targets, nr_targets, buf, size);
+    // Consistency checks on input arguments.
+    if ((targets == NULL) || (nr_targets == 0) ||
+        (nr_targets > __TAG_MULTI_MAX) ||
+        ((size != 0) && (buf == NULL))) return -EINVAL;
+    // Bring the targets list and the message in kernel space, once.
+    tgts = (tag_target_t *)kvmalloc_array(nr_targets, sizeof(tag_target_t),
+                                          GFP_KERNEL);
+    if (unlikely(tgts == NULL)) return -ENOMEM;
+    if (copy_from_user(tgts, targets, nr_targets * sizeof(tag_target_t))) {
+        kvfree(tgts);
+        return -EFAULT;
+    }
+    if (size != 0) {
+        new_msg = TAG_MSG_ALLOC(size);
+        if (unlikely(new_msg == NULL)) {
+            kvfree(tgts);
+            return -ENOMEM;
+        }
+        if (copy_from_user(TAG_MSG_DATA(new_msg), buf, size)) {
+            // copy_from_user failed. Since it shouldn't, this service doesn't
+            // retry, so the operation is aborted.
+            TAG_MSG_PUT(new_msg);
+            kvfree(tgts);
+            return -EFAULT;
+        }
+        asm volatile ("mfence" ::: "memory");
+    }
+    // Post the same buffer on each target, with the same checks as tag_send.
+    for (i = 0; i < nr_targets; i++) {
+        int tag = tgts[i].tag, lvl = tgts[i].lvl;
+        if ((tag < 0) || (tag >= max_tags) || (lvl < 0) ||
+            (lvl >= __NR_LEVELS)) {
+            tgts[i].res = -EINVAL;
+            continue;
+        }
+        if (TAG_SND_DOWN_READ(tag) == -EINTR) {
+            tgts[i].res = -EINTR;
+            break;
+        }
+        tag_inst = tags_list[tag].ptr;
+        if (tag_inst == NULL) {
+            up_read(&(tags_list[tag].snd_rwsem));
+            tgts[i].res = -EIDRM;
+            continue;
+        }
+        if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+            (tag_inst->creator_euid.val != current_euid().val)) {
+            up_read(&(tags_list[tag].snd_rwsem));
+            tgts[i].res = -EACCES;
+            continue;
+        }
+        tgts[i].res = aos_tag_post(tag_inst, lvl, new_msg, size);
+        dst = __TAG_RELAY_NONE;
+        if (tgts[i].res >= 0) dst = READ_ONCE((tag_inst->relays)[lvl]);
+        if (dst != __TAG_RELAY_NONE) gen = TAG_RELAY_GEN(dst);
+        up_read(&(tags_list[tag].snd_rwsem));
+        if ((dst != __TAG_RELAY_NONE) &&
+            aos_tag_relay(dst, gen, new_msg, size) &&
+            (tgts[i].res == 1)) tgts[i].res = 0;
+        if (tgts[i].res == 0) delivered++;
+        else if (tgts[i].res == -EINTR) break;
+    }
+    // If we got interrupted, mark the remaining targets as such.
+    for (i++; i < nr_targets; i++) tgts[i].res = -EINTR;
+    TAG_MSG_PUT(new_msg);
+    // Report results for each target.
+    if (copy_to_user(targets, tgts, nr_targets * sizeof(tag_target_t))) {
+        kvfree(tgts);
+        return -EFAULT;
+    }
+    kvfree(tgts);
+    if (TAG_DBG_ON(__TAG_DBG_SND))
+        printk(KERN_DEBUG "%s: tag_send_multi: Delivered %lu byte(s) message "
+                          "on %d target(s).\n", MODNAME, size, delivered);
+    return delivered;
+}
+
+/**
+ * @brief Allows a thread to send a request on a level of an instance and wait 
+ * for a reply on another level of the same instance, with a single call. 
+ * The calling thread registers on the reply level before the request is 
+ * posted, so that replies sent as soon as the request has been consumed 
+ * cannot be missed. 
+ * The same userspace buffer holds the request and, at the end, the reply. 
+ * Presence and permissions checks are performed as for tag_receive. 
+ * If no one was there to get the request, the call fails since no reply 
+ * can be expected. For the same reason, requests can't be posted on 
+ * conflating levels, where they could be superseded: should the level become 
+ * conflating while the request is being posted, and the request be 
+ * superseded, the call fails as well.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to post the request on.
+ * @param rpl_lvl Level of the aforementioned instance to get the reply from.
+ * @param buf Userspace buffer holding the request, and for the reply.
+ * @param size Size of the request.
+ * @param rpl_size Size of the aforementioned buffer, available for the reply.
+ * @return Size of the reply, or an error code for errno.
+ */
+int aos_tag_call(int tag, int lvl, int rpl_lvl, char *buf, size_t size,
+                 size_t rpl_size) {
+    tag_t *tag_inst;
+    tag_msg_t *new_msg = NULL;
+    unsigned char lvl_epoch, globl_epoch;
+    int ret;
+    if (TAG_DBG_ON(__TAG_DBG_SND))
+        printk(KERN_INFO "%s: tag_call: Called with (%d, %d, %d, 0x%px, %lu, "
+               "%lu).\n", MODNAME, tag, lvl, rpl_lvl, buf, size, rpl_size);
+    // Consistency checks on input arguments.
+    // Replies can't come on the request level, since we would be waiting for
+    // ourselves to consume our own request.
+    if ((tag < 0) || (tag >= max_tags) || ((size != 0) && (buf == NULL)) ||
+        (lvl < 0) || (lvl >= __NR_LEVELS) ||
+        (rpl_lvl < 0) || (rpl_lvl >= __NR_LEVELS) || (rpl_lvl == lvl))
+        return -EINVAL;
+    // First, check if the instance exists and we're allowed to access it.
+    // We act as a receiver for the whole call, and holding the receivers
+    // rw_semaphore is enough to keep the instance alive while we post the
+    // request too.
+    if (TAG_RCV_DOWN_READ(tag) == -EINTR)
+        return -EINTR;
+    tag_inst = tags_list[tag].ptr;
+    if (tag_inst == NULL) {
+        // Instance is not there anymore, or yet.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EIDRM;
+    }
+    if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+        (tag_inst->creator_euid.val != current_euid().val)) {
+        // We're not allowed to operate on this instance.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return -EACCES;
+    }
+    // We're in.
+    if (size != 0) {
+        // Bring the request in kernel space.
+        new_msg = TAG_MSG_ALLOC(size);
+        if (unlikely(new_msg == NULL)) {
+            up_read(&(tags_list[tag].rcv_rwsem));
+            return -ENOMEM;
+        }
+        if (copy_from_user(TAG_MSG_DATA(new_msg), buf, size)) {
+            // copy_from_user failed. Since it shouldn't, this service doesn't
+            // retry, so the operation is aborted.
+            up_read(&(tags_list[tag].rcv_rwsem));
+            TAG_MSG_PUT(new_msg);
+            return -EFAULT;
+        }
+        asm volatile ("mfence" ::: "memory");
+    }
+    if (((tag_inst->lvl_flags)[lvl] & (__TAG_LVL_CONFLATE | __TAG_LVL_SP)) ==
+        __TAG_LVL_CONFLATE) {
+        // The request could be superseded, and we would wait forever.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        TAG_MSG_PUT(new_msg);
+        return -EINVAL;
+    }
+    if (((tag_inst->lvl_flags)[rpl_lvl] & __TAG_LVL_SC) &&
+        !TAG_EXCL_ENTER(&((tag_inst->rcv_excl)[rpl_lvl]))) {
+        // Someone else is receiving on this single-consumer level.
+        up_read(&(tags_list[tag].rcv_rwsem));
+        TAG_MSG_PUT(new_msg);
+        return -EBUSY;
+    }
+    // Register for the reply before the request can be seen by anyone.
+    lvl_epoch = aos_tag_lvl_reg(tag_inst, rpl_lvl);
+    globl_epoch = TAG_COND_REG(&(tag_inst->globl_cond));
+    ret = aos_tag_post(tag_inst, lvl, new_msg, size);
+    TAG_MSG_PUT(new_msg);
+    if (ret != 0) {
+        // Either we got a signal, or no one will ever reply.
+        aos_tag_lvl_unreg(tag_inst, rpl_lvl, lvl_epoch);
+        TAG_COND_UNREG(&(tag_inst->globl_cond), globl_epoch);
+        if ((tag_inst->lvl_flags)[rpl_lvl] & __TAG_LVL_SC)
+            TAG_EXCL_EXIT(&((tag_inst->rcv_excl)[rpl_lvl]));
+        up_read(&(tags_list[tag].rcv_rwsem));
+        return ((ret == 1) || (ret == 2)) ? -ENOMSG : ret;
+    }
+    // Now wait for the reply, as a receiver would.
+    ret = aos_tag_consume(tag_inst, rpl_lvl, lvl_epoch, globl_epoch,
+                          buf, rpl_size, 0);
+    if ((tag_inst->lvl_flags)[rpl_lvl] & __TAG_LVL_SC)
+        TAG_EXCL_EXIT(&((tag_inst->rcv_excl)[rpl_lvl]));
+    up_read(&(tags_list[tag].rcv_rwsem));
+    if (TAG_DBG_ON(__TAG_DBG_RCV) && (ret >= 0))
+        printk(KERN_DEBUG "%s: tag_call: Got reply from tag: %d, on level "
+               "%d.\n", MODNAME, tag, rpl_lvl);
+    return ret;
+}
+
+/**
+ * @brief Awakes all threads waiting on all levels of an instance, and waits 
+ * for them to consume the wakeup. 
+ * Receives pending on rings and filtered receivers are canceled too. 
+ * The caller must hold the instance's AWAKE_ALL lock, as well as its senders 
+ * rw_semaphore as reader.
+ *
+ * @param tag_inst Instance to operate on.
+ */
+void aos_tag_awake_all(tag_t *tag_inst) {
+    unsigned char last_epoch;
+    unsigned int i;
+    // Change the current global epoch for this instance.
+    // This is a linearization point: all receivers that come after this
+    // won't get the call: they were too late.
+    last_epoch = TAG_COND_FLIP(&(tag_inst->globl_cond));
+    TAG_COND_VAL(&(tag_inst->globl_cond), last_epoch) = 0x1;
+    // Wake up all levels, both queues since we don't know which reader
+    // got in which local epoch and we don't want to care.
+    for (i = 0; i < __NR_LEVELS; i++) {
+        wake_up_all(&((tag_inst->lvl_queues)[i][0]));
+        wake_up_all(&((tag_inst->lvl_queues)[i][1]));
+        aos_tag_ring_cancel(tag_inst, i, NULL, -ECANCELED);
+        aos_tag_flt_cancel(tag_inst, i);
+    }
+    aos_tag_topic_cancel_all(tag_inst);
+    // Wait for receivers to consume the condition.
+    // Since busy-wait loops are bad in the kernel let the scheduler run
+    // some other task on this CPU in the meantime.
+    while (TAG_COND_COUNT(&(tag_inst->globl_cond), last_epoch) != 0)
+        // Note that due to the tag_rcv behavior, the aforementioned
+        // counter will reach zero, independently of the readers terminating
+        // gracefully or not, so this thread will never become an
+        // unkillable idle process *knocks on wood*.
+        schedule();
+}
+
+/**
+ * @brief Once the tag descriptor has been retrieved via tag_get, 
+ * allows to control an instance. 
+ * Supported commands are: 
  * - TAG_REMOVE: Deletes the instance, freeing the related tag descriptor. 
- * - TAG_AWAKE_ALL: Awakes all threads waiting on all levels.
+ * - TAG_AWAKE_ALL: Awakes all threads waiting on all levels. 
+ * - TAG_LVL_SET: Enables the operating modes in arg on the given level. 
+ * - TAG_LVL_CLR: Disables the operating modes in arg on the given level. 
+ * - TAG_LVL_NOTIFY: Sets the eventfd, with descriptor arg, that senders 
+ *                   signal on the given level, or removes it if arg is -1. 
+ * - TAG_LVL_RELAY: Sets the level, encoded in arg, on which messages sent on 
+ *                  the given level are relayed, or removes it if arg is 
+ *                  __TAG_RELAY_NONE. Rules that would close a loop are 
+ *                  refused, and rules towards an instance go with it. 
+ *                  Only dense levels can be relayed, and relayed to: the 
+ *                  encoding has no room for sparse identifiers.
  *
  * @param tag Tag descriptor of the instance to operate on.
  * @param cmd Operation to perform on the instance.
+ * @param lvl Level to operate on, for level commands.
+ * @param arg Argument for the aforementioned command.
  * @return 0 if operation completed successfully, or an error code for errno.
  */
-int aos_tag_ctl(int tag, int cmd) {
+static int aos_tag_do_ctl(int tag, int cmd, int lvl, unsigned long arg) {
     tag_t *tag_inst;
-    #ifdef DEBUG
-    printk(KERN_DEBUG "%s: tag_ctl: Called with (%d, %d).\n",
-           MODNAME, tag, cmd);
-    #endif
+    if (TAG_DBG_ON(__TAG_DBG_CTL))
+        printk(KERN_DEBUG "%s: tag_ctl: Called with (%d, %d, %d, 0x%lx).\n",
+               MODNAME, tag, cmd, lvl, arg);
     // Consistency check on input arguments.
     if ((tag < 0) || (tag >= max_tags) ||
-        ((cmd != __TAG_REMOVE) && (cmd != __TAG_AWAKE_ALL)))
+        ((cmd != __TAG_REMOVE) && (cmd != __TAG_AWAKE_ALL) &&
+         (cmd != __TAG_LVL_SET) && (cmd != __TAG_LVL_CLR) &&
+         (cmd != __TAG_LVL_NOTIFY) && (cmd != __TAG_LVL_RELAY)))
+        return -EINVAL;
+    if ((cmd == __TAG_LVL_RELAY) &&
+        ((lvl < 0) || (lvl >= __NR_LEVELS) ||
+         ((arg != __TAG_RELAY_NONE) &&
+          (((arg >> __TAG_RELAY_SHIFT) >= max_tags) ||
+           (TAG_RELAY_LVL(arg) >= __NR_LEVELS)))))
+        return -EINVAL;
+    if ((cmd == __TAG_LVL_NOTIFY) && ((lvl < 0) || (lvl >= __NR_LEVELS)))
+        return -EINVAL;
+    if (((cmd == __TAG_LVL_SET) || (cmd == __TAG_LVL_CLR)) &&
+        ((lvl < 0) || (lvl >= __NR_LEVELS) || (arg & ~__TAG_LVL_MODES)))
         return -EINVAL;
     // Execution will follow one of the next paths.
     if (cmd == __TAG_AWAKE_ALL) {
-        unsigned char last_epoch;
-        unsigned int i;
         // We have been asked to awake all threads waiting on all levels.
-        if (down_read_killable(&(tags_list[tag].snd_rwsem)) == -EINTR)
+        if (TAG_SND_DOWN_READ(tag) == -EINTR)
             return -EINTR;
         tag_inst = tags_list[tag].ptr;
         if (tag_inst == NULL) {
@@ -454,85 +1771,226 @@ int aos_tag_ctl(int tag, int cmd) {
             return -EACCES;
         }
         // Grab the AWAKE_ALL lock to exclude others.
-        if (mutex_lock_interruptible(&(tag_inst->awake_all_lock)) == -EINTR) {
+        if (TAG_AWAKE_LOCK(tag_inst) == -EINTR) {
             up_read(&(tags_list[tag].snd_rwsem));
             return -EINTR;
         }
-        // Change the current global epoch for this instance.
-        // This is a linearization point: all receivers that come after this
-        // won't get the call: they were too late.
-        last_epoch = TAG_COND_FLIP(&(tag_inst->globl_cond));
-        TAG_COND_VAL(&(tag_inst->globl_cond), last_epoch) = 0x1;
-        // Wake up all levels, both queues since we don't know which reader
-        // got in which local epoch and we don't want to care.
-        for (i = 0; i < __NR_LEVELS; i++) {
-            wake_up_all(&((tag_inst->lvl_queues)[i][0]));
-            wake_up_all(&((tag_inst->lvl_queues)[i][1]));
-        }
-        // Wait for receivers to consume the condition.
-        // Since busy-wait loops are bad in the kernel let the scheduler run
-        // some other task on this CPU in the meantime.
-        while (TAG_COND_COUNT(&(tag_inst->globl_cond), last_epoch) != 0)
-            // Note that due to the tag_rcv behavior, the aforementioned
-            // counter will reach zero, independently of the readers terminating
-            // gracefully or not, so this thread will never become an
-            // unkillable idle process *knocks on wood*.
-            schedule();
+        aos_tag_awake_all(tag_inst);
         // All done!
-        mutex_unlock(&(tag_inst->awake_all_lock));
+        TAG_AWAKE_UNLOCK(tag_inst);
+        up_read(&(tags_list[tag].snd_rwsem));
+        if (TAG_DBG_ON(__TAG_DBG_CTL))
+            printk(KERN_DEBUG "%s: tag_ctl: Awoken all receivers on tag: %d.\n",
+                   MODNAME, tag);
+    }
+    if ((cmd == __TAG_LVL_SET) || (cmd == __TAG_LVL_CLR)) {
+        tag_msg_t *last_msg = NULL;
+        // We have been asked to change the operating modes of a level.
+        if (TAG_SND_DOWN_READ(tag) == -EINTR)
+            return -EINTR;
+        tag_inst = tags_list[tag].ptr;
+        if (tag_inst == NULL) {
+            // Instance is not there anymore, or yet.
+            up_read(&(tags_list[tag].snd_rwsem));
+            return -EIDRM;
+        }
+        if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+            (tag_inst->creator_euid.val != current_euid().val)) {
+            // We're not allowed to operate on this instance.
+            up_read(&(tags_list[tag].snd_rwsem));
+            return -EACCES;
+        }
+        // Exclude senders, since they look at the modes while delivering.
+        // A single producer does not take the mutex, but its flag.
+        if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SP) {
+            if (!TAG_EXCL_ENTER(&((tag_inst->snd_excl)[lvl]))) {
+                up_read(&(tags_list[tag].snd_rwsem));
+                return -EBUSY;
+            }
+        } else if (TAG_SNDL_LOCK(tag_inst, lvl) == -EINTR) {
+            up_read(&(tags_list[tag].snd_rwsem));
+            return -EINTR;
+        }
+        if (cmd == __TAG_LVL_SET)
+            (tag_inst->lvl_flags)[lvl] |= (unsigned char)arg;
+        else (tag_inst->lvl_flags)[lvl] &= ~((unsigned char)arg);
+        if (!((tag_inst->lvl_flags)[lvl] & __TAG_LVL_STICKY)) {
+            // Drop the cached message, if any.
+            spin_lock(&((tag_inst->msg_locks)[lvl]));
+            swap(last_msg, (tag_inst->last_msgs)[lvl]);
+            spin_unlock(&((tag_inst->msg_locks)[lvl]));
+        }
+        if (TAG_DBG_ON(__TAG_DBG_CTL))
+            printk(KERN_DEBUG "%s: tag_ctl: Level %d of tag %d now has modes: "
+                   "0x%x.\n", MODNAME, lvl, tag, (tag_inst->lvl_flags)[lvl]);
+        if ((tag_inst->lvl_flags)[lvl] & __TAG_LVL_SP)
+            TAG_EXCL_EXIT(&((tag_inst->snd_excl)[lvl]));
+        else aos_tag_snd_unlock(tag_inst, lvl);
+        up_read(&(tags_list[tag].snd_rwsem));
+        TAG_MSG_PUT(last_msg);
+    }
+    if (cmd == __TAG_LVL_NOTIFY) {
+        struct eventfd_ctx *evfd = NULL;
+        // We have been asked to set the notification hook of a level.
+        // Get the new eventfd first, so we can fail before touching anything.
+        if ((int)arg != -1) {
+            evfd = eventfd_ctx_fdget((int)arg);
+            if (IS_ERR(evfd)) return PTR_ERR(evfd);
+        }
+        if (TAG_SND_DOWN_READ(tag) == -EINTR) {
+            if (evfd != NULL) eventfd_ctx_put(evfd);
+            return -EINTR;
+        }
+        tag_inst = tags_list[tag].ptr;
+        if ((tag_inst == NULL) ||
+            ((tag_inst->perm_check) && (current_euid().val != 0) &&
+             (tag_inst->creator_euid.val != current_euid().val))) {
+            // Instance is not there, or we're not allowed to operate on it.
+            up_read(&(tags_list[tag].snd_rwsem));
+            if (evfd != NULL) eventfd_ctx_put(evfd);
+            return (tag_inst == NULL) ? -EIDRM : -EACCES;
+        }
+        // Senders look at the hook under the level spinlock, so that it can't
+        // be released while they're signaling it.
+        spin_lock(&((tag_inst->msg_locks)[lvl]));
+        swap(evfd, (tag_inst->lvl_evfds)[lvl]);
+        spin_unlock(&((tag_inst->msg_locks)[lvl]));
         up_read(&(tags_list[tag].snd_rwsem));
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_ctl: Awoken all receivers on tag: %d.\n",
-               MODNAME, tag);
-        #endif
+        if (evfd != NULL) eventfd_ctx_put(evfd);
+        if (TAG_DBG_ON(__TAG_DBG_CTL))
+            printk(KERN_DEBUG "%s: tag_ctl: Set notification hook of level %d "
+                   "of tag %d.\n", MODNAME, lvl, tag);
+    }
+    if (cmd == __TAG_LVL_RELAY) {
+        int ret = 0;
+        // We have been asked to set the relay rule of a level.
+        // Rules only change under the relays rw_semaphore, which also keeps
+        // instances from being removed while we follow them.
+        if (down_write_killable(&relay_rwsem) == -EINTR) return -EINTR;
+        if (TAG_SND_DOWN_READ(tag) == -EINTR) {
+            up_write(&relay_rwsem);
+            return -EINTR;
+        }
+        tag_inst = tags_list[tag].ptr;
+        if (tag_inst == NULL) ret = -EIDRM;
+        else if ((tag_inst->perm_check) && (current_euid().val != 0) &&
+                 (tag_inst->creator_euid.val != current_euid().val))
+            ret = -EACCES;
+        else if (arg != __TAG_RELAY_NONE)
+            ret = aos_tag_relay_check(tag, lvl, arg);
+        if (ret == 0) {
+            // Keep count of rules, so removers can skip looking for them.
+            if (((tag_inst->relays)[lvl] == __TAG_RELAY_NONE) &&
+                (arg != __TAG_RELAY_NONE)) atomic_inc(&nr_relays);
+            else if (((tag_inst->relays)[lvl] != __TAG_RELAY_NONE) &&
+                     (arg == __TAG_RELAY_NONE)) atomic_dec(&nr_relays);
+            // Senders look at the rule without locks, one word at a time.
+            WRITE_ONCE((tag_inst->relays)[lvl], arg);
+        }
+        up_read(&(tags_list[tag].snd_rwsem));
+        up_write(&relay_rwsem);
+        if (ret != 0) return ret;
+        if (TAG_DBG_ON(__TAG_DBG_CTL))
+            printk(KERN_DEBUG "%s: tag_ctl: Set relay rule of level %d of tag "
+                   "%d: 0x%lx.\n", MODNAME, lvl, tag, arg);
     }
     if (cmd == __TAG_REMOVE) {
+        unsigned int i;
         // We have been asked to remove an instance.
-        // But first, check if someone is there, waiting to read.
-        if (down_write_trylock(&(tags_list[tag].rcv_rwsem)) == 0) return -EBUSY;
-        if (down_write_killable(&(tags_list[tag].snd_rwsem)) == -EINTR) {
-            up_write(&(tags_list[tag].rcv_rwsem));
+        // Exclude relay rules changes first.
+        if (down_read_killable(&relay_rwsem) == -EINTR) return -EINTR;
+        // Then, check if someone is there, waiting to read.
+        if (TAG_DOWN_WRITE_TRYLOCK(&(tags_list[tag].rcv_rwsem),
+                                   TAG_LOCK_INST(tag, __TAG_LOCK_RCV),
+                                   &(tags_list[tag].rcv_stamp)) == 0) {
+            up_read(&relay_rwsem);
+            return -EBUSY;
+        }
+        if (TAG_SND_DOWN_WRITE(tag) == -EINTR) {
+            TAG_RCV_UP_WRITE(tag);
+            up_read(&relay_rwsem);
             return -EINTR;
         }
         // We're in. Check if the instance is there and whether we can
         // access it or not, as above.
         tag_inst = tags_list[tag].ptr;
         if (tag_inst == NULL) {
-            up_write(&(tags_list[tag].snd_rwsem));
-            up_write(&(tags_list[tag].rcv_rwsem));
+            TAG_SND_UP_WRITE(tag);
+            TAG_RCV_UP_WRITE(tag);
+            up_read(&relay_rwsem);
             return -EIDRM;
         }
         if ((tag_inst->perm_check) && (current_euid().val != 0) &&
             (tag_inst->creator_euid.val != current_euid().val)) {
-            up_write(&(tags_list[tag].snd_rwsem));
-            up_write(&(tags_list[tag].rcv_rwsem));
+            TAG_SND_UP_WRITE(tag);
+            TAG_RCV_UP_WRITE(tag);
+            up_read(&relay_rwsem);
             return -EACCES;
         }
+        for (i = 0; i < __NR_LEVELS; i++) {
+            if (!list_empty(&((tag_inst->ring_rcvs)[i]))) {
+                // Someone is waiting to read, through a ring.
+                TAG_SND_UP_WRITE(tag);
+                TAG_RCV_UP_WRITE(tag);
+                up_read(&relay_rwsem);
+                return -EBUSY;
+            }
+        }
         // We got this. Just disconnect the instance ASAP.
         tags_list[tag].ptr = NULL;
         asm volatile ("mfence" ::: "memory");
-        up_write(&(tags_list[tag].snd_rwsem));
-        up_write(&(tags_list[tag].rcv_rwsem));
+        TAG_SND_UP_WRITE(tag);
+        TAG_RCV_UP_WRITE(tag);
+        // Rules from this instance go away with it, while those towards it
+        // must be gone before its tag descriptor can be reused.
+        for (i = 0; i < __NR_LEVELS; i++)
+            if ((tag_inst->relays)[i] != __TAG_RELAY_NONE)
+                atomic_dec(&nr_relays);
+        if (atomic_read(&nr_relays) != 0) aos_tag_relay_unlink(tag);
+        up_read(&relay_rwsem);
         // Ok, now let's cut all references: BST and bitmask.
         if (tag_inst->key != __TAG_IPC_PRIVATE) {
-            // Remove this key from the BST.
-            down_write(&shared_bst_lock);
-            if (!splay_int_delete(shared_bst, tag_inst->key))
+            // Remove this key from its BST shard.
+            TAG_BST_DOWN_WRITE(TAG_BST_SHARD(tag_inst->key));
+            if (!splay_int_delete(shared_bsts[TAG_BST_SHARD(tag_inst->key)],
+                                  tag_inst->key))
                 printk(KERN_ERR "%s: tag_ctl: Couldn't remove key %d, with tag"
                        " %d.\n", MODNAME, tag_inst->key, tag);
-            #ifdef DEBUG
-            else
+            else if (TAG_DBG_ON(__TAG_DBG_CTL))
                 printk(KERN_DEBUG "%s: tag_ctl: Deleted key: %d from BST.\n",
                    MODNAME, tag_inst->key);
-            #endif
-            up_write(&shared_bst_lock);
+            TAG_BST_UP_WRITE(TAG_BST_SHARD(tag_inst->key));
         }
         TAG_CLR(tags_mask, tag);
+        for (i = 0; i < __NR_LEVELS; i++) {
+            TAG_MSG_PUT((tag_inst->last_msgs)[i]);
+            TAG_MSG_PUT((tag_inst->next_msgs)[i]);
+            if ((tag_inst->lvl_evfds)[i] != NULL)
+                eventfd_ctx_put((tag_inst->lvl_evfds)[i]);
+        }
         tag_inst->creator_euid.val = 0;  // For security.
         kfree(tag_inst);  // Done!
-        #ifdef DEBUG
-        printk(KERN_DEBUG "%s: tag_ctl: Removed tag: %d.\n", MODNAME, tag);
-        #endif
+        if (TAG_DBG_ON(__TAG_DBG_CTL))
+            printk(KERN_DEBUG "%s: tag_ctl: Removed tag: %d.\n", MODNAME, tag);
     }
     return 0;
 }
+
+/**
+ * @brief Controls an instance, see aos_tag_do_ctl. 
+ * Traced at entry and exit.
+ *
+ * @param tag Tag descriptor of the instance to operate on.
+ * @param cmd Operation to perform on the instance.
+ * @param lvl Level to operate on, for level commands.
+ * @param arg Argument for the aforementioned command.
+ * @return 0 if operation completed successfully, or an error code for errno.
+ */
+int aos_tag_ctl(int tag, int cmd, int lvl, unsigned long arg) {
+    int ret;
+    trace_tag_ctl_enter(tag, cmd, lvl, arg);
+    ret = aos_tag_do_ctl(tag, cmd, lvl, arg);
+    trace_tag_ctl_exit(tag, cmd, ret);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(aos_tag_ctl);
@@ -34,17 +34,75 @@
 #define __NR_LEVELS 32         // Number of levels in an instance.
 #define __MAX_TAGS_DFL 256     // Default max number of active instances.
 #define __MAX_MSG_SZ_DFL 4096  // Default max message size, in bytes.
+#define __TAG_TOPIC_BITS 6     // Log2 of sparse levels buckets in an instance.
+#define __TAG_TOPIC_BKTS (1 << __TAG_TOPIC_BITS)
+#define __TAG_BST_SHARD_BITS 4  // Log2 of shared keys dictionary shards.
+#define __TAG_BST_SHARDS (1 << __TAG_BST_SHARD_BITS)
+#define __TAG_HIST_BUCKETS 32  // Log2 buckets of latency histograms.
+
+/* Sparse level identifiers: 62 bits, tagged with the next one so that stray 
+ * levels, and negative ones sign-extended, aren't taken for them. */
+#define __TAG_SPARSE_BIT (1UL << 62)
+#define __TAG_SPARSE_MASK (__TAG_SPARSE_BIT - 1)
+
+/* Lock classes with contention accounting: the first ones are accounted for 
+ * each tag descriptor, the others for the whole module. */
+#define __TAG_LOCK_RCV 0    // Receivers rw_semaphore of a descriptor.
+#define __TAG_LOCK_SND 1    // Senders rw_semaphore of a descriptor.
+#define __TAG_LOCK_SNDL 2   // Senders mutexes of the levels of an instance.
+#define __TAG_LOCK_AWAKE 3  // AWAKE_ALL mutex of an instance.
+#define __TAG_LOCK_BST 4    // Shared keys BST shards rw_semaphores.
+#define __TAG_LOCK_MASK 5   // Instances bitmask spinlock.
+#define __TAG_INST_LOCKS 4
+#define __TAG_LOCK_CLASSES 6
 
 /* tag_get commands and special keys. */
 #define __TAG_OPEN 0
 #define __TAG_CREATE 1
 #define __TAG_ALL 0
 #define __TAG_USR 1
+#define __TAG_SP 0x2  // Single producer, OR'ed to permission.
+#define __TAG_SC 0x4  // Single consumer, OR'ed to permission.
 #define __TAG_IPC_PRIVATE 0  // This value is coeherent with sys/ipc.h.
 
 /* tag_ctl commands. */
 #define __TAG_AWAKE_ALL 0
 #define __TAG_REMOVE 1
+#define __TAG_LVL_SET 2
+#define __TAG_LVL_CLR 3
+#define __TAG_LVL_NOTIFY 4
+#define __TAG_LVL_RELAY 5
+
+/* Level operating modes, for TAG_LVL_SET/CLR. */
+#define __TAG_LVL_STICKY 0x1
+#define __TAG_LVL_CONFLATE 0x2
+#define __TAG_LVL_MODES (__TAG_LVL_STICKY | __TAG_LVL_CONFLATE)
+
+/* Relay destinations, for TAG_LVL_RELAY: tag descriptor and level. */
+#define __TAG_RELAY_SHIFT 8
+#define __TAG_RELAY_MASK ((1UL << __TAG_RELAY_SHIFT) - 1)
+#define __TAG_RELAY_NONE (~0UL)
+#define __TAG_RELAY_HOPS 8  // Max relay hops followed from a single send.
+
+/* Max targets of a single tag_send_multi. */
+#define __TAG_MULTI_MAX 1024
+
+/* Level topologies, fixed at creation time. */
+#define __TAG_LVL_SP 0x40
+#define __TAG_LVL_SC 0x80
+
+/* tag_receive flags. */
+#define __TAG_RCV_LAST 0x1
+#define __TAG_RCV_FILTER 0x2
+#define __TAG_RCV_FLAGS (__TAG_RCV_LAST | __TAG_RCV_FILTER)
+
+/* Length of the message prefix that receive filters look at. */
+#define __TAG_FLT_LEN 8
+
+/* Ring operations. */
+#define __TAG_OP_SEND 0
+#define __TAG_OP_RECEIVE 1
+#define __TAG_OP_CTL 2
 
 #else
 /* USERSPACE HEADER */
@@ -66,22 +124,188 @@
 #define __NR_tag_ctl 178
 #endif
 
+#ifndef __NR_tag_send_multi
+#define __NR_tag_send_multi 180
+#endif
+
+#ifndef __NR_tag_call
+#define __NR_tag_call 181
+#endif
+
 /* Commands and special values for system calls. */
 /* tag_get commands and special keys. */
 #define TAG_OPEN 0
 #define TAG_CREATE 1
 #define TAG_ALL 0
 #define TAG_USR 1
+#define TAG_SP 0x2
+#define TAG_SC 0x4
 
 /* tag_ctl commands. */
 #define AWAKE_ALL 0
 #define REMOVE 1
+#define TAG_LVL_SET 2
+#define TAG_LVL_CLR 3
+#define TAG_LVL_NOTIFY 4
+#define TAG_LVL_RELAY 5
+
+/* Level operating modes, for TAG_LVL_SET/CLR. */
+#define TAG_LVL_STICKY 0x1
+#define TAG_LVL_CONFLATE 0x2
+
+/* Relay destinations, for TAG_LVL_RELAY, on dense levels only. */
+/* Other levels become an invalid one, instead of spilling into the tag. */
+#define TAG_RELAY_TO(tag, level)                                    \
+    (((unsigned long)(tag) << 8) |                                  \
+     (((unsigned long)(level) < TAG_LEVELS) ? (unsigned long)(level) \
+                                            : 0xFFUL))
+#define TAG_RELAY_NONE (~0UL)
+
+/* Max targets of a single tag_send_multi. */
+#define TAG_MULTI_MAX 1024
+
+/* tag_receive flags. */
+#define TAG_RCV_LAST 0x1
+#define TAG_RCV_FILTER 0x2
+
+/* Number of dense levels. */
+#define TAG_LEVELS 32
+
+/* Sparse level identifiers: any 62-bit value, e.g. a hash of a topic name, 
+ * must be wrapped in this to be used as a level. Other levels from 
+ * TAG_LEVELS on are invalid. */
+#define TAG_SPARSE_BIT (1UL << 62)
+#define TAG_SPARSE(id) \
+    (((unsigned long)(id) & (TAG_SPARSE_BIT - 1)) | TAG_SPARSE_BIT)
+
+/* Length of the message prefix that receive filters look at. */
+#define TAG_FLT_LEN 8
+
+/* Ring operations. */
+#define TAG_OP_SEND 0
+#define TAG_OP_RECEIVE 1
+#define TAG_OP_CTL 2
 
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+/* Data plane device file. */
+#define TAG_DEVFILE "/dev/aos_tag"
+
+/* Argument of data plane ioctls: system call arguments, in order. */
+struct tag_ioctl_args {
+    unsigned long args[6];
+};
+
+/* Data plane ioctl commands, one for each system call. */
+#define TAG_IOC_MAGIC 0xA7
+#define TAG_IOC_GET _IOW(TAG_IOC_MAGIC, 0, struct tag_ioctl_args)
+#define TAG_IOC_RECEIVE _IOW(TAG_IOC_MAGIC, 1, struct tag_ioctl_args)
+#define TAG_IOC_SEND _IOW(TAG_IOC_MAGIC, 2, struct tag_ioctl_args)
+#define TAG_IOC_CTL _IOW(TAG_IOC_MAGIC, 3, struct tag_ioctl_args)
+#define TAG_IOC_SEND_MULTI _IOW(TAG_IOC_MAGIC, 4, struct tag_ioctl_args)
+#define TAG_IOC_CALL _IOW(TAG_IOC_MAGIC, 5, struct tag_ioctl_args)
+#define TAG_IOC_RING_SETUP _IOW(TAG_IOC_MAGIC, 6, struct tag_ioctl_args)
+#define TAG_IOC_RING_ENTER _IOW(TAG_IOC_MAGIC, 7, struct tag_ioctl_args)
+
+/* Status device file, and its binary snapshot ioctl command. */
+#define TAG_STATUS_DEVFILE "/dev/aos_tag_status"
+#define TAG_IOC_SNAPSHOT _IOW(TAG_IOC_MAGIC, 8, struct tag_ioctl_args)
+#define TAG_IOC_HIST_RESET _IOW(TAG_IOC_MAGIC, 9, struct tag_ioctl_args)
+#define TAG_IOC_LOCK_STATS _IOW(TAG_IOC_MAGIC, 10, struct tag_ioctl_args)
+
+/* Buckets of latency histograms: 0 ns in the first one, [2^(i-1), 2^i) ns in 
+ * the i-th one, and everything above in the last one. */
+#define TAG_HIST_BUCKETS 32
+
+/* Lock classes with contention accounting: the first TAG_INST_LOCKS are 
+ * accounted for each tag descriptor too. */
+#define TAG_LOCK_RCV 0     // Receivers rw_semaphore of a descriptor.
+#define TAG_LOCK_SND 1     // Senders rw_semaphore of a descriptor.
+#define TAG_LOCK_SNDL 2    // Senders mutexes of the levels of an instance.
+#define TAG_LOCK_AWAKE 3   // AWAKE_ALL mutex of an instance.
+#define TAG_LOCK_BST 4     // Shared keys dictionary shards rw_semaphores.
+#define TAG_LOCK_MASK 5    // Instances bitmask spinlock.
+#define TAG_INST_LOCKS 4
+#define TAG_LOCK_CLASSES 6
+
+/* Size of the traffic counters mapping, a multiple of the page size. */
+#define TAG_STATS_SIZE(max_tags)                                         \
+    ((((max_tags) * sizeof(struct tag_stats)) +                          \
+      (size_t)sysconf(_SC_PAGESIZE) - 1) &                               \
+     ~((size_t)sysconf(_SC_PAGESIZE) - 1))
+
+/* Binary snapshot records layout version, and level topologies in flags. */
+#define TAG_SNAP_VERSION 1
+#define TAG_LVL_SP 0x40
+#define TAG_LVL_SC 0x80
+
+/* Binary snapshot record: status of a level of an active instance. */
+struct tag_snap_rec {
+    int tag;                 // Tag descriptor.
+    int key;                 // Instance key.
+    unsigned int euid;       // Instance creator EUID.
+    unsigned int level;      // Level.
+    unsigned long waiting;   // Threads waiting on the level.
+    unsigned long filtered;  // Filtered receivers waiting on the level.
+    unsigned long pending;   // Pending ring receives on the level.
+    unsigned long relay;     // Relay destination, or TAG_RELAY_NONE.
+    unsigned int flags;      // TAG_LVL_* modes and topologies.
+    unsigned int last_size;  // Size of the cached message, 0 if none.
+};
+
+/* Receive filter: a message matches if (prefix & mask) == (value & mask), 
+ * byte by byte, where missing bytes of shorter messages read as zero. */
+struct tag_filter {
+    unsigned char mask[TAG_FLT_LEN];
+    unsigned char value[TAG_FLT_LEN];
+};
+
+/* Data plane device file descriptor, opened on first use. */
+static int __tag_dev_fd = -1;
+
+/* Target of a tag_send_multi call. */
+struct tag_target {
+    int tag;     // Tag descriptor of the target instance.
+    int level;   // Level of the target instance.
+    int result;  // Outcome of the delivery on this target (set by the call).
+};
+
+/**
+ * @brief Executes one of the service operations through the data plane device 
+ * file, exactly as the corresponding system call would. 
+ * The device file is opened on first use, and kept open. 
+ * Defining AOS_TAG_IOCTL before including this header makes all the following 
+ * stubs use this instead of the system calls, e.g. when the module has been 
+ * loaded without SCTH.
+ *
+ * @param command TAG_IOC_* command for the operation to execute.
+ * @param args Arguments of the corresponding system call, in order.
+ * @return Same as the corresponding system call.
+ */
+static inline int tag_ioctl(unsigned long command,
+                            struct tag_ioctl_args *args) {
+    int fd = __atomic_load_n(&__tag_dev_fd, __ATOMIC_ACQUIRE);
+    if (fd == -1) {
+        int expected = -1;
+        fd = open(TAG_DEVFILE, O_RDWR | O_CLOEXEC);
+        if (fd == -1) return -1;
+        // Another thread might have been faster.
+        if (!__atomic_compare_exchange_n(&__tag_dev_fd, &expected, fd, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            close(fd);
+            fd = expected;
+        }
+    }
+    errno = 0;
+    return ioctl(fd, command, args);
+}
 
 /* Userspace system calls stubs. */
 
@@ -92,6 +316,10 @@
  * With perm, it is possible to specify whether permission checks should be 
  * peformed to limit access to threads executing on behalf of the same user 
  * that created the instance. 
+ * When creating, TAG_SP and/or TAG_SC can be OR'ed to perm to declare that 
+ * each level will have at most a single producer and/or consumer at a time: 
+ * those get cheaper paths, and operations that would violate the declaration 
+ * fail with EBUSY. 
  * Use the TAG_* flags for command and permission.
  *
  * @param key Key to assign to the new instance, or to look for.
@@ -100,15 +328,24 @@
  * @return Tag descriptor, or -1 and errno will be set.
  */
 static inline int tag_get(int key, int command, int permission) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)key, (unsigned long)command,
+                                   (unsigned long)permission}};
+    return tag_ioctl(TAG_IOC_GET, &args);
+#else
     errno = 0;
     return syscall(__NR_tag_get, key, command, permission);
+#endif
 }
 
 /**
  * @brief Allows a thread to receive a message from a level of an instance. 
  * The instance should have been previously opened with tag_get, however 
  * presence and permissions checks are always performed. 
- * The provided buffer must be large enough to store the new message.
+ * The provided buffer must be large enough to store the new message. 
+ * Levels made with TAG_SPARSE are sparse: any identifier can be used, and the 
+ * level only exists while someone is waiting on it. Other levels from 
+ * TAG_LEVELS on are invalid.
  *
  * @param tag Tag descriptor of the instance to access.
  * @param lvl Level of the aforementioned instance to receive from.
@@ -116,9 +353,73 @@ static inline int tag_get(int key, int command, int permission) {
  * @param size Size of the aforementioned buffer.
  * @return Size of the message if successful, or -1 and errno will be set.
  */
-static inline int tag_receive(int tag, int level, char *buffer, size_t size) {
+static inline int tag_receive(int tag, unsigned long level, char *buffer,
+                              size_t size) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)level,
+                                   (unsigned long)buffer, (unsigned long)size,
+                                   0, 0}};
+    return tag_ioctl(TAG_IOC_RECEIVE, &args);
+#else
     errno = 0;
-    return syscall(__NR_tag_receive, tag, level, buffer, size);
+    return syscall(__NR_tag_receive, tag, level, buffer, size, 0);
+#endif
+}
+
+/**
+ * @brief As tag_receive, but allows to alter the operation with some flags. 
+ * Supported flags are: 
+ * - TAG_RCV_LAST: Do not wait, get the last message posted on a sticky level. 
+ * - TAG_RCV_FILTER: Only get a matching message (see tag_receive_filter).
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param buf Buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param flags Receive flags, OR'ed together.
+ * @return Size of the message if successful, or -1 and errno will be set.
+ */
+static inline int tag_receive_flags(int tag, unsigned long level, char *buffer,
+                                    size_t size, int flags) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)level,
+                                   (unsigned long)buffer, (unsigned long)size,
+                                   (unsigned long)flags, 0}};
+    return tag_ioctl(TAG_IOC_RECEIVE, &args);
+#else
+    errno = 0;
+    return syscall(__NR_tag_receive, tag, level, buffer, size, flags, NULL);
+#endif
+}
+
+/**
+ * @brief As tag_receive_flags, but only gets messages that match a filter on 
+ * their first TAG_FLT_LEN bytes, and keeps waiting otherwise. 
+ * Senders do not wake up the calling thread for messages that don't match.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param lvl Level of the aforementioned instance to receive from.
+ * @param buf Buffer in which to copy the new message.
+ * @param size Size of the aforementioned buffer.
+ * @param flags Receive flags, OR'ed together (TAG_RCV_FILTER is implied).
+ * @param filter Filter that messages must match.
+ * @return Size of the message if successful, or -1 and errno will be set.
+ */
+static inline int tag_receive_filter(int tag, unsigned long level,
+                                     char *buffer,
+                                     size_t size, int flags,
+                                     struct tag_filter *filter) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)level,
+                                   (unsigned long)buffer, (unsigned long)size,
+                                   (unsigned long)(flags | TAG_RCV_FILTER),
+                                   (unsigned long)filter}};
+    return tag_ioctl(TAG_IOC_RECEIVE, &args);
+#else
+    errno = 0;
+    return syscall(__NR_tag_receive, tag, level, buffer, size,
+                   flags | TAG_RCV_FILTER, filter);
+#endif
 }
 
 /**
@@ -128,18 +429,28 @@ static inline int tag_receive(int tag, int level, char *buffer, size_t size) {
  * I/O is packetized: the entire size of the buffer provided will 
  * be copied for distribution to readers. The operation will fail if this is 
  * not possible. 
- * Note that zero-length messages are allowed.
+ * Note that zero-length messages are allowed. 
+ * On sparse levels, made with TAG_SPARSE, the message only reaches the 
+ * threads waiting on that exact identifier.
  *
  * @param tag Tag descriptor of the instance to access.
  * @param lvl Level of the aforementioned instance to write into.
  * @param buf Buffer holding the message to send.
  * @param size Size of the aforementioned buffer.
- * @return 0 if the message was successfully delivered, 1 if no one was there or
- * -1 and errno will be set.
+ * @return 0 if the message was successfully delivered, 1 if no one was there, 
+ * 2 if it was superseded by a newer one on a conflating level, or -1 and 
+ * errno will be set.
  */
-static inline int tag_send(int tag, int level, char *buffer, size_t size) {
+static inline int tag_send(int tag, unsigned long level, char *buffer,
+                           size_t size) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)level,
+                                   (unsigned long)buffer, (unsigned long)size}};
+    return tag_ioctl(TAG_IOC_SEND, &args);
+#else
     errno = 0;
     return syscall(__NR_tag_send, tag, level, buffer, size);
+#endif
 }
 
 /**
@@ -155,8 +466,388 @@ static inline int tag_send(int tag, int level, char *buffer, size_t size) {
  * @return 0 if successful, or -1 and errno will be set.
  */
 static inline int tag_ctl(int tag, int command) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)command,
+                                   0, 0}};
+    return tag_ioctl(TAG_IOC_CTL, &args);
+#else
     errno = 0;
-    return syscall(__NR_tag_ctl, tag, command);
+    return syscall(__NR_tag_ctl, tag, command, 0, 0UL);
+#endif
+}
+
+/**
+ * @brief Allows to control a single level of an instance. 
+ * Supported commands are: 
+ * - TAG_LVL_SET: Enables the level operating modes specified in arg. 
+ * - TAG_LVL_CLR: Disables the level operating modes specified in arg. 
+ * - TAG_LVL_NOTIFY: Makes senders signal the eventfd with descriptor arg each 
+ *                   time they post a message on the level, or stops doing so 
+ *                   if arg is -1. 
+ * - TAG_LVL_RELAY: Makes each message sent on the level also be delivered on 
+ *                  the level in arg, built with TAG_RELAY_TO, or stops doing 
+ *                  so if arg is TAG_RELAY_NONE. Both levels must be dense: 
+ *                  sparse ones can't be relayed, nor relayed to. 
+ * Supported operating modes are: 
+ * - TAG_LVL_STICKY: The level keeps the last message posted on it, that can 
+ *                   be retrieved with TAG_RCV_LAST. 
+ * - TAG_LVL_CONFLATE: Senders that find a delivery in progress leave their 
+ *                     message to be delivered next, replacing older ones, 
+ *                     and return immediately.
+ *
+ * @param tag Tag descriptor of the instance to operate on.
+ * @param cmd Operation to perform on the level.
+ * @param lvl Level to operate on.
+ * @param arg Argument for the aforementioned command.
+ * @return 0 if successful, or -1 and errno will be set.
+ */
+static inline int tag_level_ctl(int tag, int command, int level,
+                                unsigned long arg) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)command,
+                                   (unsigned long)level, (unsigned long)arg}};
+    return tag_ioctl(TAG_IOC_CTL, &args);
+#else
+    errno = 0;
+    return syscall(__NR_tag_ctl, tag, command, level, arg);
+#endif
+}
+
+/**
+ * @brief Allows a thread to send the same message on multiple levels, possibly 
+ * of different instances, with a single call. 
+ * The message is brought into the kernel only once, then it is posted on each 
+ * target in order, as tag_send would do. 
+ * The outcome for each target is stored in its result field: 0 if the message 
+ * was delivered, 1 if no one was there, or a negative errno value.
+ *
+ * @param targets Array of (tag, level) pairs to send the message on.
+ * @param nr_targets Number of entries in the aforementioned array, at most 
+ *                   TAG_MULTI_MAX.
+ * @param buf Buffer holding the message to send.
+ * @param size Size of the aforementioned buffer.
+ * @return Number of targets on which the message was delivered, or -1 and 
+ * errno will be set.
+ */
+static inline int tag_send_multi(struct tag_target *targets,
+                                 unsigned int nr_targets,
+                                 char *buffer, size_t size) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)targets,
+                                   (unsigned long)nr_targets,
+                                   (unsigned long)buffer, (unsigned long)size}};
+    return tag_ioctl(TAG_IOC_SEND_MULTI, &args);
+#else
+    errno = 0;
+    return syscall(__NR_tag_send_multi, targets, nr_targets, buffer, size);
+#endif
+}
+
+/**
+ * @brief Allows a thread to send a request on a level of an instance, then 
+ * wait for a reply on another level of the same instance, in a single call. 
+ * The thread starts waiting for the reply before the request is posted, so 
+ * replies can't be missed. 
+ * The same buffer holds the request and then receives the reply, which must 
+ * fit in reply_size bytes.
+ *
+ * @param tag Tag descriptor of the instance to access.
+ * @param level Level to post the request on.
+ * @param reply_level Level to wait for the reply on (must be different).
+ * @param buffer Buffer holding the request, and for the reply.
+ * @param size Size of the request.
+ * @param reply_size Size of the buffer available for the reply.
+ * @return Size of the reply, or -1 and errno will be set.
+ */
+static inline int tag_call(int tag, int level, int reply_level, char *buffer,
+                           size_t size, size_t reply_size) {
+#ifdef AOS_TAG_IOCTL
+    struct tag_ioctl_args args = {{(unsigned long)tag, (unsigned long)level,
+                                   (unsigned long)reply_level,
+                                   (unsigned long)buffer, (unsigned long)size,
+                                   (unsigned long)reply_size}};
+    return tag_ioctl(TAG_IOC_CALL, &args);
+#else
+    errno = 0;
+    return syscall(__NR_tag_call, tag, level, reply_level, buffer, size,
+                   reply_size);
+#endif
+}
+
+/* Traffic counters of a level, as mapped from the status device file. */
+struct tag_lvl_stats {
+    unsigned long sends;       // Messages sent.
+    unsigned long deliveries;  // Messages delivered to some receiver.
+    unsigned long discards;    // Messages no one was waiting for.
+    unsigned long bytes;       // Bytes sent.
+    unsigned long wakeups;     // Receivers that got a message.
+    unsigned long errors;      // Receives that failed.
+};
+
+/* Latency histograms of a level, in nanoseconds. */
+struct tag_lvl_hists {
+    unsigned int wakeup[TAG_HIST_BUCKETS];  // From send to receiver return.
+    unsigned int copy[TAG_HIST_BUCKETS];    // Receiver copy time.
+    unsigned int drain[TAG_HIST_BUCKETS];   // Sender wait for receivers.
+};
+
+/* Contention counters of a lock class, updated while lock_stats is set. 
+ * Hold times only account exclusive holds. */
+struct tag_lock_stats {
+    unsigned long acquired;   // Successful acquisitions.
+    unsigned long contended;  // Acquisitions that had to wait.
+    unsigned long wait_ns;    // Time spent waiting, in nanoseconds.
+    unsigned long hold_ns;    // Time spent holding, in nanoseconds.
+};
+
+/* Traffic counters of a tag descriptor, reset when a new instance takes it. */
+struct tag_stats {
+    unsigned long gen;                            // Instances created on it.
+    struct tag_lvl_stats levels[TAG_LEVELS];      // Counters of dense levels.
+    struct tag_lvl_hists hists[TAG_LEVELS];       // Histograms of dense levels.
+    struct tag_lock_stats locks[TAG_INST_LOCKS];  // Contention on its locks.
+};
+
+/**
+ * @brief Maps the traffic counters of all tag descriptors, read-only, from 
+ * the status device file: an array of max_tags entries, indexed by tag 
+ * descriptor, that can be read with no system calls. 
+ * Counters are updated while they are read, with no ordering between them. 
+ * A change of gen means that the descriptor has been taken by a new instance, 
+ * whose counters start from zero.
+ *
+ * @param fd Status device file descriptor.
+ * @param max_tags Value of the max_tags module parameter.
+ * @return Address of the counters, or NULL and errno will be set.
+ */
+static inline const struct tag_stats *tag_stats_map(int fd,
+                                                    unsigned int max_tags) {
+    void *stats;
+    stats = mmap(NULL, TAG_STATS_SIZE(max_tags), PROT_READ, MAP_SHARED, fd, 0);
+    if (stats == MAP_FAILED) return NULL;
+    return (const struct tag_stats *)stats;
+}
+
+/**
+ * @brief Resets the latency histograms of all levels of an instance. 
+ * Only the creator of the instance, or root, can do this.
+ *
+ * @param fd Status device file descriptor.
+ * @param tag Tag descriptor of the instance.
+ * @return 0 if successful, or -1 and errno will be set.
+ */
+static inline int tag_hist_reset(int fd, int tag) {
+    struct tag_ioctl_args args = {{(unsigned long)tag}};
+    errno = 0;
+    return ioctl(fd, TAG_IOC_HIST_RESET, &args);
+}
+
+/**
+ * @brief Reads the lock contention counters of all lock classes, indexed by 
+ * class. Classes bound to descriptors are summed over all of them; counters 
+ * of each descriptor can be read from the mapping of tag_stats_map. 
+ * Accounting must be enabled with the lock_stats module parameter.
+ *
+ * @param fd Status device file descriptor.
+ * @param stats Buffer of TAG_LOCK_CLASSES entries to fill.
+ * @return Number of classes read, or -1 and errno will be set.
+ */
+static inline int tag_lock_stats(int fd, struct tag_lock_stats *stats) {
+    struct tag_ioctl_args args = {{(unsigned long)stats, TAG_LOCK_CLASSES}};
+    errno = 0;
+    return ioctl(fd, TAG_IOC_LOCK_STATS, &args);
+}
+
+/**
+ * @brief Unmaps the traffic counters.
+ *
+ * @param stats Address returned by tag_stats_map.
+ * @param max_tags Value of the max_tags module parameter.
+ */
+static inline void tag_stats_unmap(const struct tag_stats *stats,
+                                   unsigned int max_tags) {
+    munmap((void *)stats, TAG_STATS_SIZE(max_tags));
+}
+
+/**
+ * @brief Takes a binary snapshot of the status of the service: a record for 
+ * each level of each active instance, as the status device file would print, 
+ * with some more data. 
+ * Records are returned in order, a buffer at a time: cursor must be set to 0 
+ * to start, and is updated so that the next call resumes from there. 
+ * Instances are read one at a time, not all together.
+ *
+ * @param fd Status device file descriptor.
+ * @param recs Buffer to fill.
+ * @param nr_recs Number of records the buffer can hold.
+ * @param cursor Where to start from, updated by the call.
+ * @return Number of records returned, 0 at the end, or -1 and errno will be 
+ *         set.
+ */
+static inline int tag_snapshot(int fd, struct tag_snap_rec *recs,
+                               unsigned int nr_recs, unsigned long *cursor) {
+    struct tag_ioctl_args args = {{(unsigned long)TAG_SNAP_VERSION,
+                                   (unsigned long)recs,
+                                   (unsigned long)nr_recs,
+                                   (unsigned long)cursor}};
+    errno = 0;
+    return ioctl(fd, TAG_IOC_SNAPSHOT, &args);
+}
+
+/* Submission/completion rings. */
+
+/* Header of the shared area of a ring set. */
+struct tag_ring_hdr {
+    unsigned int sq_head;     // Next entry the kernel will consume.
+    unsigned int sq_tail;     // Next entry to fill.
+    unsigned int cq_head;     // Next completion to reap.
+    unsigned int cq_tail;     // Next completion the kernel will post.
+    unsigned int sq_entries;  // Number of submission queue entries.
+    unsigned int cq_entries;  // Number of completion queue entries.
+    unsigned long sq_off;     // Offset of the submission queue in the area.
+    unsigned long cq_off;     // Offset of the completion queue in the area.
+    unsigned long buf_off;    // Offset of the buffer area in the area.
+    unsigned long buf_size;   // Size of the buffer area.
+};
+
+/* Submission queue entry: one operation, with the system call arguments. */
+struct tag_sqe {
+    unsigned long user_data;  // Returned as is in the completion.
+    int op;                   // TAG_OP_* operation to perform.
+    int tag;                  // Tag descriptor of the instance.
+    int level;                // Level of the instance.
+    int flags;                // Receive flags, or tag_ctl command.
+    unsigned long addr;       // Message buffer, or tag_ctl argument.
+    unsigned long size;       // Size of the aforementioned buffer.
+};
+
+/* Completion queue entry. */
+struct tag_cqe {
+    unsigned long user_data;  // From the submission queue entry.
+    long result;              // As the system call would return, or -errno.
+};
+
+/* Ring set, with its own session on the data plane device file. */
+struct tag_ring {
+    int fd;                     // Data plane device file descriptor.
+    char *area;                 // Shared area.
+    size_t area_size;           // Size of the shared area.
+    struct tag_ring_hdr *hdr;   // Header, in the shared area.
+    struct tag_sqe *sqes;       // Submission queue, in the shared area.
+    struct tag_cqe *cqes;       // Completion queue, in the shared area.
+    char *bufs;                 // Buffer area, in the shared area.
+    unsigned int sqe_tail;      // Next entry to fill, not submitted yet.
+};
+
+/**
+ * @brief Creates a new ring set: a submission and a completion queue shared 
+ * with the kernel, through which operations can be carried out with no system 
+ * call for each of them. 
+ * Sends and control operations are executed when submitted, with the same 
+ * arguments as the corresponding system calls. 
+ * Receives that can't be completed right away stay pending, without blocking 
+ * anyone, until a message comes or they are canceled by AWAKE_ALL: their 
+ * buffers must lie in the buffer area of the ring set, in which the kernel 
+ * copies the messages. 
+ * Single-consumer levels do not support pending receives.
+ *
+ * @param ring Ring set to initialize.
+ * @param entries Number of submission queue entries, a power of two.
+ * @param buf_size Size of the buffer area.
+ * @return 0 if successful, or -1 and errno will be set.
+ */
+static inline int tag_ring_setup(struct tag_ring *ring, unsigned int entries,
+                                 size_t buf_size) {
+    struct tag_ioctl_args args = {{(unsigned long)entries,
+                                   (unsigned long)buf_size}};
+    long area_size;
+    int err;
+    ring->fd = open(TAG_DEVFILE, O_RDWR | O_CLOEXEC);
+    if (ring->fd == -1) return -1;
+    area_size = ioctl(ring->fd, TAG_IOC_RING_SETUP, &args);
+    if (area_size == -1) goto fail;
+    ring->area = (char *)mmap(NULL, (size_t)area_size,
+                              PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (ring->area == MAP_FAILED) goto fail;
+    ring->area_size = (size_t)area_size;
+    ring->hdr = (struct tag_ring_hdr *)ring->area;
+    ring->sqes = (struct tag_sqe *)(ring->area + ring->hdr->sq_off);
+    ring->cqes = (struct tag_cqe *)(ring->area + ring->hdr->cq_off);
+    ring->bufs = ring->area + ring->hdr->buf_off;
+    ring->sqe_tail = ring->hdr->sq_tail;
+    return 0;
+fail:
+    err = errno;
+    close(ring->fd);
+    errno = err;
+    return -1;
+}
+
+/**
+ * @brief Gets the next free submission queue entry, to be filled and then 
+ * submitted with tag_ring_submit.
+ *
+ * @param ring Ring set to operate on.
+ * @return Free submission queue entry, or NULL if the queue is full.
+ */
+static inline struct tag_sqe *tag_ring_get_sqe(struct tag_ring *ring) {
+    unsigned int head = __atomic_load_n(&(ring->hdr->sq_head),
+                                        __ATOMIC_ACQUIRE);
+    if ((ring->sqe_tail - head) == ring->hdr->sq_entries) return NULL;
+    return &(ring->sqes[(ring->sqe_tail++) & (ring->hdr->sq_entries - 1)]);
+}
+
+/**
+ * @brief Submits all filled entries, and waits until at least min_complete 
+ * completions are available.
+ *
+ * @param ring Ring set to operate on.
+ * @param min_complete Number of completions to wait for, may be zero.
+ * @return Number of submitted entries, or -1 and errno will be set.
+ */
+static inline int tag_ring_submit(struct tag_ring *ring,
+                                  unsigned int min_complete) {
+    struct tag_ioctl_args args;
+    __atomic_store_n(&(ring->hdr->sq_tail), ring->sqe_tail, __ATOMIC_RELEASE);
+    args.args[0] = (unsigned long)(ring->sqe_tail - ring->hdr->sq_head);
+    args.args[1] = (unsigned long)min_complete;
+    errno = 0;
+    return ioctl(ring->fd, TAG_IOC_RING_ENTER, &args);
+}
+
+/**
+ * @brief Gets the next available completion, if any, without waiting. 
+ * Once done with it, call tag_ring_cqe_seen.
+ *
+ * @param ring Ring set to operate on.
+ * @return Next completion, or NULL if there is none.
+ */
+static inline struct tag_cqe *tag_ring_peek_cqe(struct tag_ring *ring) {
+    unsigned int head = ring->hdr->cq_head;
+    if (head == __atomic_load_n(&(ring->hdr->cq_tail), __ATOMIC_ACQUIRE))
+        return NULL;
+    return &(ring->cqes[head & (ring->hdr->cq_entries - 1)]);
+}
+
+/**
+ * @brief Marks the completion returned by tag_ring_peek_cqe as reaped, 
+ * making room for a new one.
+ *
+ * @param ring Ring set to operate on.
+ */
+static inline void tag_ring_cqe_seen(struct tag_ring *ring) {
+    __atomic_store_n(&(ring->hdr->cq_head), ring->hdr->cq_head + 1,
+                     __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Destroys a ring set. Pending receives are canceled.
+ *
+ * @param ring Ring set to destroy.
+ */
+static inline void tag_ring_exit(struct tag_ring *ring) {
+    munmap(ring->area, ring->area_size);
+    close(ring->fd);
 }
 
 #endif
@@ -0,0 +1,51 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Runtime switches for debug prints, one static key per subsystem.
+ *        Keys are flipped by the "debug" module parameter, so disabled prints
+ *        cost a single no-op in the code they live in.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef AOS_TAG_DEBUG_H
+#define AOS_TAG_DEBUG_H
+
+#include <linux/jump_label.h>
+
+/* Subsystems with switchable debug prints. */
+#define __TAG_DBG_GET 0   // tag_get.
+#define __TAG_DBG_RCV 1   // tag_receive, tag_call replies included.
+#define __TAG_DBG_SND 2   // tag_send, tag_send_multi, tag_call.
+#define __TAG_DBG_CTL 3   // tag_ctl.
+#define __TAG_DBG_RING 4  // Data plane rings.
+#define __TAG_DBG_NR 5
+
+/* Mask with all subsystems, as accepted by the "debug" parameter. */
+#define __TAG_DBG_ALL ((1U << __TAG_DBG_NR) - 1)
+
+extern struct static_key_false tag_dbg_keys[__TAG_DBG_NR];
+
+/**
+ * @brief Evaluates to true if debug prints of a subsystem are enabled.
+ *
+ * @param sys Subsystem to check.
+ */
+#define TAG_DBG_ON(sys) static_branch_unlikely(&(tag_dbg_keys[sys]))
+
+#endif
@@ -25,10 +25,73 @@
 #define AOS_TAG_DEVDRIVER_H
 
 #include <linux/fs.h>
+#include <linux/mm.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 #define __DRVNAME "aos_tag_dev"
 #define __STAT_DEVFILE "aos_tag_status"
+#define __IO_DEVFILE "aos_tag"
+
+/* Device minor numbers: status device, and data plane device. */
+#define __STAT_MINOR 0
+#define __IO_MINOR 1
+#define __NR_MINORS 2
+
+/**
+ * Data plane ioctl argument. 
+ * Holds the arguments of the corresponding system call, in order, as a 
+ * system call frame would. 
+ * Layout must match that of struct tag_ioctl_args in the userspace header.
+ */
+typedef struct _tag_ioc_args_t {
+    unsigned long args[6];
+} tag_ioc_args_t;
+
+/* Data plane ioctl commands, one for each system call. */
+#define __TAG_IOC_MAGIC 0xA7
+#define __TAG_IOC_GET _IOW(__TAG_IOC_MAGIC, 0, tag_ioc_args_t)
+#define __TAG_IOC_RECEIVE _IOW(__TAG_IOC_MAGIC, 1, tag_ioc_args_t)
+#define __TAG_IOC_SEND _IOW(__TAG_IOC_MAGIC, 2, tag_ioc_args_t)
+#define __TAG_IOC_CTL _IOW(__TAG_IOC_MAGIC, 3, tag_ioc_args_t)
+#define __TAG_IOC_SEND_MULTI _IOW(__TAG_IOC_MAGIC, 4, tag_ioc_args_t)
+#define __TAG_IOC_CALL _IOW(__TAG_IOC_MAGIC, 5, tag_ioc_args_t)
+
+/* Ring ioctl commands: setup (entries, buffer area size), and enter 
+ * (entries to submit, completions to wait for). */
+#define __TAG_IOC_RING_SETUP _IOW(__TAG_IOC_MAGIC, 6, tag_ioc_args_t)
+#define __TAG_IOC_RING_ENTER _IOW(__TAG_IOC_MAGIC, 7, tag_ioc_args_t)
+
+/* Status ioctl command: binary snapshot (version, records buffer, number of 
+ * records, cursor address). */
+#define __TAG_IOC_SNAPSHOT _IOW(__TAG_IOC_MAGIC, 8, tag_ioc_args_t)
+
+/* Status ioctl command: latency histograms reset (tag descriptor). */
+#define __TAG_IOC_HIST_RESET _IOW(__TAG_IOC_MAGIC, 9, tag_ioc_args_t)
+
+/* Status ioctl command: lock contention counters (buffer, number of 
+ * classes). */
+#define __TAG_IOC_LOCK_STATS _IOW(__TAG_IOC_MAGIC, 10, tag_ioc_args_t)
+
+/* Current binary snapshot records layout version. */
+#define __TAG_SNAP_VERSION 1
+
+/**
+ * Binary snapshot record: status of a level of an instance. 
+ * Layout must match that of struct tag_snap_rec in the userspace header.
+ */
+typedef struct _tag_snap_rec_t {
+    int tag;                 // Tag descriptor.
+    int key;                 // Instance key.
+    unsigned int euid;       // Instance creator EUID.
+    unsigned int lvl;        // Level.
+    unsigned long waiting;   // Threads waiting on the level condition.
+    unsigned long filtered;  // Filtered receivers waiting on the level.
+    unsigned long pending;   // Pending ring receives on the level.
+    unsigned long relay;     // Relay destination, or __TAG_RELAY_NONE.
+    unsigned int flags;      // Level modes and topology.
+    unsigned int last_size;  // Size of the cached message, 0 if none.
+} tag_snap_rec_t;
 
 int aos_tag_open(struct inode *inode, struct file *filp);
 int aos_tag_release(struct inode *inode, struct file *filp);
@@ -36,5 +99,6 @@ ssize_t aos_tag_read(struct file *filp, char *buf, size_t size, loff_t *off);
 ssize_t aos_tag_write(struct file *filp, const char *buf, size_t size,
                       loff_t *off);
 long aos_tag_ioctl(struct file *filp, unsigned int cmd, unsigned long param);
+int aos_tag_mmap(struct file *filp, struct vm_area_struct *vma);
 
 #endif
@@ -0,0 +1,41 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief In-kernel API of this module, exported to other GPL modules. 
+ *        Operations behave as the corresponding system calls, but buffers 
+ *        and filters are in kernel space, and errors are returned negated. 
+ *        Callers must be in process context, since these may sleep, and 
+ *        permissions are checked against the current task's credentials.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef AOS_TAG_KAPI_H
+#define AOS_TAG_KAPI_H
+
+#include <linux/types.h>
+
+#include "aos-tag_types.h"
+
+int aos_tag_get(int key, int cmd, int perm);
+int aos_tag_krcv(int tag, tag_lvl_t lvl, void *buf, size_t size, int flags,
+                 const tag_filter_t *flt);
+int aos_tag_ksnd(int tag, tag_lvl_t lvl, const void *buf, size_t size);
+int aos_tag_ctl(int tag, int cmd, int lvl, unsigned long arg);
+
+#endif
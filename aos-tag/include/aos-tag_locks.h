@@ -0,0 +1,287 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Contention accounting for the locks of the module.
+ *        Each acquisition is first tried without waiting: if that fails, the
+ *        acquisition is contended and the time spent waiting is accounted.
+ *        Exclusive holds also account the time spent holding the lock.
+ *        Everything is switched on and off at runtime by the "lock_stats"
+ *        module parameter, and costs a single no-op while off.
+ *        This header must be included before the bitmask one, since it
+ *        redefines the bitmask locking routines.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef AOS_TAG_LOCKS_H
+#define AOS_TAG_LOCKS_H
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/jump_label.h>
+#include <linux/rwsem.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+
+#include "aos-tag.h"
+#include "aos-tag_types.h"
+
+extern struct static_key_false tag_lockstat_key;
+extern tag_lock_stats_t tag_lock_globl[__TAG_LOCK_CLASSES - __TAG_INST_LOCKS];
+extern struct rw_semaphore shared_bst_locks[__TAG_BST_SHARDS];
+extern u64 shared_bst_stamps[__TAG_BST_SHARDS];
+extern u64 tags_mask_stamp;
+extern tag_ptr_t *tags_list;
+extern tag_stats_t *tags_stats;
+
+/**
+ * @brief Evaluates to true if lock contention accounting is enabled.
+ */
+#define TAG_LOCKSTAT_ON() static_branch_unlikely(&tag_lockstat_key)
+
+/**
+ * @brief Evaluate to the contention counters of a class of a descriptor, or
+ * of a global class.
+ *
+ * @param tag Tag descriptor.
+ * @param cls Lock class.
+ */
+#define TAG_LOCK_INST(tag, cls) (&(tags_stats[tag].locks[cls]))
+#define TAG_LOCK_GLOBL(cls) (&(tag_lock_globl[(cls) - __TAG_INST_LOCKS]))
+
+/**
+ * @brief Acquires a lock, accounting the acquisition.
+ * If trying fails the acquisition is contended, and the wait is timed.
+ *
+ * @param stats Contention counters to update.
+ * @param trylock Expression that tries to acquire the lock, true on success.
+ * @param lock Expression that acquires the lock, 0 on success.
+ * @return Result of lock, or 0 if trylock succeeded.
+ */
+#define TAG_LOCK_ACCT(stats, trylock, lock) ({                               \
+    tag_lock_stats_t *__st = (stats);                                        \
+    int __ret = 0;                                                           \
+    if (TAG_LOCKSTAT_ON()) {                                                 \
+        if (!(trylock)) {                                                    \
+            u64 __start = TAG_CLOCK();                                       \
+            __ret = (lock);                                                  \
+            atomic_long_inc(&(__st->contended));                             \
+            atomic_long_add((long)(TAG_CLOCK() - __start),                   \
+                            &(__st->wait_ns));                               \
+        }                                                                    \
+        if (!__ret) atomic_long_inc(&(__st->acquired));                      \
+    } else __ret = (lock);                                                   \
+    __ret; })
+
+/**
+ * @brief Marks the start and the end of an exclusive hold of a lock.
+ * Ends are accounted even if accounting was switched off in the meantime,
+ * so that no stale start is left behind.
+ *
+ * @param stats Contention counters to update.
+ * @param stamp Address of the hold start of the lock.
+ */
+#define TAG_HOLD_START(stamp)                                                \
+    do {                                                                     \
+        if (TAG_LOCKSTAT_ON()) *(stamp) = TAG_CLOCK();                       \
+    } while (0)
+#define TAG_HOLD_END(stats, stamp)                                           \
+    do {                                                                     \
+        u64 __hold = *(stamp);                                               \
+        if (__hold) {                                                        \
+            *(stamp) = 0;                                                    \
+            atomic_long_add((long)(TAG_CLOCK() - __hold),                    \
+                            &((stats)->hold_ns));                            \
+        }                                                                    \
+    } while (0)
+
+/**
+ * @brief Accounted rw_semaphore operations.
+ * Read holds are not timed, since they can last as long as blocking receives.
+ * Return values are those of the corresponding kernel routines.
+ *
+ * @param sem rw_semaphore to operate on.
+ * @param stats Contention counters to update.
+ * @param stamp Address of the write hold start of the rw_semaphore.
+ */
+#define TAG_DOWN_READ_KILLABLE(sem, stats) \
+    TAG_LOCK_ACCT(stats, down_read_trylock(sem), down_read_killable(sem))
+#define TAG_DOWN_READ(sem, stats) \
+    ((void)TAG_LOCK_ACCT(stats, down_read_trylock(sem), (down_read(sem), 0)))
+#define TAG_DOWN_READ_TRYLOCK(sem, stats) ({                                 \
+    int __ok = down_read_trylock(sem);                                       \
+    if (__ok && TAG_LOCKSTAT_ON()) atomic_long_inc(&((stats)->acquired));    \
+    __ok; })
+#define TAG_DOWN_WRITE_KILLABLE(sem, stats, stamp) ({                        \
+    int __wret = TAG_LOCK_ACCT(stats, down_write_trylock(sem),               \
+                               down_write_killable(sem));                    \
+    if (!__wret) TAG_HOLD_START(stamp);                                      \
+    __wret; })
+#define TAG_DOWN_WRITE(sem, stats, stamp)                                    \
+    do {                                                                     \
+        (void)TAG_LOCK_ACCT(stats, down_write_trylock(sem),                  \
+                            (down_write(sem), 0));                           \
+        TAG_HOLD_START(stamp);                                               \
+    } while (0)
+#define TAG_DOWN_WRITE_TRYLOCK(sem, stats, stamp) ({                         \
+    int __ok = down_write_trylock(sem);                                      \
+    if (__ok && TAG_LOCKSTAT_ON()) {                                         \
+        atomic_long_inc(&((stats)->acquired));                               \
+        TAG_HOLD_START(stamp);                                               \
+    }                                                                        \
+    __ok; })
+#define TAG_UP_WRITE(sem, stats, stamp)                                      \
+    do {                                                                     \
+        TAG_HOLD_END(stats, stamp);                                          \
+        up_write(sem);                                                       \
+    } while (0)
+
+/**
+ * @brief Accounted mutex operations.
+ * Return values are those of the corresponding kernel routines.
+ *
+ * @param mtx Mutex to operate on.
+ * @param stats Contention counters to update.
+ * @param stamp Address of the hold start of the mutex.
+ */
+#define TAG_MUTEX_LOCK_INTR(mtx, stats, stamp) ({                            \
+    int __mret = TAG_LOCK_ACCT(stats, mutex_trylock(mtx),                    \
+                               mutex_lock_interruptible(mtx));               \
+    if (!__mret) TAG_HOLD_START(stamp);                                      \
+    __mret; })
+#define TAG_MUTEX_LOCK(mtx, stats, stamp)                                    \
+    do {                                                                     \
+        (void)TAG_LOCK_ACCT(stats, mutex_trylock(mtx),                       \
+                            (mutex_lock(mtx), 0));                           \
+        TAG_HOLD_START(stamp);                                               \
+    } while (0)
+#define TAG_MUTEX_TRYLOCK(mtx, stats, stamp) ({                              \
+    int __ok = mutex_trylock(mtx);                                           \
+    if (__ok && TAG_LOCKSTAT_ON()) {                                         \
+        atomic_long_inc(&((stats)->acquired));                               \
+        TAG_HOLD_START(stamp);                                               \
+    }                                                                        \
+    __ok; })
+#define TAG_MUTEX_UNLOCK(mtx, stats, stamp)                                  \
+    do {                                                                     \
+        TAG_HOLD_END(stats, stamp);                                          \
+        mutex_unlock(mtx);                                                   \
+    } while (0)
+
+/**
+ * @brief Accounted operations on the rw_semaphores of a descriptor.
+ *
+ * @param tag Tag descriptor.
+ */
+#define TAG_RCV_DOWN_READ(tag)                                               \
+    TAG_DOWN_READ_KILLABLE(&(tags_list[tag].rcv_rwsem),                      \
+                           TAG_LOCK_INST(tag, __TAG_LOCK_RCV))
+#define TAG_SND_DOWN_READ(tag)                                               \
+    TAG_DOWN_READ_KILLABLE(&(tags_list[tag].snd_rwsem),                      \
+                           TAG_LOCK_INST(tag, __TAG_LOCK_SND))
+#define TAG_RCV_DOWN_WRITE(tag)                                              \
+    TAG_DOWN_WRITE_KILLABLE(&(tags_list[tag].rcv_rwsem),                     \
+                            TAG_LOCK_INST(tag, __TAG_LOCK_RCV),              \
+                            &(tags_list[tag].rcv_stamp))
+#define TAG_SND_DOWN_WRITE(tag)                                              \
+    TAG_DOWN_WRITE_KILLABLE(&(tags_list[tag].snd_rwsem),                     \
+                            TAG_LOCK_INST(tag, __TAG_LOCK_SND),              \
+                            &(tags_list[tag].snd_stamp))
+#define TAG_RCV_UP_WRITE(tag)                                                \
+    TAG_UP_WRITE(&(tags_list[tag].rcv_rwsem),                                \
+                 TAG_LOCK_INST(tag, __TAG_LOCK_RCV),                         \
+                 &(tags_list[tag].rcv_stamp))
+#define TAG_SND_UP_WRITE(tag)                                                \
+    TAG_UP_WRITE(&(tags_list[tag].snd_rwsem),                                \
+                 TAG_LOCK_INST(tag, __TAG_LOCK_SND),                         \
+                 &(tags_list[tag].snd_stamp))
+
+/**
+ * @brief Accounted operations on the senders mutex of a level of an instance.
+ *
+ * @param tag_inst Instance structure.
+ * @param lvl Dense level.
+ */
+#define TAG_SNDL_LOCK(tag_inst, lvl)                                         \
+    TAG_MUTEX_LOCK_INTR(&(((tag_inst)->snd_locks)[lvl]),                     \
+                        &((tag_inst)->stats->locks[__TAG_LOCK_SNDL]),       \
+                        &(((tag_inst)->snd_lock_stamps)[lvl]))
+#define TAG_SNDL_TRYLOCK(tag_inst, lvl)                                      \
+    TAG_MUTEX_TRYLOCK(&(((tag_inst)->snd_locks)[lvl]),                       \
+                      &((tag_inst)->stats->locks[__TAG_LOCK_SNDL]),         \
+                      &(((tag_inst)->snd_lock_stamps)[lvl]))
+#define TAG_SNDL_UNLOCK(tag_inst, lvl)                                       \
+    TAG_MUTEX_UNLOCK(&(((tag_inst)->snd_locks)[lvl]),                        \
+                     &((tag_inst)->stats->locks[__TAG_LOCK_SNDL]),          \
+                     &(((tag_inst)->snd_lock_stamps)[lvl]))
+
+/**
+ * @brief Accounted operations on the AWAKE_ALL mutex of an instance.
+ *
+ * @param tag_inst Instance structure.
+ */
+#define TAG_AWAKE_LOCK(tag_inst)                                             \
+    TAG_MUTEX_LOCK_INTR(&((tag_inst)->awake_all_lock),                       \
+                        &((tag_inst)->stats->locks[__TAG_LOCK_AWAKE]),       \
+                        &((tag_inst)->awake_all_stamp))
+#define TAG_AWAKE_UNLOCK(tag_inst)                                           \
+    TAG_MUTEX_UNLOCK(&((tag_inst)->awake_all_lock),                          \
+                     &((tag_inst)->stats->locks[__TAG_LOCK_AWAKE]),          \
+                     &((tag_inst)->awake_all_stamp))
+
+/**
+ * @brief Accounted operations on a shard of the BST dictionary.
+ *
+ * @param shard Index of the shard.
+ */
+#define TAG_BST_DOWN_READ(shard)                                             \
+    TAG_DOWN_READ_KILLABLE(&(shared_bst_locks[shard]),                       \
+                           TAG_LOCK_GLOBL(__TAG_LOCK_BST))
+#define TAG_BST_DOWN_WRITE_KILLABLE(shard)                                   \
+    TAG_DOWN_WRITE_KILLABLE(&(shared_bst_locks[shard]),                      \
+                            TAG_LOCK_GLOBL(__TAG_LOCK_BST),                  \
+                            &(shared_bst_stamps[shard]))
+#define TAG_BST_DOWN_WRITE(shard)                                            \
+    TAG_DOWN_WRITE(&(shared_bst_locks[shard]),                               \
+                   TAG_LOCK_GLOBL(__TAG_LOCK_BST),                           \
+                   &(shared_bst_stamps[shard]))
+#define TAG_BST_UP_WRITE(shard)                                              \
+    TAG_UP_WRITE(&(shared_bst_locks[shard]),                                 \
+                 TAG_LOCK_GLOBL(__TAG_LOCK_BST),                             \
+                 &(shared_bst_stamps[shard]))
+
+/**
+ * @brief Accounted locking routines for the instances bitmask, used by the
+ * bitmask macros instead of the plain ones.
+ *
+ * @param tag_mask Address of the bitmask.
+ */
+#define TAG_MASK_LOCK(tag_mask)                                              \
+    do {                                                                     \
+        (void)TAG_LOCK_ACCT(TAG_LOCK_GLOBL(__TAG_LOCK_MASK),                 \
+                            spin_trylock(&((tag_mask)->_lock)),              \
+                            (spin_lock(&((tag_mask)->_lock)), 0));           \
+        TAG_HOLD_START(&tags_mask_stamp);                                    \
+    } while (0)
+#define TAG_MASK_UNLOCK(tag_mask)                                            \
+    do {                                                                     \
+        TAG_HOLD_END(TAG_LOCK_GLOBL(__TAG_LOCK_MASK), &tags_mask_stamp);     \
+        spin_unlock(&((tag_mask)->_lock));                                   \
+    } while (0)
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Definitions of the submission/completion rings of the data plane 
+ * device.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef AOS_TAG_RINGS_H
+#define AOS_TAG_RINGS_H
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/cred.h>
+#include <linux/version.h>
+
+#include "aos-tag_types.h"
+
+/* Maximum number of submission queue entries, and of buffer area size. */
+#define __TAG_RING_MAX_ENTRIES 4096
+#define __TAG_RING_MAX_BUF (64UL << 20)
+
+/* Marks operations that will be completed later, by someone else. */
+#define __TAG_RING_QUEUED 1
+
+/* VMA flags became write-protected in 6.3, behind accessors. */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+#define TAG_VM_FLAGS_SET(vma, flags) ((vma)->vm_flags |= (flags))
+#define TAG_VM_FLAGS_CLEAR(vma, flags) ((vma)->vm_flags &= ~(flags))
+#else
+#define TAG_VM_FLAGS_SET(vma, flags) vm_flags_set((vma), (flags))
+#define TAG_VM_FLAGS_CLEAR(vma, flags) vm_flags_clear((vma), (flags))
+#endif
+
+/**
+ * Header of the shared area. 
+ * Each index is written only by one side: the other one just reads it. 
+ * Layout must match that of struct tag_ring_hdr in the userspace header.
+ */
+typedef struct _tag_ring_hdr_t {
+    unsigned int sq_head;     // Next entry to consume (kernel).
+    unsigned int sq_tail;     // Next entry to fill (userspace).
+    unsigned int cq_head;     // Next completion to reap (userspace).
+    unsigned int cq_tail;     // Next completion to post (kernel).
+    unsigned int sq_entries;  // Number of submission queue entries.
+    unsigned int cq_entries;  // Number of completion queue entries.
+    unsigned long sq_off;     // Offset of the submission queue in the area.
+    unsigned long cq_off;     // Offset of the completion queue in the area.
+    unsigned long buf_off;    // Offset of the buffer area in the area.
+    unsigned long buf_size;   // Size of the buffer area.
+} tag_ring_hdr_t;
+
+/**
+ * Submission queue entry. 
+ * Layout must match that of struct tag_sqe in the userspace header.
+ */
+typedef struct _tag_sqe_t {
+    unsigned long user_data;  // Returned as is in the completion.
+    int op;                   // Operation to perform.
+    int tag;                  // Tag descriptor of the instance.
+    int lvl;                  // Level of the instance.
+    int flags;                // Receive flags, or tag_ctl command.
+    unsigned long addr;       // Message buffer, or tag_ctl argument.
+    unsigned long size;       // Size of the aforementioned buffer.
+} tag_sqe_t;
+
+/**
+ * Completion queue entry. 
+ * Layout must match that of struct tag_cqe in the userspace header.
+ */
+typedef struct _tag_cqe_t {
+    unsigned long user_data;  // From the submission queue entry.
+    long res;                 // Result of the operation, as for the syscall.
+} tag_cqe_t;
+
+/**
+ * Ring set, one for each data plane session that asks for it. 
+ * The shared area holds the header, the two queues and the buffer area, in 
+ * this order. 
+ * Indexes owned by the kernel are kept here too, so that userspace can't 
+ * corrupt them.
+ */
+typedef struct _tag_ring_t {
+    char *area;                   // Shared area.
+    size_t area_size;             // Size of the shared area.
+    tag_ring_hdr_t *hdr;          // Header, in the shared area.
+    tag_sqe_t *sqes;              // Submission queue, in the shared area.
+    tag_cqe_t *cqes;              // Completion queue, in the shared area.
+    unsigned int sq_head;         // Private copy of the submission queue head.
+    unsigned int cq_tail;         // Private copy of the completion queue tail.
+    unsigned long uaddr;          // Where the area is mapped, 0 if it is not.
+    struct mutex sq_lock;         // Lock for submitters.
+    spinlock_t cq_lock;           // Lock for the completion queue and below.
+    struct list_head pending;     // Pending receives.
+    unsigned int nr_pending;      // Number of pending receives.
+    struct list_head sends;       // Queued sends, in submission order.
+    unsigned int nr_sends;        // Number of queued or running sends.
+    struct work_struct snd_work;  // Carries out queued sends.
+    wait_queue_head_t cq_wait;    // Wait queue for completions.
+} tag_ring_t;
+
+/**
+ * Pending receive. 
+ * Linked both in the list of the level it waits on, and in the list of its 
+ * ring: senders find it in the former, ring owners in the latter.
+ */
+typedef struct _tag_ring_rcv_t {
+    struct list_head lvl_node;   // Node in the level list.
+    struct list_head ring_node;  // Node in the ring list.
+    tag_ring_t *ring;            // Ring to post the completion on.
+    unsigned long user_data;     // From the submission queue entry.
+    unsigned long off;           // Offset of the buffer in the shared area.
+    size_t size;                 // Size of the aforementioned buffer.
+    int tag;                     // Tag descriptor of the instance.
+    int lvl;                     // Level of the instance.
+} tag_ring_rcv_t;
+
+/**
+ * Queued send. 
+ * The message is copied in kernel space at submission, so that the send can be 
+ * carried out later, on behalf of the submitter, by the ring's work.
+ */
+typedef struct _tag_ring_snd_t {
+    struct list_head node;    // Node in the ring list.
+    const struct cred *cred;  // Credentials of the submitter.
+    tag_msg_t *msg;           // Message to send, or NULL for zero-length ones.
+    size_t size;              // Size of the aforementioned message.
+    unsigned long user_data;  // From the submission queue entry.
+    int tag;                  // Tag descriptor of the instance.
+    int lvl;                  // Level of the instance.
+} tag_ring_snd_t;
+
+long aos_tag_ring_setup(struct file *filp, unsigned int entries,
+                        size_t buf_size);
+int aos_tag_ring_mmap(tag_ring_t *ring, struct vm_area_struct *vma);
+long aos_tag_ring_enter(tag_ring_t *ring, unsigned int to_submit,
+                        unsigned int min_complete);
+void aos_tag_ring_release(tag_ring_t *ring);
+
+int aos_tag_ring_deliver(tag_t *tag_inst, int lvl, tag_msg_t *msg,
+                         size_t size);
+void aos_tag_ring_cancel(tag_t *tag_inst, int lvl, tag_ring_t *ring,
+                         long res);
+
+#endif
@@ -28,9 +28,18 @@
 
 #include <linux/types.h>
 
-int aos_tag_get(int key, int cmd, int perm);
-int aos_tag_rcv(int tag, int lvl, char *buf, size_t size);
-int aos_tag_snd(int tag, int lvl, char *buf, size_t size);
-int aos_tag_ctl(int tag, int cmd);
+#include "aos-tag_types.h"
+#include "aos-tag_kapi.h"
+
+int aos_tag_rcv(int tag, tag_lvl_t lvl, char *buf, size_t size, int flags,
+                tag_filter_t *flt);
+int aos_tag_snd(int tag, tag_lvl_t lvl, char *buf, size_t size);
+int aos_tag_snd_msg(int tag, tag_lvl_t lvl, tag_msg_t *msg, size_t size);
+int aos_tag_snd_multi(tag_target_t *targets, unsigned int nr_targets,
+                      char *buf, size_t size);
+int aos_tag_call(int tag, int lvl, int rpl_lvl, char *buf, size_t size,
+                 size_t rpl_size);
+
+void aos_tag_awake_all(tag_t *tag_inst);
 
 #endif
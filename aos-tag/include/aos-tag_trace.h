@@ -0,0 +1,216 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Tracepoints of this module, in the aos_tag trace system. 
+ *        Defined in aos-tag_main.c, which includes this with 
+ *        CREATE_TRACE_POINTS, and cost a static branch each when disabled.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM aos_tag
+
+#if !defined(AOS_TAG_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define AOS_TAG_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/* tag_get entry: key, command and permission, as given. */
+TRACE_EVENT(tag_get_enter,
+    TP_PROTO(int key, int cmd, int perm),
+    TP_ARGS(key, cmd, perm),
+    TP_STRUCT__entry(
+        __field(int, key)
+        __field(int, cmd)
+        __field(int, perm)
+    ),
+    TP_fast_assign(
+        __entry->key = key;
+        __entry->cmd = cmd;
+        __entry->perm = perm;
+    ),
+    TP_printk("key=%d cmd=%d perm=0x%x",
+              __entry->key, __entry->cmd, __entry->perm)
+);
+
+/* tag_get exit: key, and tag descriptor or error code. */
+TRACE_EVENT(tag_get_exit,
+    TP_PROTO(int key, int ret),
+    TP_ARGS(key, ret),
+    TP_STRUCT__entry(
+        __field(int, key)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->key = key;
+        __entry->ret = ret;
+    ),
+    TP_printk("key=%d ret=%d", __entry->key, __entry->ret)
+);
+
+/* Operation on a level entry: tag, level, buffer size, and flags. */
+DECLARE_EVENT_CLASS(tag_lvl_enter,
+    TP_PROTO(int tag, unsigned long lvl, size_t size, int flags),
+    TP_ARGS(tag, lvl, size, flags),
+    TP_STRUCT__entry(
+        __field(int, tag)
+        __field(unsigned long, lvl)
+        __field(size_t, size)
+        __field(int, flags)
+    ),
+    TP_fast_assign(
+        __entry->tag = tag;
+        __entry->lvl = lvl;
+        __entry->size = size;
+        __entry->flags = flags;
+    ),
+    TP_printk("tag=%d lvl=%lu size=%zu flags=0x%x",
+              __entry->tag, __entry->lvl, __entry->size, __entry->flags)
+);
+
+DEFINE_EVENT(tag_lvl_enter, tag_rcv_enter,
+    TP_PROTO(int tag, unsigned long lvl, size_t size, int flags),
+    TP_ARGS(tag, lvl, size, flags)
+);
+
+DEFINE_EVENT(tag_lvl_enter, tag_snd_enter,
+    TP_PROTO(int tag, unsigned long lvl, size_t size, int flags),
+    TP_ARGS(tag, lvl, size, flags)
+);
+
+/* Operation on a level exit: tag, level, and result. */
+DECLARE_EVENT_CLASS(tag_lvl_exit,
+    TP_PROTO(int tag, unsigned long lvl, int ret),
+    TP_ARGS(tag, lvl, ret),
+    TP_STRUCT__entry(
+        __field(int, tag)
+        __field(unsigned long, lvl)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->tag = tag;
+        __entry->lvl = lvl;
+        __entry->ret = ret;
+    ),
+    TP_printk("tag=%d lvl=%lu ret=%d",
+              __entry->tag, __entry->lvl, __entry->ret)
+);
+
+DEFINE_EVENT(tag_lvl_exit, tag_rcv_exit,
+    TP_PROTO(int tag, unsigned long lvl, int ret),
+    TP_ARGS(tag, lvl, ret)
+);
+
+DEFINE_EVENT(tag_lvl_exit, tag_snd_exit,
+    TP_PROTO(int tag, unsigned long lvl, int ret),
+    TP_ARGS(tag, lvl, ret)
+);
+
+/* tag_ctl entry: tag, command, level, and argument. */
+TRACE_EVENT(tag_ctl_enter,
+    TP_PROTO(int tag, int cmd, int lvl, unsigned long arg),
+    TP_ARGS(tag, cmd, lvl, arg),
+    TP_STRUCT__entry(
+        __field(int, tag)
+        __field(int, cmd)
+        __field(int, lvl)
+        __field(unsigned long, arg)
+    ),
+    TP_fast_assign(
+        __entry->tag = tag;
+        __entry->cmd = cmd;
+        __entry->lvl = lvl;
+        __entry->arg = arg;
+    ),
+    TP_printk("tag=%d cmd=%d lvl=%d arg=0x%lx",
+              __entry->tag, __entry->cmd, __entry->lvl, __entry->arg)
+);
+
+/* tag_ctl exit: tag, command, and result. */
+TRACE_EVENT(tag_ctl_exit,
+    TP_PROTO(int tag, int cmd, int ret),
+    TP_ARGS(tag, cmd, ret),
+    TP_STRUCT__entry(
+        __field(int, tag)
+        __field(int, cmd)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->tag = tag;
+        __entry->cmd = cmd;
+        __entry->ret = ret;
+    ),
+    TP_printk("tag=%d cmd=%d ret=%d",
+              __entry->tag, __entry->cmd, __entry->ret)
+);
+
+/* Delivery points: tag, level, epoch, message size, and a value that depends 
+ * on the point: waiting receivers at the flip, receivers woken up, or 
+ * nanoseconds spent draining. */
+DECLARE_EVENT_CLASS(tag_dlv,
+    TP_PROTO(int tag, int lvl, unsigned char epoch, size_t size,
+             unsigned long val),
+    TP_ARGS(tag, lvl, epoch, size, val),
+    TP_STRUCT__entry(
+        __field(int, tag)
+        __field(int, lvl)
+        __field(unsigned char, epoch)
+        __field(size_t, size)
+        __field(unsigned long, val)
+    ),
+    TP_fast_assign(
+        __entry->tag = tag;
+        __entry->lvl = lvl;
+        __entry->epoch = epoch;
+        __entry->size = size;
+        __entry->val = val;
+    ),
+    TP_printk("tag=%d lvl=%d epoch=%u size=%zu val=%lu",
+              __entry->tag, __entry->lvl, (unsigned int)__entry->epoch,
+              __entry->size, __entry->val)
+);
+
+DEFINE_EVENT(tag_dlv, tag_flip,
+    TP_PROTO(int tag, int lvl, unsigned char epoch, size_t size,
+             unsigned long val),
+    TP_ARGS(tag, lvl, epoch, size, val)
+);
+
+DEFINE_EVENT(tag_dlv, tag_wakeup,
+    TP_PROTO(int tag, int lvl, unsigned char epoch, size_t size,
+             unsigned long val),
+    TP_ARGS(tag, lvl, epoch, size, val)
+);
+
+DEFINE_EVENT(tag_dlv, tag_drain,
+    TP_PROTO(int tag, int lvl, unsigned char epoch, size_t size,
+             unsigned long val),
+    TP_ARGS(tag, lvl, epoch, size, val)
+);
+
+#endif
+
+/* Out of the kernel tree: the build adds this directory to the include path. */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE aos-tag_trace
+
+#include <trace/define_trace.h>
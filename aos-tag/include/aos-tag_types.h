@@ -29,9 +29,110 @@
 #include <linux/mutex.h>
 #include <linux/cred.h>
 #include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/eventfd.h>
+#include <linux/hash.h>
+#include <linux/atomic.h>
+#include <linux/mm.h>
+#include <linux/timekeeping.h>
+#include <linux/bitops.h>
 
 #include "aos-tag.h"
 #include "../utils/aos-tag_conditions.h"
+#include "../utils/aos-tag_messages.h"
+
+/**
+ * Level identifier. 
+ * Levels below __NR_LEVELS are dense, and live in the per-level arrays of the 
+ * instance structure. Those tagged with __TAG_SPARSE_BIT are sparse, and are 
+ * created on demand. All others are invalid.
+ */
+typedef unsigned long tag_lvl_t;
+
+/**
+ * @brief Tells whether a level identifier names a sparse level.
+ *
+ * @param lvl Level identifier.
+ * @return Nonzero if it does, 0 otherwise.
+ */
+#define TAG_LVL_SPARSE(lvl) \
+    (((lvl) & ~__TAG_SPARSE_MASK) == __TAG_SPARSE_BIT)
+
+/**
+ * @brief Tells whether a level identifier names a level at all.
+ *
+ * @param lvl Level identifier.
+ * @return Nonzero if it does, 0 otherwise.
+ */
+#define TAG_LVL_VALID(lvl) (((lvl) < __NR_LEVELS) || TAG_LVL_SPARSE(lvl))
+
+/**
+ * Sparse level. 
+ * Exists only while some receiver is waiting on it, in a bucket of its 
+ * instance.
+ */
+typedef struct _tag_topic_t {
+    struct hlist_node node;  // Node in the bucket.
+    tag_lvl_t id;            // Level identifier.
+    struct list_head rcvs;   // Filtered receivers waiting on this level.
+} tag_topic_t;
+
+/**
+ * Sparse levels bucket.
+ */
+typedef struct _tag_topic_bkt_t {
+    struct hlist_head head;  // Sparse levels in this bucket.
+    spinlock_t lock;         // Lock for the above, and their receivers.
+} tag_topic_bkt_t;
+
+/**
+ * Traffic counters of a level. 
+ * Updated with relaxed atomic increments, and read from user space through a 
+ * read-only mapping. 
+ * Layout must match that of struct tag_lvl_stats in the userspace header.
+ */
+typedef struct _tag_lvl_stats_t {
+    atomic_long_t sends;       // Messages sent.
+    atomic_long_t deliveries;  // Messages delivered to some receiver.
+    atomic_long_t discards;    // Messages no one was waiting for.
+    atomic_long_t bytes;       // Bytes sent.
+    atomic_long_t wakeups;     // Receivers that got a message.
+    atomic_long_t errors;      // Receives that failed.
+} tag_lvl_stats_t;
+
+/**
+ * Latency histograms of a level, in nanoseconds, with log2 buckets. 
+ * Layout must match that of struct tag_lvl_hists in the userspace header.
+ */
+typedef struct _tag_lvl_hists_t {
+    atomic_t wakeup[__TAG_HIST_BUCKETS];  // From send to receiver return.
+    atomic_t copy[__TAG_HIST_BUCKETS];    // Receiver copy time.
+    atomic_t drain[__TAG_HIST_BUCKETS];   // Sender wait for receivers.
+} tag_lvl_hists_t;
+
+/**
+ * Contention counters of a lock class. 
+ * Hold times are only accounted for exclusive holds. 
+ * Layout must match that of struct tag_lock_stats in the userspace header.
+ */
+typedef struct _tag_lock_stats_t {
+    atomic_long_t acquired;   // Successful acquisitions.
+    atomic_long_t contended;  // Acquisitions that had to wait.
+    atomic_long_t wait_ns;    // Time spent waiting, in nanoseconds.
+    atomic_long_t hold_ns;    // Time spent holding, in nanoseconds.
+} tag_lock_stats_t;
+
+/**
+ * Traffic counters of a tag descriptor, reset when a new instance takes it. 
+ * Layout must match that of struct tag_stats in the userspace header.
+ */
+typedef struct _tag_stats_t {
+    atomic_long_t gen;                         // Instances created on it.
+    tag_lvl_stats_t lvls[__NR_LEVELS];         // Counters of dense levels.
+    tag_lvl_hists_t hists[__NR_LEVELS];        // Histograms of dense levels.
+    tag_lock_stats_t locks[__TAG_INST_LOCKS];  // Contention on its locks.
+} tag_stats_t;
 
 /** 
  * Instance structure.
@@ -39,6 +140,7 @@
  */
 typedef struct _tag_t {
     int key;                                       // Instance key.
+    int tag;                                       // Tag descriptor.
     char *msg_bufs[__NR_LEVELS];                   // Pointers to messages.
     size_t msg_sizes[__NR_LEVELS];                 // Sizes of active messages.
     struct mutex snd_locks[__NR_LEVELS];           // Locks for senders.
@@ -48,6 +150,21 @@ typedef struct _tag_t {
     char perm_check;                               // Enables permissions check.
     struct mutex awake_all_lock;                   // Lock for AWAKE_ALL.
     tag_cond_t globl_cond;                         // AWAKE_ALL condition.
+    unsigned char lvl_flags[__NR_LEVELS];          // Level operating modes.
+    tag_msg_t *last_msgs[__NR_LEVELS];             // Cached last messages.
+    tag_msg_t *next_msgs[__NR_LEVELS];             // Pending conflated messages.
+    spinlock_t msg_locks[__NR_LEVELS];             // Locks for the above.
+    unsigned char snd_excl[__NR_LEVELS];           // Single producers flags.
+    unsigned char rcv_excl[__NR_LEVELS];           // Single consumers flags.
+    struct list_head ring_rcvs[__NR_LEVELS];       // Pending ring receives.
+    struct eventfd_ctx *lvl_evfds[__NR_LEVELS];    // Level notification hooks.
+    struct list_head flt_rcvs[__NR_LEVELS];        // Filtered receivers.
+    tag_topic_bkt_t topics[__TAG_TOPIC_BKTS];      // Sparse levels.
+    unsigned long relays[__NR_LEVELS];             // Relay destinations.
+    u64 snd_stamps[__NR_LEVELS];                   // Delivery start times.
+    u64 snd_lock_stamps[__NR_LEVELS];              // Senders locks hold starts.
+    u64 awake_all_stamp;                           // AWAKE_ALL hold start.
+    tag_stats_t *stats;                            // Traffic counters.
 } tag_t;
 
 /**
@@ -58,6 +175,106 @@ typedef struct _tag_ptr_t {
     tag_t *ptr;                      // Pointer to the corresponding instance.
     struct rw_semaphore rcv_rwsem;   // For receivers as readers.
     struct rw_semaphore snd_rwsem;   // For senders as readers.
+    u64 rcv_stamp;                   // Receivers rw_semaphore write hold start.
+    u64 snd_stamp;                   // Senders rw_semaphore write hold start.
 } tag_ptr_t;
 
+/**
+ * @brief Evaluates to the bucket of an instance that holds a sparse level.
+ *
+ * @param tag_inst Instance to look into.
+ * @param lvl Sparse level identifier.
+ * @return Address of the bucket.
+ */
+#define TAG_TOPIC_BKT(tag_inst, lvl) \
+    (&(((tag_inst)->topics)[hash_64((u64)(lvl), __TAG_TOPIC_BITS)]))
+
+/**
+ * @brief Evaluates to the size of the traffic counters area.
+ *
+ * @param nr_tags Number of tag descriptors.
+ * @return Size of the area, a multiple of the page size.
+ */
+#define TAG_STATS_SZ(nr_tags) PAGE_ALIGN((nr_tags) * sizeof(tag_stats_t))
+
+/**
+ * @brief Update a traffic counter of a level of an instance.
+ *
+ * @param tag_inst Instance to account to.
+ * @param lvl Dense level of the instance.
+ * @param cnt Counter to update.
+ * @param n Amount to add.
+ */
+#define TAG_STAT_INC(tag_inst, lvl, cnt) \
+    atomic_long_inc(&((tag_inst)->stats->lvls[lvl].cnt))
+#define TAG_STAT_ADD(tag_inst, lvl, cnt, n) \
+    atomic_long_add((long)(n), &((tag_inst)->stats->lvls[lvl].cnt))
+
+/**
+ * @brief Cheap monotonic clock for latency histograms, in nanoseconds.
+ */
+#define TAG_CLOCK() ktime_get_mono_fast_ns()
+
+/**
+ * @brief Records a latency in a histogram of a level of an instance.
+ *
+ * @param tag_inst Instance to account to.
+ * @param lvl Dense level of the instance.
+ * @param hist Histogram to update.
+ * @param ns Latency, in nanoseconds.
+ */
+#define TAG_HIST_ADD(tag_inst, lvl, hist, ns) \
+    atomic_inc(&((tag_inst)->stats->hists[lvl].hist[                  \
+        min_t(int, fls64((u64)(ns)), __TAG_HIST_BUCKETS - 1)]))
+
+/**
+ * @brief Evaluates to the shard of the BST dictionary that holds a key.
+ *
+ * @param key Shared instance key.
+ * @return Index of the shard.
+ */
+#define TAG_BST_SHARD(key) (hash_32((u32)(key), __TAG_BST_SHARD_BITS))
+
+/**
+ * @brief Evaluate to the tag descriptor and level of a relay destination.
+ *
+ * @param dst Relay destination.
+ * @return Tag descriptor, or level.
+ */
+#define TAG_RELAY_TAG(dst) ((int)((dst) >> __TAG_RELAY_SHIFT))
+#define TAG_RELAY_LVL(dst) ((int)((dst) & __TAG_RELAY_MASK))
+
+/**
+ * Receive filter. 
+ * Layout must match that of struct tag_filter in the userspace header.
+ */
+typedef struct _tag_filter_t {
+    unsigned char mask[__TAG_FLT_LEN];   // Bits of the prefix to look at.
+    unsigned char value[__TAG_FLT_LEN];  // Values those bits must have.
+} tag_filter_t;
+
+/**
+ * Filtered receiver, waiting on a level. 
+ * Lives on the stack of the receiver: senders complete it, and wake it up, 
+ * while holding the level spinlock, which the receiver takes before leaving.
+ */
+typedef struct _tag_flt_rcv_t {
+    struct list_head node;     // Node in the level list.
+    u64 mask;                  // Filter mask, as a word.
+    u64 value;                 // Filter value, as a word, already masked.
+    struct task_struct *task;  // Receiver thread.
+    tag_msg_t *msg;            // Message, with a reference for the receiver.
+    int res;                   // 0 while waiting, 1 if completed, or -errno.
+} tag_flt_rcv_t;
+
+/**
+ * Fan-out send target.
+ * Layout must match that of struct tag_target in the userspace header.
+ */
+typedef struct _tag_target_t {
+    int tag;  // Tag descriptor of the target instance.
+    int lvl;  // Level of the target instance.
+    int res;  // Outcome of the delivery on this target.
+} tag_target_t;
+
 #endif
@@ -27,6 +27,8 @@
 #include <linux/slab.h>
 #include <linux/mutex.h>
 #include <linux/compiler.h>
+#include <linux/moduleparam.h>
+#include <linux/jump_label.h>
 
 #include "utils/x86_utils.h"
 #include "utils/paging_navigator.h"
@@ -34,9 +36,6 @@
 
 #define MODNAME "SCTH"
 
-#define __PAGE_SIZE 4096
-#define __PAGE_MASK 0xfffffffffffff000ULL
-
 /**
  * Virtual kernel memory addresses at which the search starts and ends.
  * Note that this search covers 4 GiB of the kernel virtual address space,
@@ -84,6 +83,35 @@ module_param(nr_sysnis, int, S_IRUGO);
 MODULE_PARM_DESC(nr_sysnis, "Number of hackable entries in the "
                  "syscall table.");
 
+/**
+ * @brief Sets the debug switch, flipping the paging navigator's key.
+ *
+ * @param val New value, as written by the user.
+ * @param kp Parameter to set.
+ * @return 0 if all went well, or an error code.
+ */
+static int scth_dbg_set(const char *val, const struct kernel_param *kp) {
+    int ret = param_set_bool(val, kp);
+    if (ret) return ret;
+    if (*((bool *)kp->arg)) static_branch_enable(&pn_dbg_key);
+    else static_branch_disable(&pn_dbg_key);
+    return 0;
+}
+
+static const struct kernel_param_ops scth_dbg_ops = {
+    .set = scth_dbg_set,
+    .get = param_get_bool,
+};
+
+/* Debug prints switch, can be flipped at runtime. */
+#ifdef DEBUG
+bool scth_debug = true;
+#else
+bool scth_debug = false;
+#endif
+module_param_cb(debug, &scth_dbg_ops, &scth_debug, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(debug, "Enables debug prints.");
+
 extern struct mutex scth_lock;
 
 /**
@@ -148,7 +176,7 @@ int scth_hack(void *new_call_addr) {
     mutex_unlock(&scth_lock);
     return -1;
 }
-EXPORT_SYMBOL(scth_hack);
+EXPORT_SYMBOL_GPL(scth_hack);
 
 /**
  * @brief Restores an entry in the table.
@@ -180,7 +208,7 @@ void scth_unhack(int to_restore) {
     }
     mutex_unlock(&scth_lock);
 }
-EXPORT_SYMBOL(scth_unhack);
+EXPORT_SYMBOL_GPL(scth_unhack);
 
 /**
  * @brief Scans the system call table and determines which entries can be 
@@ -240,33 +268,41 @@ int scth_prev_area_check(void **addr) {
 }
 
 /**
- * @brief Checks whether a given page could contain (part of) the system call 
- * table, performing a linear pattern matching scan. Returns the table base 
- * address, if found.
+ * @brief Checks whether a run of mapped pages could contain the system call 
+ * table, performing a linear pattern matching scan. Stores the table base 
+ * address, if found. 
+ * Since the run is entirely mapped, only candidates whose known entries would 
+ * fall past its end need to be excluded. Cheap word compares between the 
+ * known entries come first, to discard most candidates quickly.
  *
- * @param pg Virtual address of the page to check.
- * @return Virtual base address of the UNISTD_64 system call table.
+ * @param start Virtual address of the first page of the run.
+ * @param end Virtual address at which the run ends.
+ * @param arg Where to store the UNISTD_64 system call table base address.
+ * @return 1 if the table was found, 0 otherwise.
  */
-void **scth_check_page(void *pg) {
-    unsigned long i;
-    void *sec_page, **candidate;
-    for (i = 0; i < __PAGE_SIZE; i += sizeof(void *)) {
-        // If the table may span over two pages, check the second one.
-        sec_page = pg + i +
-                   (known_sysnis[nr_known_sysnis - 1] * sizeof(void *));
-        if (((ulong)(pg + __PAGE_SIZE) == ((ulong)sec_page & __PAGE_MASK)) && 
-            (paging_navigator((unsigned long)sec_page) == NOMAP))
-            return NULL;
+static int scth_check_range(unsigned long start, unsigned long end,
+                            void *arg) {
+    void **candidate, *first_sysni;
+    unsigned long span;
+    span = (known_sysnis[nr_known_sysnis - 1] + 1) * sizeof(void *);
+    if ((end - start) < span) return 0;
+    for (candidate = (void **)start;
+         ((unsigned long)candidate + span) <= end;
+         candidate++) {
+        first_sysni = candidate[known_sysnis[0]];
+        if (first_sysni != candidate[known_sysnis[nr_known_sysnis - 1]])
+            continue;
         // Now we can only go for pattern matching.
-        candidate = pg + i;
-        if ((candidate[known_sysnis[0]] != 0x0) &&
-            (((ulong)candidate[known_sysnis[0]] & 0x3) == 0x0) &&
-            (candidate[known_sysnis[0]] > KERNEL_START_ADDR) &&
+        if ((first_sysni != 0x0) &&
+            (((ulong)first_sysni & 0x3) == 0x0) &&
+            (first_sysni > KERNEL_START_ADDR) &&
             scth_pattern_check(candidate) &&
-            scth_prev_area_check(candidate))
-            return candidate;
+            scth_prev_area_check(candidate)) {
+            *((void ***)arg) = candidate;
+            return 1;
+        }
     }
-    return NULL;
+    return 0;
 }
 
 /**
@@ -283,21 +319,20 @@ void **scth_check_page(void *pg) {
  * @return UNISTD_64 system call table virtual address, or 0 if search fails.
  */
 void **scth_finder(void) {
-    void *pg, **addr;
-    for (pg = KERNEL_START_ADDR; pg < KERNEL_END_ADDR; pg += __PAGE_SIZE) {
-        // Do a simple linear search in the canonical higher half of virtual
-        // memory, previously checking that the target address is mapped to
-        // avoid General Protection Errors, page by page.
-        if ((paging_navigator((unsigned long)pg) != NOMAP) &&
-            ((addr = scth_check_page(pg)) != NULL)) {
-            printk(KERN_INFO
-                   "%s: UNISTD_64 system call table found at: 0x%px.\n",
-                   MODNAME, addr);
-            sys_call_table_addr = (unsigned long)addr;
-            sys_ni_syscall_addr = (unsigned long)(addr[known_sysnis[0]]);
-            scth_scan_table(addr);
-            return addr;
-        }
+    void **addr = NULL;
+    // Do a simple linear search in the canonical higher half of virtual
+    // memory, only looking into mapped areas to avoid General Protection
+    // Errors: the page table is walked once, and tells us where they are.
+    if (paging_walk_range((unsigned long)KERNEL_START_ADDR,
+                          (unsigned long)KERNEL_END_ADDR,
+                          scth_check_range, &addr)) {
+        printk(KERN_INFO
+               "%s: UNISTD_64 system call table found at: 0x%px.\n",
+               MODNAME, addr);
+        sys_call_table_addr = (unsigned long)addr;
+        sys_ni_syscall_addr = (unsigned long)(addr[known_sysnis[0]]);
+        scth_scan_table(addr);
+        return addr;
     }
     printk(KERN_ERR "%s: UNISTD_64 system call table not found.\n", MODNAME);
     return NULL;
@@ -31,7 +31,9 @@
 #include <linux/mutex.h>
 #include <linux/errno.h>
 #include <linux/version.h>
+#include <linux/jump_label.h>
 
+#include "utils/paging_navigator.h"
 #include "include/scth.h"
 
 #define MODNAME "SCTH"
@@ -42,6 +44,7 @@
 #endif
 
 extern int nr_sysnis;
+extern bool scth_debug;
 
 /* This ensures that operations on the Table are performed atomically. */
 DEFINE_MUTEX(scth_lock);
@@ -56,6 +59,8 @@ MODULE_VERSION("1.0");
 /* Module initialization routine. */
 int init_module(void) {
     void **table_addr;
+    // Apply the default debug switch, if it wasn't set from the command line.
+    if (scth_debug) static_branch_enable(&pn_dbg_key);
     table_addr = scth_finder();
     if (table_addr == NULL) {
         printk(KERN_ERR "%s: Shutdown...\n", MODNAME);
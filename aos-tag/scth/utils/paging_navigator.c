@@ -27,18 +27,18 @@
 #include <linux/kernel.h>
 #include <linux/compiler.h>
 #include <linux/mm.h>
+#include <linux/jump_label.h>
 #include <asm/page.h>
 
 #include "x86_utils.h"
 
 #include "paging_navigator.h"
 
-#ifdef DEBUG
-#warning "[PAGING NAVIGATOR] DEBUG mode on: Expect many status prints."
-#endif
-
 #define MODNAME "PAGING_NAVIGATOR"
 
+/* Debug prints switch, flipped by the SCTH "debug" module parameter. */
+DEFINE_STATIC_KEY_FALSE(pn_dbg_key);
+
 #define CR3_MASK 0xfffffffffffff000ULL
 #define PT_ADDR_MASK 0x7ffffffffffff000ULL
 #define PRESENT 0x1ULL
@@ -49,6 +49,15 @@
 #define PDE(vaddr)  ((unsigned long long)(vaddr >> 21) & 0x1ffULL)
 #define PTE(vaddr)  ((unsigned long long)(vaddr >> 12) & 0x1ffULL)
 
+/* Sizes of the ranges mapped by entries at each level. */
+#define PML4_SPAN (1UL << 39)
+#define PDP_SPAN  (1UL << 30)
+#define PDE_SPAN  (1UL << 21)
+#define PTE_SPAN  (1UL << 12)
+
+/* Start of the range of the given size that follows the one of vaddr. */
+#define NEXT_RANGE(vaddr, span) (((vaddr) & ~((span) - 1)) + (span))
+
 /**
  * @brief Traverses the page table to check if a given virtual address 
  * is mapped onto some physical frame.
@@ -65,80 +74,155 @@ long paging_navigator(unsigned long vaddr) {
 
     long frame_num;
 
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: Asked to check address: 0x%px.\n", MODNAME,
-           (void *)vaddr);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: Asked to check address: 0x%px.\n", MODNAME,
+               (void *)vaddr);
 
     // Get PML4 table virtual address translating CR3's content.
     pml4 = __va(__x86_read_cr3() & CR3_MASK);
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: PML4 table is at: 0x%px.\n", MODNAME, pml4);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: PML4 table is at: 0x%px.\n", MODNAME, pml4);
 
     // Check PML4 table entry.
     if (!((pml4[PML4(vaddr)].pgd) & PRESENT)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PML4 entry not present.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PML4 entry not present.\n", MODNAME);
         return NOMAP;
     }
     pdp = __va((pml4[PML4(vaddr)].pgd) & PT_ADDR_MASK);
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: PDP table is at: 0x%px.\n", MODNAME, pdp);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: PDP table is at: 0x%px.\n", MODNAME, pdp);
 
     // Check PDP table entry.
     // NOTE: This could, someday, host a mapping to a 1 GB page.
     if (!((pdp[PDP(vaddr)].pud) & PRESENT)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PDP entry not present.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PDP entry not present.\n", MODNAME);
         return NOMAP;
     }
     else if (unlikely((pdp[PDP(vaddr)].pud) & L_PAGE)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PDP entry maps 1 GB page.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PDP entry maps 1 GB page.\n", MODNAME);
         frame_num = ((pdp[PDP(vaddr)].pud) & PT_ADDR_MASK) >> 30;
         return frame_num;
     }
     pde = __va((pdp[PDP(vaddr)].pud) & PT_ADDR_MASK);
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: PD is at: 0x%px.\n", MODNAME, pde);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: PD is at: 0x%px.\n", MODNAME, pde);
 
     // Check PD entry.
     // NOTE: This could host a mapping to a 2 MB page.
     if (!((pde[PDE(vaddr)].pmd) & PRESENT)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PD entry not present.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PD entry not present.\n", MODNAME);
         return NOMAP;
     }
     else if (unlikely((pde[PDE(vaddr)].pmd) & L_PAGE)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PD entry maps 2 MB page.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PD entry maps 2 MB page.\n", MODNAME);
         frame_num = ((pde[PDE(vaddr)].pmd) & PT_ADDR_MASK) >> 21;
         return frame_num;
     }
     pte = __va((pde[PDE(vaddr)].pmd) & PT_ADDR_MASK);
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: PT is at: 0x%px.\n", MODNAME, pte);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: PT is at: 0x%px.\n", MODNAME, pte);
 
     // Check PT entry.
     if (!((pte[PTE(vaddr)].pte) & PRESENT)) {
-#ifdef DEBUG
-        printk(KERN_DEBUG "%s: PT entry not present.\n", MODNAME);
-#endif
+        if (static_branch_unlikely(&pn_dbg_key))
+            printk(KERN_DEBUG "%s: PT entry not present.\n", MODNAME);
         return NOMAP;
     }
     frame_num = ((pte[PTE(vaddr)].pte) & PT_ADDR_MASK) >> 12;
-#ifdef DEBUG
-    printk(KERN_DEBUG "%s: Found mapping at frame: %ld.\n", MODNAME,
-           frame_num);
-#endif
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: Found mapping at frame: %ld.\n", MODNAME,
+               frame_num);
     return frame_num;
 }
+
+/**
+ * @brief Walks the page table over a range of virtual addresses, calling fn 
+ * on each maximal run of contiguous mapped addresses. 
+ * CR3 is read only once, and ranges mapped by non-present PML4, PDP or PD 
+ * entries are skipped as a whole, as are 1 GB and 2 MB pages, that are never 
+ * looked into. 
+ * The walk stops at the first nonzero value returned by fn.
+ *
+ * @param start First virtual address to check (page aligned).
+ * @param end Virtual address at which to stop (page aligned, exclusive).
+ * @param fn Routine to call on mapped runs, as [start, end).
+ * @param arg Argument for the aforementioned routine.
+ * @return The first nonzero value returned by fn, or 0.
+ */
+int paging_walk_range(unsigned long start, unsigned long end,
+                      paging_range_fn fn, void *arg) {
+    pgd_t *pml4;
+    pud_t *pdp;
+    pmd_t *pde;
+    pte_t *pte;
+
+    unsigned long vaddr = start, next;
+    unsigned long run_start = 0, run_end = 0;
+    int ret;
+
+    // Get PML4 table virtual address translating CR3's content, once.
+    pml4 = __va(__x86_read_cr3() & CR3_MASK);
+    if (static_branch_unlikely(&pn_dbg_key))
+        printk(KERN_DEBUG "%s: Walking 0x%lx-0x%lx, PML4 table is at: 0x%px.\n",
+               MODNAME, start, end, pml4);
+
+    while (vaddr < end) {
+        // Check PML4 table entry.
+        if (!((pml4[PML4(vaddr)].pgd) & PRESENT)) {
+            next = NEXT_RANGE(vaddr, PML4_SPAN);
+            goto unmapped;
+        }
+        pdp = __va((pml4[PML4(vaddr)].pgd) & PT_ADDR_MASK);
+
+        // Check PDP table entry, which could map a 1 GB page.
+        if (!((pdp[PDP(vaddr)].pud) & PRESENT)) {
+            next = NEXT_RANGE(vaddr, PDP_SPAN);
+            goto unmapped;
+        }
+        if (unlikely((pdp[PDP(vaddr)].pud) & L_PAGE)) {
+            next = NEXT_RANGE(vaddr, PDP_SPAN);
+            goto mapped;
+        }
+        pde = __va((pdp[PDP(vaddr)].pud) & PT_ADDR_MASK);
+
+        // Check PD entry, which could map a 2 MB page.
+        if (!((pde[PDE(vaddr)].pmd) & PRESENT)) {
+            next = NEXT_RANGE(vaddr, PDE_SPAN);
+            goto unmapped;
+        }
+        if (unlikely((pde[PDE(vaddr)].pmd) & L_PAGE)) {
+            next = NEXT_RANGE(vaddr, PDE_SPAN);
+            goto mapped;
+        }
+        pte = __va((pde[PDE(vaddr)].pmd) & PT_ADDR_MASK);
+
+        // Check PT entry.
+        next = NEXT_RANGE(vaddr, PTE_SPAN);
+        if (!((pte[PTE(vaddr)].pte) & PRESENT)) goto unmapped;
+
+mapped:
+        // Mind the wraparound at the top of the address space.
+        if ((next <= vaddr) || (next > end)) next = end;
+        if (vaddr != run_end) run_start = vaddr;
+        run_end = next;
+        vaddr = next;
+        continue;
+
+unmapped:
+        // The current run, if any, is over.
+        if (run_end != run_start) {
+            ret = fn(run_start, run_end, arg);
+            if (ret) return ret;
+            run_start = run_end = 0;
+        }
+        if ((next <= vaddr) || (next > end)) next = end;
+        vaddr = next;
+    }
+    if (run_end != run_start) return fn(run_start, run_end, arg);
+    return 0;
+}
@@ -17,6 +17,7 @@
  * @brief Header file for the "paging_navigator" routine.
  *        Tells if a paged virtual address is mapped on a physical frame, and
  *        in case returns the corresponding physical frame number.
+ *        Also walks ranges of virtual addresses, reporting mapped ones.
  *        Works on x86-64 machines in long mode with 4-level paging.
  *        Rewritten along the lines of "VTPMO" while studying paging.
  * 
@@ -28,8 +29,19 @@
 #ifndef PAGING_NAVIGATOR_H
 #define PAGING_NAVIGATOR_H
 
+#include <linux/jump_label.h>
+
 #define NOMAP -1
 
+/* Enables debug prints of the routines below. */
+DECLARE_STATIC_KEY_FALSE(pn_dbg_key);
+
+/* Callback for paging_walk_range: gets a mapped range, returns nonzero to stop. */
+typedef int (*paging_range_fn)(unsigned long start, unsigned long end,
+                               void *arg);
+
 long paging_navigator(unsigned long vaddr);
+int paging_walk_range(unsigned long start, unsigned long end,
+                      paging_range_fn fn, void *arg);
 
 #endif
@@ -35,6 +35,18 @@
 #include <stdlib.h>
 #endif
 
+/**
+ * @brief Acquires and releases the mask lock. 
+ * Can be defined before this header is included, to wrap plain spinlock 
+ * operations.
+ *
+ * @param tag_mask Address of the bitmask.
+ */
+#if defined(__KERNEL__) && !defined(TAG_MASK_LOCK)
+#define TAG_MASK_LOCK(tag_mask) spin_lock(&((tag_mask)->_lock))
+#define TAG_MASK_UNLOCK(tag_mask) spin_unlock(&((tag_mask)->_lock))
+#endif
+
 /* Structure that holds a bitmask and metadata to quickly manage it. */
 typedef struct _tag_bitmask {
     unsigned long *_mask;    // Actual mask. Must be set manually outside.
@@ -160,11 +172,11 @@ typedef struct _tag_bitmask {
         tag_desc = (unsigned int)(tag);                                      \
         ulong_indx = tag_desc / (sizeof(unsigned long) * 8);                 \
         bit_indx = tag_desc - (ulong_indx * (sizeof(unsigned long) * 8));    \
-        spin_lock(&((tag_mask)->_lock));                                     \
+        TAG_MASK_LOCK(tag_mask);                                             \
         tag_ulong = ((tag_mask)->_mask)[ulong_indx];                         \
         tag_ulong &= (~0x0UL) ^ (0x1UL << bit_indx);                         \
         ((tag_mask)->_mask)[ulong_indx] = tag_ulong;                         \
-        spin_unlock(&((tag_mask)->_lock));                                   \
+        TAG_MASK_UNLOCK(tag_mask);                                           \
     } while (0)
 #endif
 
@@ -206,7 +218,7 @@ typedef struct _tag_bitmask {
 #define TAG_NEXT(tag_mask, full_flag) ({                                     \
     unsigned int i, mask_len, nr_tags, ret = 0;                              \
     full_flag = 1;                                                           \
-    spin_lock(&((tag_mask)->_lock));                                         \
+    TAG_MASK_LOCK(tag_mask);                                                 \
     mask_len = (tag_mask)->_mask_len;                                        \
     nr_tags = (tag_mask)->_nr_tags;                                          \
     for (i = 0; i < mask_len; i++) {                                         \
@@ -224,7 +236,7 @@ typedef struct _tag_bitmask {
         }                                                                    \
         if (full_flag == 0) break;                                           \
     }                                                                        \
-    spin_unlock(&((tag_mask)->_lock));                                       \
+    TAG_MASK_UNLOCK(tag_mask);                                               \
     ret; })
 #endif
 
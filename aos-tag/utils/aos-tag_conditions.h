@@ -74,6 +74,38 @@ typedef struct _tag_cond_t {
     spin_unlock(&((cond_addr)->_lock));                           \
     __epoch_sel; })
 
+/**
+ * @brief Registers the calling thread on the current epoch, as TAG_COND_REG 
+ * does, when it is the only thread that can register on the given condition 
+ * struct. 
+ * Returns the epoch on which the thread got registered. 
+ * NOTE: Since no one else can update the presence counters, plain stores are 
+ *       enough, and the spinlock is not taken: the epoch is read again after 
+ *       the increment, and if it flipped in the meantime the increment is 
+ *       undone and the thread tries again. The full barrier in between pairs 
+ *       with the one flippers must issue between TAG_COND_FLIP and reading the 
+ *       presence counter, so that either the flipper sees the thread, or the 
+ *       thread sees the flip.
+ *
+ * @param cond_addr Address of the tag_cond to register on.
+ * @return Current epoch's selector.
+ */
+#define TAG_COND_REG_EXCL(cond_addr) ({                                   \
+    unsigned char __epoch_sel;                                            \
+    for (;;) {                                                            \
+        __epoch_sel = __atomic_load_n(&((cond_addr)->_cond_epoch),        \
+                                      __ATOMIC_RELAXED);                  \
+        __atomic_store_n(&((cond_addr)->_pres_count[__epoch_sel]),        \
+            (cond_addr)->_pres_count[__epoch_sel] + 1, __ATOMIC_RELAXED); \
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);                          \
+        if (__atomic_load_n(&((cond_addr)->_cond_epoch),                  \
+                            __ATOMIC_RELAXED) == __epoch_sel)             \
+            break;                                                        \
+        __atomic_store_n(&((cond_addr)->_pres_count[__epoch_sel]),        \
+            (cond_addr)->_pres_count[__epoch_sel] - 1, __ATOMIC_RELEASE); \
+    }                                                                     \
+    __epoch_sel; })
+
 /**
  * @brief Unregisters the calling thread from the specified epoch of the given 
  * condition struct.
@@ -85,6 +117,18 @@ typedef struct _tag_cond_t {
     __atomic_sub_fetch(&((cond_addr)->_pres_count[epoch]),   \
         1, __ATOMIC_RELAXED);
 
+/**
+ * @brief Unregisters the calling thread from the specified epoch of the given 
+ * condition struct, on which it registered with TAG_COND_REG_EXCL. 
+ * The store releases whatever the thread did while registered.
+ *
+ * @param cond_addr Address of the tag_cond to operate on.
+ * @param epoch Epoch selector of the epoch to unregister from.
+ */
+#define TAG_COND_UNREG_EXCL(cond_addr, epoch)                \
+    __atomic_store_n(&((cond_addr)->_pres_count[epoch]),     \
+        (cond_addr)->_pres_count[epoch] - 1, __ATOMIC_RELEASE)
+
 /**
  * @brief Flips the given tag_cond's epoch, and returns the selector of the old 
  * epoch. Also resets the new epoch's condition.
@@ -124,4 +168,24 @@ typedef struct _tag_cond_t {
  */
 #define TAG_COND_COUNT(cond_addr, epoch) ((cond_addr)->_pres_count)[epoch]
 
+/**
+ * @brief Tries to become the only thread operating on one side of a level, 
+ * marking the given ownership flag. 
+ * Used to detect violations of declared single-producer or single-consumer 
+ * topologies, without sleeping.
+ *
+ * @param flag_addr Address of the ownership flag.
+ * @return 1 if the caller is now the owner, 0 if someone else already is.
+ */
+#define TAG_EXCL_ENTER(flag_addr) \
+    (!__atomic_exchange_n((flag_addr), 0x1, __ATOMIC_ACQUIRE))
+
+/**
+ * @brief Releases an ownership flag acquired with TAG_EXCL_ENTER.
+ *
+ * @param flag_addr Address of the ownership flag.
+ */
+#define TAG_EXCL_EXIT(flag_addr) \
+    __atomic_store_n((flag_addr), 0x0, __ATOMIC_RELEASE)
+
 #endif
@@ -0,0 +1,99 @@
+/**
+ * This is free software.
+ * You can redistribute it and/or modify this file under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * this file; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+/**
+ * @brief Definitions of the "message" data type and related macros.
+ *
+ * @author Roberto Masocco <robmasocco@gmail.com>
+ *
+ * @date October 18, 2026
+ */
+
+#ifndef AOS_TAG_MESSAGES_H
+#define AOS_TAG_MESSAGES_H
+
+#include <linux/slab.h>
+#include <linux/refcount.h>
+
+/**
+ * Kernel-side message buffer. 
+ * Reference counted, so that the same buffer can be linked in more than one 
+ * place (e.g. being delivered on a level and cached as its last message) and 
+ * is released only when the last reference is dropped.
+ */
+typedef struct _tag_msg_t {
+    refcount_t _refs;  // Reference counter.
+    size_t _size;      // Size of the message.
+    char _data[];      // Message contents.
+} tag_msg_t;
+
+/**
+ * @brief Allocates a new message buffer of the given size, holding a single 
+ * reference.
+ *
+ * @param size Size of the message to hold.
+ * @return Address of the new message, or NULL if out of memory.
+ */
+#define TAG_MSG_ALLOC(size) ({                                        \
+    tag_msg_t *__new_msg;                                             \
+    size_t __msg_sz;                                                  \
+    __msg_sz = (size_t)(size);                                        \
+    __new_msg = (tag_msg_t *)kzalloc(sizeof(tag_msg_t) + __msg_sz,    \
+                                     GFP_KERNEL);                     \
+    if (__new_msg != NULL) {                                          \
+        refcount_set(&(__new_msg->_refs), 1);                         \
+        __new_msg->_size = __msg_sz;                                  \
+    }                                                                 \
+    __new_msg; })
+
+/**
+ * @brief Gets a new reference to a message.
+ *
+ * @param msg Address of the message.
+ */
+#define TAG_MSG_GET(msg) refcount_inc(&((msg)->_refs))
+
+/**
+ * @brief Drops a reference to a message, releasing it if it was the last one. 
+ * NULL messages are allowed, and ignored.
+ *
+ * @param msg Address of the message.
+ */
+#define TAG_MSG_PUT(msg)                                              \
+    do {                                                              \
+        tag_msg_t *__put_msg;                                         \
+        __put_msg = (msg);                                            \
+        if ((__put_msg != NULL) &&                                    \
+            refcount_dec_and_test(&(__put_msg->_refs)))               \
+            kfree(__put_msg);                                         \
+    } while (0)
+
+/**
+ * @brief Evaluates to the contents of a message.
+ *
+ * @param msg Address of the message.
+ * @return Address of the message contents.
+ */
+#define TAG_MSG_DATA(msg) ((msg)->_data)
+
+/**
+ * @brief Evaluates to the size of a message.
+ *
+ * @param msg Address of the message.
+ * @return Size of the message.
+ */
+#define TAG_MSG_SIZE(msg) ((msg)->_size)
+
+#endif
@@ -68,6 +68,8 @@ echo "tag_get system call installed at: $(cat /sys/module/aos_tag/parameters/tag
 echo "tag_receive system call installed at: $(cat /sys/module/aos_tag/parameters/tag_receive_nr)"
 echo "tag_send system call installed at: $(cat /sys/module/aos_tag/parameters/tag_send_nr)"
 echo "tag_ctl system call installed at: $(cat /sys/module/aos_tag/parameters/tag_ctl_nr)"
+echo "tag_send_multi system call installed at: $(cat /sys/module/aos_tag/parameters/tag_send_multi_nr)"
+echo "tag_call system call installed at: $(cat /sys/module/aos_tag/parameters/tag_call_nr)"
 echo "Device driver registered with major number: $(cat /sys/module/aos_tag/parameters/tag_drv_major)"
 
 # Generate userspace header.
@@ -94,5 +96,15 @@ if [[ $? -ne 0 ]]; then
     echo "ERROR: Failed to generate userspace header." 1>&2
     exit 1
 fi
+sed -i -e "s/#define __NR_tag_send_multi 180/#define __NR_tag_send_multi $(cat /sys/module/aos_tag/parameters/tag_send_multi_nr)/" $HEADER_NAME
+if [[ $? -ne 0 ]]; then
+    echo "ERROR: Failed to generate userspace header." 1>&2
+    exit 1
+fi
+sed -i -e "s/#define __NR_tag_call 181/#define __NR_tag_call $(cat /sys/module/aos_tag/parameters/tag_call_nr)/" $HEADER_NAME
+if [[ $? -ne 0 ]]; then
+    echo "ERROR: Failed to generate userspace header." 1>&2
+    exit 1
+fi
 echo "Userspace header file name: $HEADER_NAME"
 echo "All done!"